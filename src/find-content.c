@@ -0,0 +1,157 @@
+/*
+ *  C Implementation: find-content
+ *
+ * Description: File content test of Find Files, grep --files-with-matches
+ *
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#define _GNU_SOURCE /* memmem */
+
+#include "find-content.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <regex.h>
+
+#define FIND_READ_SIZE (64 * 1024)
+
+/* Longer lines are matched in pieces of this size, each overlapping the
+ * last by FIND_LINE_OVERLAP, so a file without newlines isn't read into
+ * memory whole.  A match longer than the overlap may be missed at a cut. */
+#define FIND_MAX_LINE     (1024 * 1024)
+#define FIND_LINE_OVERLAP FIND_READ_SIZE
+
+struct _FindContent
+{
+    char* text;
+    size_t len;
+    gboolean fixed;
+    gboolean fold; /* blocks are searched in ASCII lower case */
+    regex_t regex;
+    char* buf; /* read buffer */
+    GString* line;
+};
+
+FindContent* find_content_new(const char* text, gboolean fixed, const char* regex, int regex_flags)
+{
+    FindContent* fc = g_slice_new0(FindContent);
+    const char* p;
+
+    /* an ASCII string is matched ignoring case by folding the file, which
+     * regexec does more slowly, and not at all for other chars */
+    fc->fixed = fixed && strlen(text) < FIND_READ_SIZE / 2;
+    if (fc->fixed && (regex_flags & REG_ICASE))
+    {
+        for (p = text; *p && !(*p & 0x80); ++p)
+            ;
+        fc->fixed = fc->fold = !*p;
+    }
+    if (!fc->fixed && regcomp(&fc->regex, regex, regex_flags) != 0)
+    {
+        g_slice_free(FindContent, fc);
+        return NULL;
+    }
+    fc->text = fc->fold ? g_ascii_strdown(text, -1) : g_strdup(text);
+    fc->len = strlen(text);
+    fc->buf = g_malloc(FIND_READ_SIZE);
+    if (!fc->fixed)
+        fc->line = g_string_sized_new(256);
+    return fc;
+}
+
+void find_content_free(FindContent* fc)
+{
+    if (!fc->fixed)
+    {
+        regfree(&fc->regex);
+        g_string_free(fc->line, TRUE);
+    }
+    g_free(fc->buf);
+    g_free(fc->text);
+    g_slice_free(FindContent, fc);
+}
+
+static gboolean match_fixed(FindContent* fc, int fd, const int* cancel)
+{
+    gboolean found = FALSE;
+    size_t keep = 0;
+    ssize_t n;
+
+    /* keep the tail of each block, a match may span two blocks */
+    while (!found && !g_atomic_int_get(cancel) && (n = read(fd, fc->buf + keep, FIND_READ_SIZE - keep)) > 0)
+    {
+        size_t size = keep + n;
+        if (fc->fold)
+        {
+            /* not g_ascii_tolower, a call per byte */
+            char* p;
+            for (p = fc->buf + keep; p < fc->buf + size; ++p)
+                *p |= (*p >= 'A' && *p <= 'Z') ? 0x20 : 0;
+        }
+        if (memmem(fc->buf, size, fc->text, fc->len))
+            found = TRUE;
+        keep = MIN(size, fc->len - 1);
+        memmove(fc->buf, fc->buf + size - keep, keep);
+    }
+    return found;
+}
+
+static gboolean match_regex(FindContent* fc, int fd, const int* cancel)
+{
+    GString* line = fc->line;
+    gboolean found = FALSE;
+    int notbol = 0; /* the start of the line was cut off */
+    ssize_t n;
+
+    /* match line by line, like grep */
+    g_string_truncate(line, 0);
+    while (!found && !g_atomic_int_get(cancel) && (n = read(fd, fc->buf, FIND_READ_SIZE)) > 0)
+    {
+        char* p = fc->buf;
+        char* end = fc->buf + n;
+
+        /* nul bytes end lines too, as grep does in binary files, regexec
+         * would stop at them anyway */
+        char* nul;
+        for (nul = memchr(p, '\0', n); nul; nul = memchr(nul + 1, '\0', end - nul - 1))
+            *nul = '\n';
+
+        while (!found && p < end)
+        {
+            char* eol = memchr(p, '\n', end - p);
+            char* stop = eol ? eol : end;
+            g_string_append_len(line, p, stop - p);
+            p = stop;
+            if (eol)
+            {
+                found = (0 == regexec(&fc->regex, line->str, 0, NULL, notbol));
+                g_string_truncate(line, 0);
+                notbol = 0;
+                ++p;
+            }
+            else if (line->len >= FIND_MAX_LINE)
+            {
+                found = (0 == regexec(&fc->regex, line->str, 0, NULL, notbol | REG_NOTEOL));
+                g_string_erase(line, 0, line->len - FIND_LINE_OVERLAP);
+                notbol = REG_NOTBOL;
+            }
+        }
+    }
+    if (!found && line->len > 0) /* last line without eol */
+        found = (0 == regexec(&fc->regex, line->str, 0, NULL, notbol));
+    if (line->allocated_len > FIND_READ_SIZE)
+    {
+        /* the buffer of a long line isn't kept for the next file */
+        g_string_free(line, TRUE);
+        fc->line = g_string_sized_new(256);
+    }
+    return found;
+}
+
+gboolean find_content_match(FindContent* fc, int fd, const int* cancel)
+{
+    return fc->fixed ? match_fixed(fc, fd, cancel) : match_regex(fc, fd, cancel);
+}
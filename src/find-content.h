@@ -0,0 +1,32 @@
+/*
+ *  C Interface: find-content
+ *
+ * Description: File content test of Find Files, grep --files-with-matches
+ *
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#ifndef _FIND_CONTENT_H_
+#define _FIND_CONTENT_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Each search thread has its own FindContent, regexec locks a shared regex */
+typedef struct _FindContent FindContent;
+
+/* text is searched as is with memmem if fixed, else regex is compiled with
+ * regex_flags for regcomp.  Returns NULL if regex is invalid. */
+FindContent* find_content_new(const char* text, gboolean fixed, const char* regex, int regex_flags);
+void find_content_free(FindContent* fc);
+
+/* Returns TRUE if the file open as fd matches.  *cancel is checked between
+ * blocks read. */
+gboolean find_content_match(FindContent* fc, int fd, const int* cancel);
+
+G_END_DECLS
+
+#endif
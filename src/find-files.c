@@ -19,10 +19,14 @@
  *      MA 02110-1301, USA.
  */
 
-/* FIXME: Currently this only works with GNU find-utils.
- * Compatibility with other systems like BSD, need to be improved.
+/* The search is done in-process by a pool of threads, which walk the
+ * selected folders and apply the same tests as the find & grep command line
+ * used before: find -H [-maxdepth 1] [-name .* -prune] -size -iname -mtime,
+ * and grep --files-with-matches [-i] [--fixed-strings].
  */
 
+#define _GNU_SOURCE /* FNM_CASEFOLD */
+
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
@@ -32,10 +36,15 @@
 #include <string.h>
 #include <time.h>
 #include <sys/types.h>
-#include <signal.h>
-#include <sys/wait.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <fnmatch.h>
+#include <regex.h>
 
 #include "pcmanfm.h"
+#include "find-content.h"
 
 #include "vfs/vfs-dir.h"
 #include "vfs/vfs-file-info.h"
@@ -117,10 +126,17 @@ typedef struct _FindFile
     GtkWidget* stop_btn;
     GtkWidget* again_btn;
 
-    GPid pid;
-    int stdo;
-
     VFSAsyncTask* task;
+
+    /* search engine */
+    struct _FindQuery* query;
+    int cancel;    /* read by the search threads without a lock, see is_search_cancelled */
+    GMutex mutex;  /* guards the fields below */
+    GCond cond;
+    GQueue* dirs;  /* FindDir waiting to be scanned */
+    int n_busy;    /* threads scanning a dir */
+    GQueue* found; /* FoundFile waiting for the result list */
+    uint found_idle;
 } FindFile;
 
 typedef struct
@@ -129,6 +145,48 @@ typedef struct
     char* dir_path;
 } FoundFile;
 
+/* Search criteria, read from the dialog before the search threads start */
+typedef struct _FindQuery
+{
+    char** roots;
+    gboolean recursive;
+    gboolean hidden;
+
+    char* name;     /* shell pattern, NULL matches all names */
+    int name_flags; /* for fnmatch */
+
+    gint64 size_lower; /* size in size_lower_unit is larger than this, -1 if unset */
+    gint64 size_lower_unit;
+    gint64 size_upper; /* size in size_upper_unit is smaller than this, -1 if unset */
+    gint64 size_upper_unit;
+
+    time_t now;
+    int max_age; /* modified less than max_age days ago, -1 if unset */
+    int min_age; /* modified more than min_age days ago, -1 if unset */
+
+    char* content;          /* grep pattern, NULL if unset */
+    char* content_regex;    /* content as a basic regex, for regcomp */
+    int content_flags;      /* for regcomp */
+    gboolean content_fixed; /* content is a fixed string, see find_content_new */
+} FindQuery;
+
+typedef struct
+{
+    char* path;
+} FindDir;
+
+/* Per thread state of a search */
+typedef struct
+{
+    FindFile* data;
+    FindContent* content; /* own copy of the content test */
+    GQueue hits;          /* FoundFile not yet handed to the result list */
+} FindWorker;
+
+#define FIND_MAX_THREADS 8
+#define FIND_BATCH_SIZE  64  /* results handed to the result list at once */
+#define FIND_VIEW_BATCH  500 /* rows added to the result list per idle call */
+
 static const char menu_def[] = "<ui>"
                                "<popup name=\"Popup\">"
                                "<menuitem name=\"Open\" action=\"OpenAction\" />"
@@ -288,18 +346,27 @@ static int get_date_offset(GtkCalendar* calendar)
     return ABS(offset);
 }
 
-static char** compose_command(FindFile* data)
+/* Escape a fixed string as a basic regex, like grep --fixed-strings */
+static char* fixed_string_to_regex(const char* str)
 {
-    GArray* argv = g_array_sized_new(TRUE, TRUE, sizeof(char*), 10);
-    char* tmp;
-    GtkTreeIter it;
-    char size_units[] = {"ckMG"};
-    gboolean print = FALSE;
+    GString* re = g_string_sized_new(strlen(str) * 2);
+    for (; *str; ++str)
+    {
+        if (strchr(".[]\\*^$", *str))
+            g_string_append_c(re, '\\');
+        g_string_append_c(re, *str);
+    }
+    return g_string_free(re, FALSE);
+}
 
-    char* arg = g_strdup("find");
-    g_array_append_val(argv, arg);
-    arg = g_strdup("-H");
-    g_array_append_val(argv, arg);
+static FindQuery* find_query_new(FindFile* data)
+{
+    FindQuery* q = g_slice_new0(FindQuery);
+    GArray* roots = g_array_sized_new(TRUE, TRUE, sizeof(char*), 4);
+    GtkTreeIter it;
+    const char* tmp;
+    char* arg;
+    const gint64 size_units[] = {1, 1024, 1024 * 1024, 1024 * 1024 * 1024};
 
     if (gtk_tree_model_get_iter_first(GTK_TREE_MODEL(data->places_list), &it))
     {
@@ -309,340 +376,456 @@ static char** compose_command(FindFile* data)
             if (arg)
             {
                 if (*arg)
-                    g_array_append_val(argv, arg);
+                    g_array_append_val(roots, arg);
                 else
                     g_free(arg);
             }
         } while (gtk_tree_model_iter_next(GTK_TREE_MODEL(data->places_list), &it));
     }
+    q->roots = (char**)g_array_free(roots, FALSE);
 
-    /* if include sub is excluded */ // MOD added
-    if (!gtk_toggle_button_get_active((GtkToggleButton*)data->include_sub))
-    {
-        arg = g_strdup("-maxdepth");
-        g_array_append_val(argv, arg);
-        arg = g_strdup("1");
-        g_array_append_val(argv, arg);
-    }
+    q->recursive = gtk_toggle_button_get_active((GtkToggleButton*)data->include_sub);
+    q->hidden = gtk_toggle_button_get_active((GtkToggleButton*)data->search_hidden);
 
-    /* if hidden files is excluded */
-    if (!gtk_toggle_button_get_active((GtkToggleButton*)data->search_hidden))
+    /* name, "*" matches all */
+    tmp = gtk_entry_get_text((GtkEntry*)data->fn_pattern_entry);
+    if (tmp && strcmp(tmp, "*"))
     {
-        arg = g_strdup("-name");
-        g_array_append_val(argv, arg);
-        arg = g_strdup(".*");
-        g_array_append_val(argv, arg);
-        arg = g_strdup("-prune");
-        g_array_append_val(argv, arg);
-        arg = g_strdup("-or");
-        g_array_append_val(argv, arg);
+        q->name = g_strdup(tmp);
+        if (!gtk_toggle_button_get_active((GtkToggleButton*)data->fn_case_sensitive))
+            q->name_flags = FNM_CASEFOLD;
     }
 
-    /* if lower limit of file size is set */
+    /* size limits, compared in whole units rounded up like find -size */
+    q->size_lower = q->size_upper = -1;
     if (gtk_toggle_button_get_active((GtkToggleButton*)data->use_size_lower))
     {
-        //        arg = g_strdup("(");
-        //        g_array_append_val( argv, arg );
-
-        arg = g_strdup("-size");
-        g_array_append_val(argv, arg);
-
-        tmp = g_strdup_printf("+%u%c",
-                              gtk_spin_button_get_value_as_int((GtkSpinButton*)data->size_lower),
-                              size_units[gtk_combo_box_get_active((GtkComboBox*)data->size_lower_unit)]);
-        g_array_append_val(argv, tmp);
-
-        /*        arg = g_strdup( tmp + 1 );
-                g_array_append_val( argv, arg );
-
-                arg = g_strdup("-o"); // -or
-                g_array_append_val( argv, arg );
-
-                arg = g_strdup("-size");
-                g_array_append_val( argv, arg );
-
-                g_array_append_val( argv, tmp );
-
-                arg = g_strdup(")");
-                g_array_append_val( argv, arg );
-        */
+        q->size_lower = gtk_spin_button_get_value_as_int((GtkSpinButton*)data->size_lower);
+        q->size_lower_unit = size_units[gtk_combo_box_get_active((GtkComboBox*)data->size_lower_unit)];
     }
-
-    /* if upper limit of file size is set */
     if (gtk_toggle_button_get_active((GtkToggleButton*)data->use_size_upper))
     {
-        //        arg = g_strdup("(");
-        //        g_array_append_val( argv, arg );
-
-        arg = g_strdup("-size");
-        g_array_append_val(argv, arg);
-
-        tmp = g_strdup_printf("-%u%c",
-                              gtk_spin_button_get_value_as_int((GtkSpinButton*)data->size_upper),
-                              size_units[gtk_combo_box_get_active((GtkComboBox*)data->size_upper_unit)]);
-
-        arg = g_strdup(tmp + 1);
-        g_array_append_val(argv, arg);
-        /*
-                arg = g_strdup("-o"); // -or
-                g_array_append_val( argv, arg );
-
-                arg = g_strdup("-size");
-                g_array_append_val( argv, arg );
-
-                g_array_append_val( argv, tmp );
-
-                arg = g_strdup(")");
-                g_array_append_val( argv, arg );
-        */
+        q->size_upper = gtk_spin_button_get_value_as_int((GtkSpinButton*)data->size_upper);
+        q->size_upper_unit = size_units[gtk_combo_box_get_active((GtkComboBox*)data->size_upper_unit)];
     }
 
-    /* If -name is used */
-    tmp = (char*)gtk_entry_get_text((GtkEntry*)data->fn_pattern_entry);
-    if (tmp && strcmp(tmp, "*"))
+    /* match by mtime, in whole days like find -mtime */
+    q->now = time(NULL);
+    q->max_age = q->min_age = -1;
+    switch (gtk_combo_box_get_active((GtkComboBox*)data->date_limit))
     {
-        if (gtk_toggle_button_get_active((GtkToggleButton*)data->fn_case_sensitive))
-            arg = g_strdup("-name");
-        else
-            arg = g_strdup("-iname");
-        g_array_append_val(argv, arg);
-
-        arg = g_strdup(tmp);
-        g_array_append_val(argv, arg);
+    case 1: /* within one day */
+        q->max_age = 1;
+        break;
+    case 2: /* within one week */
+        q->max_age = 7;
+        break;
+    case 3: /* within one month */
+        q->max_age = 30;
+        break;
+    case 4: /* within one year */
+        q->max_age = 365;
+        break;
+    case 5: /* range */
+        q->max_age = get_date_offset((GtkCalendar*)data->date1);
+        q->min_age = get_date_offset((GtkCalendar*)data->date2);
+        break;
+    default:
+        break;
     }
 
-    /* match by mtime */
-    int idx = gtk_combo_box_get_active((GtkComboBox*)data->date_limit);
-    if (idx > 0)
+    /* grep text inside files */
+    tmp = gtk_entry_get_text((GtkEntry*)data->fc_pattern);
+    if (tmp && *tmp)
     {
-        if (idx == 5) /* range */
+        q->content = g_strdup(tmp);
+        if (gtk_toggle_button_get_active((GtkToggleButton*)data->fc_use_regexp))
+            q->content_regex = g_strdup(tmp);
+        else
         {
-            arg = g_strdup("(");
-            g_array_append_val(argv, arg);
+            q->content_regex = fixed_string_to_regex(tmp);
+            q->content_fixed = TRUE;
+        }
+        q->content_flags = REG_NOSUB | REG_NEWLINE;
+        if (!gtk_toggle_button_get_active((GtkToggleButton*)data->fc_case_sensitive))
+            q->content_flags |= REG_ICASE;
+    }
+    return q;
+}
 
-            arg = g_strdup("-mtime");
-            g_array_append_val(argv, arg);
+static void find_query_free(FindQuery* q)
+{
+    g_strfreev(q->roots);
+    g_free(q->name);
+    g_free(q->content);
+    g_free(q->content_regex);
+    g_slice_free(FindQuery, q);
+}
 
-            /* date1 */
-            arg = g_strdup_printf("-%d", get_date_offset((GtkCalendar*)data->date1));
-            g_array_append_val(argv, arg);
+static void found_file_free(FoundFile* ff)
+{
+    vfs_file_info_unref(ff->fi);
+    g_free(ff->dir_path);
+    g_slice_free(FoundFile, ff);
+}
 
-            arg = g_strdup("-mtime");
-            g_array_append_val(argv, arg);
+static void add_found_file(FindFile* data, FoundFile* ff)
+{
+    GtkTreeIter it;
+    char size[64];
+    char mtime[64];
+    gtk_list_store_append(data->result_list, &it);
+    GdkPixbuf* icon = vfs_file_info_get_small_icon(ff->fi);
+    vfs_file_info_get_disp_size(ff->fi, size);
+    vfs_file_info_get_disp_mtime(ff->fi, mtime);
+    gtk_list_store_set(data->result_list,
+                       &it,
+                       COL_ICON,
+                       icon,
+                       COL_NAME,
+                       vfs_file_info_get_disp_name(ff->fi),
+                       COL_DIR,
+                       ff->dir_path, /* FIXME: non-UTF8? */
+                       COL_TYPE,
+                       vfs_file_info_get_mime_type_desc(ff->fi),
+                       COL_SIZE,
+                       size,
+                       COL_MTIME,
+                       mtime,
+                       COL_INFO,
+                       ff->fi,
+                       -1);
+    if (icon)
+        g_object_unref(icon);
+    /* the result list keeps the reference of ff->fi */
+    g_free(ff->dir_path);
+    g_slice_free(FoundFile, ff);
+}
 
-            /* date2 */
-            arg = g_strdup_printf("+%d", get_date_offset((GtkCalendar*)data->date2));
-            g_array_append_val(argv, arg);
+static gboolean on_found_idle(FindFile* data)
+{
+    GQueue batch = G_QUEUE_INIT;
+    FoundFile* ff;
+    gboolean more;
+
+    /* add the found files in batches, so the window stays responsive */
+    g_mutex_lock(&data->mutex);
+    while (batch.length < FIND_VIEW_BATCH && (ff = (FoundFile*)g_queue_pop_head(data->found)))
+        g_queue_push_tail(&batch, ff);
+    more = !g_queue_is_empty(data->found);
+    if (!more)
+        data->found_idle = 0;
+    g_mutex_unlock(&data->mutex);
+
+    GDK_THREADS_ENTER();
+    while ((ff = (FoundFile*)g_queue_pop_head(&batch)))
+        add_found_file(data, ff);
+    GDK_THREADS_LEAVE();
+    return more;
+}
 
-            arg = g_strdup(")");
-            g_array_append_val(argv, arg);
-        }
-        else
-        {
-            arg = g_strdup("-mtime");
-            g_array_append_val(argv, arg);
+static void finish_search(FindFile* data)
+{
+    FoundFile* ff;
 
-            switch (idx)
-            {
-            case 1: /* within one day */
-                arg = g_strdup("-1");
-                break;
-            case 2: /* within one week */
-                arg = g_strdup("-7");
-                break;
-            case 3: /* within one month */
-                arg = g_strdup("-30");
-                break;
-            case 4: /* within one year */
-                arg = g_strdup("-365");
-                break;
-            default:
-                break;
-            }
-            g_array_append_val(argv, arg);
-        }
+    if (data->task)
+    {
+        g_object_unref(data->task);
+        data->task = NULL;
     }
-
-    /* grep text inside files */
-    tmp = (char*)gtk_entry_get_text((GtkEntry*)data->fc_pattern);
-    if (tmp && *tmp)
+    if (data->found_idle)
     {
-        print = TRUE;
-
-        /* ensure we only call 'grep' on regular files */
-        arg = g_strdup("-type");
-        g_array_append_val(argv, arg);
-        arg = g_strdup("f");
-        g_array_append_val(argv, arg);
-
-        arg = g_strdup("-exec");
-        g_array_append_val(argv, arg);
+        g_source_remove(data->found_idle);
+        data->found_idle = 0;
+    }
+    /* the search threads are done, show what is left */
+    while ((ff = (FoundFile*)g_queue_pop_head(data->found)))
+        add_found_file(data, ff);
+    if (data->query)
+    {
+        find_query_free(data->query);
+        data->query = NULL;
+    }
+    gdk_window_set_cursor(gtk_widget_get_window(data->search_result), NULL);
+    gtk_widget_hide(data->stop_btn);
+    gtk_widget_show(data->again_btn);
+}
 
-        arg = g_strdup("grep");
-        g_array_append_val(argv, arg);
+/* Hand the hits of a thread to the result list */
+static void flush_hits(FindWorker* w)
+{
+    FindFile* data = w->data;
+    FoundFile* ff;
 
-        if (!gtk_toggle_button_get_active((GtkToggleButton*)data->fc_case_sensitive))
-        {
-            arg = g_strdup("-i");
-            g_array_append_val(argv, arg);
-        }
+    if (g_queue_is_empty(&w->hits))
+        return;
+    g_mutex_lock(&data->mutex);
+    while ((ff = (FoundFile*)g_queue_pop_head(&w->hits)))
+        g_queue_push_tail(data->found, ff);
+    if (!data->found_idle)
+        data->found_idle = g_idle_add((GSourceFunc)on_found_idle, data);
+    g_mutex_unlock(&data->mutex);
+}
 
-        arg = g_strdup("--files-with-matches");
-        g_array_append_val(argv, arg);
+static void add_hit(FindWorker* w, int dir_fd, const char* dir_path, const char* name)
+{
+    VFSFileInfo* fi = vfs_file_info_new();
+    if (!vfs_file_info_get_at(fi, dir_fd, dir_path, name, NULL))
+    {
+        vfs_file_info_unref(fi);
+        return;
+    }
+    /* results are few, so sniff their content here rather than in the UI */
+    if (vfs_file_info_is_mime_pending(fi))
+    {
+        char* path = g_build_filename(dir_path, name, NULL);
+        vfs_file_info_load_mime_type(fi, path);
+        g_free(path);
+    }
+    FoundFile* ff = g_slice_new0(FoundFile);
+    ff->fi = fi;
+    ff->dir_path = g_strdup(dir_path);
+    g_queue_push_tail(&w->hits, ff);
+    if (w->hits.length >= FIND_BATCH_SIZE)
+        flush_hits(w);
+}
 
-        if (gtk_toggle_button_get_active((GtkToggleButton*)data->fc_use_regexp))
-            arg = g_strdup("--regexp");
-        else
-            arg = g_strdup("--fixed-strings");
-        g_array_append_val(argv, arg);
+static void push_dir(FindFile* data, char* path)
+{
+    FindDir* dir = g_slice_new(FindDir);
+    dir->path = path;
+    g_mutex_lock(&data->mutex);
+    g_queue_push_tail(data->dirs, dir);
+    g_cond_signal(&data->cond);
+    g_mutex_unlock(&data->mutex);
+}
 
-        arg = g_strdup(tmp);
-        g_array_append_val(argv, arg);
+/* task->cancel is a bit field written under the task lock, which would be
+ * taken for every file and read, so the threads check their own flag */
+static gboolean is_search_cancelled(FindFile* data)
+{
+    return g_atomic_int_get(&data->cancel);
+}
 
-        arg = g_strdup("{}");
-        g_array_append_val(argv, arg);
+static void cancel_search(FindFile* data)
+{
+    g_atomic_int_set(&data->cancel, TRUE);
+    /* wake the threads waiting for a dir */
+    g_mutex_lock(&data->mutex);
+    g_cond_broadcast(&data->cond);
+    g_mutex_unlock(&data->mutex);
+    vfs_async_task_cancel(data->task);
+}
 
-        arg = g_strdup(";");
-        g_array_append_val(argv, arg);
-    }
+/* Wait for a dir to scan.  Returns NULL when all dirs are done or the
+ * search was cancelled. */
+static FindDir* pop_dir(FindFile* data)
+{
+    FindDir* dir = NULL;
+
+    g_mutex_lock(&data->mutex);
+    while (!is_search_cancelled(data) && g_queue_is_empty(data->dirs) && data->n_busy > 0)
+        g_cond_wait(&data->cond, &data->mutex);
+    if (!is_search_cancelled(data))
+        dir = (FindDir*)g_queue_pop_head(data->dirs);
+    if (dir)
+        ++data->n_busy;
+    else
+        g_cond_broadcast(&data->cond); /* let the other threads quit, too */
+    g_mutex_unlock(&data->mutex);
+    return dir;
+}
 
-    if (!print)
+static gboolean match_stat(FindQuery* q, struct stat* st)
+{
+    if (q->size_lower >= 0 && (st->st_size + q->size_lower_unit - 1) / q->size_lower_unit <= q->size_lower)
+        return FALSE;
+    if (q->size_upper >= 0 && (st->st_size + q->size_upper_unit - 1) / q->size_upper_unit >= q->size_upper)
+        return FALSE;
+    if (q->max_age >= 0 || q->min_age >= 0)
     {
-        arg = g_strdup("-print");
-        g_array_append_val(argv, arg);
+        time_t age = (q->now - st->st_mtime) / 86400;
+        if (q->max_age >= 0 && age >= q->max_age)
+            return FALSE;
+        if (q->min_age >= 0 && age <= q->min_age)
+            return FALSE;
     }
-    return (char**)g_array_free(argv, FALSE);
+    return TRUE;
 }
 
-static void finish_search(FindFile* data)
+/* grep --files-with-matches on a regular file */
+static gboolean match_content(FindWorker* w, int dir_fd, const char* name)
 {
-    if (data->pid)
-    {
-        int status;
-        kill(data->pid, SIGTERM);
-        waitpid(data->pid, &status, 0);
-        data->pid = 0;
-        /* g_debug( "find process is killed!" ); */
-    }
-    if (data->task)
-    {
-        g_object_unref(data->task);
-        data->task = NULL;
-    }
-    gdk_window_set_cursor(gtk_widget_get_window(data->search_result), NULL);
-    gtk_widget_hide(data->stop_btn);
-    gtk_widget_show(data->again_btn);
+    int fd = openat(dir_fd, name, O_RDONLY | O_NOCTTY | O_CLOEXEC);
+    if (fd < 0)
+        return FALSE;
+    gboolean found = find_content_match(w->content, fd, &w->data->cancel);
+    close(fd);
+    return found;
 }
 
-static void process_found_files(FindFile* data, GQueue* queue, const char* path)
+static gboolean match_name(FindQuery* q, const char* name)
 {
-    FoundFile* ff;
+    return !q->name || 0 == fnmatch(q->name, name, q->name_flags);
+}
+
+static void search_dir(FindWorker* w, FindDir* dir)
+{
+    FindFile* data = w->data;
+    FindQuery* q = data->query;
+    struct dirent* ent;
+    struct stat st;
+
+    int fd = open(dir->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    DIR* dp = fdopendir(fd);
+    if (!dp)
+    {
+        close(fd);
+        return;
+    }
 
-    if (path)
+    gboolean need_stat = q->size_lower >= 0 || q->size_upper >= 0 || q->max_age >= 0 || q->min_age >= 0 ||
+                         q->content;
+    while (!is_search_cancelled(data) && (ent = readdir(dp)))
     {
-        char* name = g_filename_display_basename(path);
-        VFSFileInfo* fi = vfs_file_info_new();
-        if (vfs_file_info_get(fi, path, name))
+        const char* name = ent->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+            continue;
+        if (!q->hidden && name[0] == '.')
+            continue; /* pruned, and not searched below */
+
+        gboolean is_dir;
+        gboolean have_stat = FALSE;
+        if (ent->d_type == DT_UNKNOWN)
         {
-            ff = g_slice_new0(FoundFile);
-            ff->fi = fi;
-            ff->dir_path = g_path_get_dirname(path);
-            g_queue_push_tail(queue, ff);
+            if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                continue;
+            have_stat = TRUE;
+            is_dir = S_ISDIR(st.st_mode);
         }
         else
+            is_dir = ent->d_type == DT_DIR;
+
+        /* symlinks to dirs are not followed, as with find -H */
+        if (is_dir && q->recursive)
+            push_dir(data, g_build_filename(dir->path, name, NULL));
+
+        if (!match_name(q, name))
+            continue;
+        if (need_stat)
         {
-            vfs_file_info_unref(fi);
+            if (!have_stat && fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                continue;
+            if (!match_stat(q, &st))
+                continue;
+            if (q->content && !(S_ISREG(st.st_mode) && match_content(w, fd, name)))
+                continue;
         }
-        g_free(name);
-
-        /* we queue the found files, and not add them to the tree view direclty.
-         * when we queued more than 10 files, we add them at once. I think
-         * this can prevent locking gtk+ too frequently and improve responsiveness.
-         * FIXME: This could blocked the last queued files and delay their display
-         * to the end of the whole search. A better method is needed.
-         */
-        // MOD disabled this - causes last queued files to not display
-        //        if( g_queue_get_length( queue ) < 10 )
-        //            return;
+        add_hit(w, fd, dir->path, name);
     }
+    closedir(dp);
+    flush_hits(w);
+}
 
-    while ((ff = (FoundFile*)g_queue_pop_head(queue)))
+static gpointer search_worker(FindWorker* w)
+{
+    FindFile* data = w->data;
+    FindDir* dir;
+
+    while ((dir = pop_dir(data)))
     {
-        GDK_THREADS_ENTER();
-        GtkTreeIter it;
-        gtk_list_store_append(data->result_list, &it);
-        GdkPixbuf* icon = vfs_file_info_get_small_icon(ff->fi);
-        gtk_list_store_set(data->result_list,
-                           &it,
-                           COL_ICON,
-                           icon,
-                           COL_NAME,
-                           vfs_file_info_get_disp_name(ff->fi),
-                           COL_DIR,
-                           ff->dir_path, /* FIXME: non-UTF8? */
-                           COL_TYPE,
-                           vfs_file_info_get_mime_type_desc(ff->fi),
-                           COL_SIZE,
-                           vfs_file_info_get_disp_size(ff->fi),
-                           COL_MTIME,
-                           vfs_file_info_get_disp_mtime(ff->fi),
-                           COL_INFO,
-                           ff->fi,
-                           -1);
-        g_object_unref(icon);
-        GDK_THREADS_LEAVE();
-        g_slice_free(FoundFile, ff);
+        search_dir(w, dir);
+        g_free(dir->path);
+        g_slice_free(FindDir, dir);
+
+        g_mutex_lock(&data->mutex);
+        if (--data->n_busy == 0 && g_queue_is_empty(data->dirs))
+            g_cond_broadcast(&data->cond); /* all done */
+        g_mutex_unlock(&data->mutex);
     }
+    return NULL;
 }
 
-static gpointer search_thread(VFSAsyncTask* task, FindFile* data)
+/* The roots are tested themselves, too, like find does */
+static void search_root(FindWorker* w, const char* root)
 {
-    ssize_t rlen;
-    char buf[4096];
-    GString* path = g_string_new_len(NULL, 256);
-    GQueue* queue = g_queue_new();
+    FindFile* data = w->data;
+    FindQuery* q = data->query;
+    struct stat st;
+
+    if (stat(root, &st) != 0) /* follow symlinks given as roots, find -H */
+        return;
 
-    while (!data->task->cancel && (rlen = read(data->stdo, buf, sizeof(buf) - 1)) > 0)
+    char* name = g_path_get_basename(root);
+    char* parent = g_path_get_dirname(root);
+    int fd = open(parent, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0)
     {
-        while (!data->task->cancel)
-        {
-            char* eol;
-            char* pbuf;
-            buf[rlen] = '\0';
-            pbuf = buf;
-            if ((eol = strchr(pbuf, '\n'))) /* end of line is reached */
-            {
-                *eol = '\0';
-                g_string_append(path, pbuf);
+        if (match_name(q, name) && match_stat(q, &st) &&
+            (!q->content || (S_ISREG(st.st_mode) && match_content(w, fd, name))))
+            add_hit(w, fd, parent, name);
+        close(fd);
+    }
+    g_free(name);
+    g_free(parent);
+    flush_hits(w);
 
-                /* we get a complete file path */
-                if (!data->task->cancel)
-                {
-                    process_found_files(data, queue, path->str);
-                }
+    if (S_ISDIR(st.st_mode))
+        push_dir(data, g_strdup(root));
+}
 
-                pbuf = eol + 1;            /* start reading the next line */
-                g_string_assign(path, ""); /* empty the line buffer */
-            }
-            else /* end of line is not reached */
+static gpointer search_thread(VFSAsyncTask* task, FindFile* data)
+{
+    FindQuery* q = data->query;
+    int n_threads = CLAMP(g_get_num_processors(), 1, FIND_MAX_THREADS);
+    FindWorker* workers = g_new0(FindWorker, n_threads);
+    GThread** threads = g_new0(GThread*, n_threads);
+    char** root;
+    int i;
+
+    for (i = 0; i < n_threads; ++i)
+    {
+        FindWorker* w = &workers[i];
+        w->data = data;
+        g_queue_init(&w->hits);
+        if (q->content)
+        {
+            w->content = find_content_new(q->content, q->content_fixed, q->content_regex, q->content_flags);
+            if (!w->content)
             {
-                g_string_append(path, pbuf); /* store the partial path in the buffer */
-                break;
+                /* invalid regex, nothing can match */
+                g_warning("find: invalid regular expression: %s", q->content);
+                goto out;
             }
         }
     }
-    /* end of stream (EOF) is reached */
-    if (path->len > 0) /* this is the last line without eol character '\n' */
+
+    for (root = q->roots; *root && !is_search_cancelled(data); ++root)
+        search_root(&workers[0], *root);
+
+    for (i = 0; i < n_threads; ++i)
+        threads[i] = g_thread_new("find_files", (GThreadFunc)search_worker, &workers[i]);
+    for (i = 0; i < n_threads; ++i)
+        g_thread_join(threads[i]);
+
+out:
+    for (i = 0; i < n_threads; ++i)
     {
-        if (!data->task->cancel)
-        {
-            process_found_files(data, queue, path->str);
-            process_found_files(data, queue, NULL);
-        }
+        if (workers[i].content)
+            find_content_free(workers[i].content);
     }
+    g_free(workers);
+    g_free(threads);
 
-    g_queue_free(queue);
-    g_string_free(path, TRUE);
+    /* drop the dirs left by a cancelled search */
+    FindDir* dir;
+    while ((dir = (FindDir*)g_queue_pop_head(data->dirs)))
+    {
+        g_free(dir->path);
+        g_slice_free(FindDir, dir);
+    }
     return NULL;
 }
 
@@ -653,10 +836,8 @@ static void on_search_finish(VFSAsyncTask* task, gboolean cancelled, FindFile* d
 
 static void on_start_search(GtkWidget* btn, FindFile* data)
 {
-    char** argv;
-    GError* err = NULL;
-    char* cmd_line;
     GtkAllocation allocation;
+    GdkCursor* busy_cursor;
 
     gtk_widget_get_allocation(GTK_WIDGET(data->win), &allocation);
     int width = allocation.width;
@@ -677,47 +858,27 @@ static void on_start_search(GtkWidget* btn, FindFile* data)
     gtk_widget_hide(btn);
     gtk_widget_show(data->stop_btn);
 
-    argv = compose_command(data);
-
-    cmd_line = g_strjoinv(" ", argv);
-    g_debug("find command: %s", cmd_line);
-    g_free(cmd_line);
-    if (g_spawn_async_with_pipes(g_get_home_dir(),
-                                 argv,
-                                 NULL,
-                                 G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL,
-                                 NULL,
-                                 NULL,
-                                 &data->pid,
-                                 NULL,
-                                 &data->stdo,
-                                 NULL,
-                                 &err))
-    {
-        GdkCursor* busy_cursor;
-        data->task = vfs_async_task_new((VFSAsyncFunc)search_thread, data);
-        g_signal_connect(data->task, "finish", G_CALLBACK(on_search_finish), data);
-        vfs_async_task_execute(data->task);
+    data->query = find_query_new(data);
+    data->cancel = FALSE;
+
+    data->task = vfs_async_task_new((VFSAsyncFunc)search_thread, data);
+    /* may run for long, don't hold back dir listings */
+    vfs_async_task_set_priority(data->task, VFS_ASYNC_TASK_BACKGROUND);
+    g_signal_connect(data->task, "finish", G_CALLBACK(on_search_finish), data);
+    vfs_async_task_execute(data->task);
 
 #if (GTK_MAJOR_VERSION == 3)
-        busy_cursor = gdk_cursor_new_for_display(NULL, GDK_WATCH);
+    busy_cursor = gdk_cursor_new_for_display(NULL, GDK_WATCH);
 #elif (GTK_MAJOR_VERSION == 2)
-        busy_cursor = gdk_cursor_new(GDK_WATCH);
+    busy_cursor = gdk_cursor_new(GDK_WATCH);
 #endif
-        gdk_window_set_cursor(gtk_widget_get_window(data->search_result), busy_cursor);
+    gdk_window_set_cursor(gtk_widget_get_window(data->search_result), busy_cursor);
 
 #if (GTK_MAJOR_VERSION == 3)
-        g_object_unref(busy_cursor);
+    g_object_unref(busy_cursor);
 #elif (GTK_MAJOR_VERSION == 2)
-        gdk_cursor_unref(busy_cursor);
+    gdk_cursor_unref(busy_cursor);
 #endif
-    }
-    else
-    {
-        g_error_free(err);
-    }
-
-    g_strfreev(argv);
 }
 
 static void on_stop_search(GtkWidget* btn, FindFile* data)
@@ -726,7 +887,7 @@ static void on_stop_search(GtkWidget* btn, FindFile* data)
     {
         // see note in vfs-async-task.c: vfs_async_task_real_cancel()
         GDK_THREADS_LEAVE();
-        vfs_async_task_cancel(data->task);
+        cancel_search(data);
         GDK_THREADS_ENTER();
     }
 }
@@ -899,6 +1060,21 @@ static void on_date_limit_changed(GtkWidget* date_limit, FindFile* data)
 
 static void free_data(FindFile* data)
 {
+    if (data->task)
+    {
+        /* the window is gone, stop the search without updating it */
+        g_signal_handlers_disconnect_by_func(data->task, on_search_finish, data);
+        cancel_search(data);
+        g_object_unref(data->task);
+    }
+    if (data->found_idle)
+        g_source_remove(data->found_idle);
+    g_queue_free_full(data->found, (GDestroyNotify)found_file_free);
+    g_queue_free(data->dirs);
+    if (data->query)
+        find_query_free(data->query);
+    g_mutex_clear(&data->mutex);
+    g_cond_clear(&data->cond);
     g_slice_free(FindFile, data);
 }
 
@@ -1027,6 +1203,10 @@ void on_use_size_upper_toggled(GtkWidget* widget, FindFile* data)
 void fm_find_files(const char** search_dirs)
 {
     FindFile* data = g_slice_new0(FindFile);
+    g_mutex_init(&data->mutex);
+    g_cond_init(&data->cond);
+    data->dirs = g_queue_new();
+    data->found = g_queue_new();
 
 #if (GTK_MAJOR_VERSION == 3)
     GtkBuilder* builder = _gtk_builder_new_from_file(PACKAGE_UI_DIR, "/find-files3.ui", NULL);
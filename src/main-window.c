@@ -2904,6 +2904,17 @@ void on_folder_notebook_switch_pape(GtkNotebook* notebook, GtkWidget* page, uint
     PtkFileBrowser* file_browser = PTK_FILE_BROWSER(gtk_notebook_get_nth_page(notebook, page_num));
     // g_printf("on_folder_notebook_switch_pape fb=%p   panel=%d   page=%d\n", file_browser, file_browser->mypanel,
     // page_num );
+
+    // list the dir of the shown tab before those of hidden tabs (eg session restore),
+    // unless another panel shows it too
+    int i;
+    for (i = 0; i < gtk_notebook_get_n_pages(notebook); i++)
+    {
+        PtkFileBrowser* a_browser = PTK_FILE_BROWSER(gtk_notebook_get_nth_page(notebook, i));
+        if (a_browser != file_browser)
+            ptk_file_browser_set_shown(a_browser, FALSE);
+    }
+    ptk_file_browser_set_shown(file_browser, TRUE);
     main_window->curpanel = file_browser->mypanel;
     main_window->notebook = main_window->panel[main_window->curpanel - 1];
 
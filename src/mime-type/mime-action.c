@@ -45,6 +45,75 @@ gboolean save_to_file(const char* path, const char* data, gssize len)
 const char group_desktop[] = "Desktop Entry";
 const char key_mime_type[] = "MimeType";
 
+/* In-memory association index, so that menus need no disk I/O.  Parsed
+ * association files, located desktop files and the apps of each mime type
+ * are cached here until mime_type_action_reload() drops them. */
+G_LOCK_DEFINE_STATIC(action_index);
+static GHashTable* key_files = NULL;     // path => GKeyFile, NULL if unreadable
+static GHashTable* desktop_paths = NULL; // desktop_id => path, NULL if missing
+static GHashTable* type_actions = NULL;  // mime type => apps (char**), default first
+static GHashTable* type_defaults = NULL; // mime type => default app, NULL if none
+static uint index_serial = 0;            // bumped by mime_type_action_reload()
+
+static void key_file_unref(GKeyFile* file)
+{
+    if (file)
+        g_key_file_unref(file);
+}
+
+static void action_index_init()
+{ // called with action_index locked
+    if (G_LIKELY(key_files))
+        return;
+    key_files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)key_file_unref);
+    desktop_paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    type_actions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_strfreev);
+    type_defaults = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+}
+
+/* Drop the association index, it is rebuilt on demand.  Call this when
+ * mimeapps.list, mimeinfo.cache or desktop files are changed. */
+void mime_type_action_reload()
+{
+    G_LOCK(action_index);
+    if (key_files)
+    {
+        g_hash_table_destroy(key_files);
+        g_hash_table_destroy(desktop_paths);
+        g_hash_table_destroy(type_actions);
+        g_hash_table_destroy(type_defaults);
+        key_files = desktop_paths = type_actions = type_defaults = NULL;
+    }
+    ++index_serial;
+    G_UNLOCK(action_index);
+}
+
+/* Returns a new reference to the parsed key file, or NULL if it can't be read */
+static GKeyFile* load_key_file(const char* path)
+{
+    gpointer value;
+    GKeyFile* file;
+
+    G_LOCK(action_index);
+    action_index_init();
+    if (g_hash_table_lookup_extended(key_files, path, NULL, &value))
+        file = (GKeyFile*)value;
+    else
+    {
+        file = g_key_file_new();
+        if (!g_key_file_load_from_file(file, path, 0, NULL))
+        {
+            g_key_file_free(file);
+            file = NULL;
+        }
+        g_hash_table_insert(key_files, g_strdup(path), file);
+    }
+    if (file)
+        g_key_file_ref(file);
+    G_UNLOCK(action_index);
+    return file;
+}
+
 typedef char* (*DataDirFunc)(const char* dir, const char* mime_type, gpointer user_data);
 
 static char* data_dir_foreach(DataDirFunc func, const char* mime_type, gpointer user_data)
@@ -129,18 +198,16 @@ static int strv_index(char** strv, const char* str)
 static void remove_actions(const char* type, GArray* actions)
 { // sfm 0.7.7+ added
     // g_print( "remove_actions( %s )\n", type );
-    GKeyFile* file = g_key_file_new();
-
     // $XDG_CONFIG_HOME=[~/.config]/mimeapps.list
     char* path = g_build_filename(g_get_user_config_dir(), "mimeapps.list", NULL);
-    if (!g_key_file_load_from_file(file, path, 0, NULL))
+    GKeyFile* file = load_key_file(path);
+    if (!file)
     {
         // $XDG_DATA_HOME=[~/.local]/applications/mimeapps.list
         g_free(path);
         path = g_build_filename(g_get_user_data_dir(), "applications/mimeapps.list", NULL);
-        if (!g_key_file_load_from_file(file, path, 0, NULL))
+        if (!(file = load_key_file(path)))
         {
-            g_key_file_free(file);
             g_free(path);
             return;
         }
@@ -165,7 +232,7 @@ static void remove_actions(const char* type, GArray* actions)
         }
     }
     g_strfreev(removed);
-    g_key_file_free(file);
+    g_key_file_unref(file);
 }
 
 /*
@@ -188,10 +255,9 @@ static char* get_actions(const char* dir, const char* type, GArray* actions)
     {
         char* path = g_build_filename(dir, names[n], NULL);
         // g_print( "    %s\n", path );
-        GKeyFile* file = g_key_file_new();
-        gboolean opened = g_key_file_load_from_file(file, path, 0, NULL);
+        GKeyFile* file = load_key_file(path);
         g_free(path);
-        if (G_LIKELY(opened))
+        if (G_LIKELY(file))
         {
             size_t n_removed = 0;
             if (n == 0)
@@ -254,8 +320,8 @@ static char* get_actions(const char* dir, const char* type, GArray* actions)
                  * stolen or freed. */
                 g_free(apps);
             }
+            g_key_file_unref(file);
         }
-        g_key_file_free(file);
         if (!g_strcmp0(dir, g_get_user_config_dir()))
             break; // no mimeinfo.cache in ~/.config
     }
@@ -263,12 +329,7 @@ static char* get_actions(const char* dir, const char* type, GArray* actions)
     return NULL; /* return NULL so the for_each operation doesn't stop. */
 }
 
-/*
- *  Get a list of applications supporting this mime-type
- * The returned string array was newly allocated, and should be
- * freed with g_strfreev() when no longer used.
- */
-char** mime_type_get_actions(const char* type)
+static char** get_actions_for_type(const char* type)
 {
     GArray* actions = g_array_sized_new(TRUE, FALSE, sizeof(char*), 10);
     char* default_app = NULL;
@@ -304,6 +365,34 @@ char** mime_type_get_actions(const char* type)
     return (char**)g_array_free(actions, actions->len == 0);
 }
 
+/*
+ *  Get a list of applications supporting this mime-type
+ * The returned string array was newly allocated, and should be
+ * freed with g_strfreev() when no longer used.
+ */
+char** mime_type_get_actions(const char* type)
+{
+    gpointer value;
+    char** actions;
+
+    G_LOCK(action_index);
+    action_index_init();
+    gboolean cached = g_hash_table_lookup_extended(type_actions, type, NULL, &value);
+    actions = g_strdupv((char**)value);
+    uint serial = index_serial;
+    G_UNLOCK(action_index);
+    if (cached)
+        return actions;
+
+    actions = get_actions_for_type(type);
+
+    G_LOCK(action_index);
+    if (serial == index_serial) // not reloaded meanwhile
+        g_hash_table_replace(type_actions, g_strdup(type), g_strdupv(actions));
+    G_UNLOCK(action_index);
+    return actions;
+}
+
 /*
  * NOTE:
  * This API is very time consuming, but unfortunately, due to the damn poor design of
@@ -495,6 +584,7 @@ static char* make_custom_desktop_file(const char* desktop_id, const char* mime_t
 
         /* execute update-desktop-database" to update mimeinfo.cache */
         update_desktop_database();
+        mime_type_action_reload();
     }
     return cust;
 }
@@ -592,7 +682,26 @@ char* mime_type_locate_desktop_file(const char* dir, const char* desktop_id)
 {
     if (dir)
         return _locate_desktop_file(dir, NULL, (gpointer)desktop_id);
-    return apps_dir_foreach(_locate_desktop_file, NULL, (gpointer)desktop_id);
+
+    gpointer value;
+    char* path;
+
+    G_LOCK(action_index);
+    action_index_init();
+    gboolean cached = g_hash_table_lookup_extended(desktop_paths, desktop_id, NULL, &value);
+    path = g_strdup((char*)value);
+    uint serial = index_serial;
+    G_UNLOCK(action_index);
+    if (cached)
+        return path;
+
+    path = apps_dir_foreach(_locate_desktop_file, NULL, (gpointer)desktop_id);
+
+    G_LOCK(action_index);
+    if (serial == index_serial) // not reloaded meanwhile
+        g_hash_table_replace(desktop_paths, g_strdup(desktop_id), g_strdup(path));
+    G_UNLOCK(action_index);
+    return path;
 }
 
 static char* get_default_action(const char* dir, const char* type, gpointer user_data)
@@ -607,10 +716,9 @@ static char* get_default_action(const char* dir, const char* type, gpointer user
     {
         char* path = g_build_filename(dir, names[n], NULL);
         // g_print( "    path = %s\n", path );
-        GKeyFile* file = g_key_file_new();
-        gboolean opened = g_key_file_load_from_file(file, path, 0, NULL);
+        GKeyFile* file = load_key_file(path);
         g_free(path);
-        if (opened)
+        if (file)
         {
             int k;
             for (k = 0; k < G_N_ELEMENTS(groups); k++)
@@ -632,7 +740,7 @@ static char* get_default_action(const char* dir, const char* type, gpointer user
                                 g_free(path);
                                 path = g_strdup(apps[i]);
                                 g_strfreev(apps);
-                                g_key_file_free(file);
+                                g_key_file_unref(file);
                                 return path;
                             }
                         }
@@ -642,8 +750,8 @@ static char* get_default_action(const char* dir, const char* type, gpointer user
                 if (n == 1)
                     break; // defaults.list doesn't have Added Associations
             }
+            g_key_file_unref(file);
         }
-        g_key_file_free(file);
         if (!g_strcmp0(dir, g_get_user_config_dir()))
             break; // no defaults.list in ~/.config
     }
@@ -662,8 +770,26 @@ static char* get_default_action(const char* dir, const char* type, gpointer user
  */
 char* mime_type_get_default_action(const char* type)
 {
+    gpointer value;
+    char* def;
+
+    G_LOCK(action_index);
+    action_index_init();
+    gboolean cached = g_hash_table_lookup_extended(type_defaults, type, NULL, &value);
+    def = g_strdup((char*)value);
+    uint serial = index_serial;
+    G_UNLOCK(action_index);
+    if (cached)
+        return def;
+
     /* FIXME: need to check parent types if default action of current type is not set. */
-    return data_dir_foreach((DataDirFunc)get_default_action, type, NULL);
+    def = data_dir_foreach((DataDirFunc)get_default_action, type, NULL);
+
+    G_LOCK(action_index);
+    if (serial == index_serial) // not reloaded meanwhile
+        g_hash_table_replace(type_defaults, g_strdup(type), g_strdup(def));
+    G_UNLOCK(action_index);
+    return def;
 }
 
 /*
@@ -828,6 +954,7 @@ void mime_type_update_association(const char* type, const char* desktop_id, int
         char* data = g_key_file_to_data(file, &len, NULL);
         save_to_file(path, data, len);
         g_free(data);
+        mime_type_action_reload();
     }
     g_key_file_free(file);
     g_free(path);
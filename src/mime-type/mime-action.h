@@ -81,6 +81,8 @@ void mime_type_update_association(const char* type, const char* desktop_id, int
 /* Locate the file path of desktop file by desktop_id */
 char* mime_type_locate_desktop_file(const char* dir, const char* desktop_id);
 
+void mime_type_action_reload();
+
 G_END_DECLS
 
 #endif
@@ -145,13 +145,13 @@ const char* mime_type_get_by_filename(const char* filename, struct stat* statbuf
 const char* mime_type_get_by_file(const char* filepath, struct stat* statbuf, const char* basename)
 {
     const char* type;
+    struct stat _statbuf; /* statbuf may point to it until the end */
 
     /* IMPORTANT!! vfs-file-info.c:vfs_file_info_reload_mime_type() depends
      * on this function only using the st_mode from statbuf.
      * Also see vfs-dir.c:vfs_dir_load_thread */
     if (statbuf == NULL || G_UNLIKELY(S_ISLNK(statbuf->st_mode)))
     {
-        struct stat _statbuf;
         statbuf = &_statbuf;
         if (stat(filepath, statbuf) == -1)
             return XDG_MIME_TYPE_UNKNOWN;
@@ -721,12 +721,84 @@ static PtkDirTreeNode* find_node(PtkDirTreeNode* parent, const char* name)
     return NULL;
 }
 
+/* Events were lost, list the subdirs of node again and only add and
+ * remove the differences, so expanded children stay as they are */
+static void ptk_dir_tree_rescan_children(PtkDirTree* tree, PtkDirTreeNode* node, const char* path)
+{
+    GHashTable* listed = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    GDir* dir = g_dir_open(path, 0, NULL);
+    if (dir)
+    {
+        const char* name;
+        while ((name = g_dir_read_name(dir)))
+        {
+            char* file_path = g_build_filename(path, name, NULL);
+            if (g_file_test(file_path, G_FILE_TEST_IS_DIR))
+                g_hash_table_add(listed, g_strdup(name));
+            g_free(file_path);
+        }
+        g_dir_close(dir);
+    }
+
+    PtkDirTreeNode* child;
+    PtkDirTreeNode* next;
+    for (child = node->children; child; child = next)
+    {
+        next = child->next;
+        if (child->file && !g_hash_table_contains(listed, vfs_file_info_get_name(child->file)))
+            ptk_dir_tree_delete_child(tree, child);
+    }
+
+    GHashTableIter it;
+    const char* name;
+    g_hash_table_iter_init(&it, listed);
+    while (g_hash_table_iter_next(&it, (gpointer*)&name, NULL))
+    {
+        if (!find_node(node, name))
+        {
+            char* file_path = g_build_filename(path, name, NULL);
+            ptk_dir_tree_insert_child(tree, node, file_path, name);
+            g_free(file_path);
+        }
+    }
+    g_hash_table_destroy(listed);
+
+    /* remove place holder */
+    if (node->n_children > 1)
+    {
+        for (child = node->children; child; child = child->next)
+        {
+            if (!child->file)
+            {
+                ptk_dir_tree_delete_child(tree, child);
+                break;
+            }
+        }
+    }
+}
+
 void on_file_monitor_event(VFSFileMonitor* fm, VFSFileMonitorEvent event, const char* file_name, gpointer user_data)
 {
     PtkDirTreeNode* node = (PtkDirTreeNode*)user_data;
     g_return_if_fail(node);
     GDK_THREADS_ENTER();
 
+    if (event == VFS_FILE_MONITOR_OVERFLOW)
+    {
+        ptk_dir_tree_rescan_children(node->tree, node, fm->path);
+        GDK_THREADS_LEAVE();
+        return;
+    }
+
+    if (event == VFS_FILE_MONITOR_RENAME)
+    {
+        /* a node is kept per name, so it is replaced */
+        PtkDirTreeNode* old_child = find_node(node, fm->renamed_from);
+        if (old_child)
+            ptk_dir_tree_delete_child(node->tree, old_child);
+        event = VFS_FILE_MONITOR_CREATE;
+    }
+
     PtkDirTreeNode* child = find_node(node, file_name);
     switch (event)
     {
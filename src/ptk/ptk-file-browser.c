@@ -46,6 +46,7 @@
 #include "ptk-dir-tree.h"
 
 #include "../vfs/vfs-dir.h"
+#include "../vfs/vfs-list-cache.h"
 #include "../vfs/vfs-utils.h"
 #include "../vfs/vfs-file-info.h"
 #include "../vfs/vfs-file-monitor.h"
@@ -89,6 +90,7 @@ void ptk_file_browser_open_selected_files(PtkFileBrowser* file_browser);
 static void ptk_file_browser_cut_or_copy(PtkFileBrowser* file_browser, gboolean copy);
 
 static void ptk_file_browser_update_model(PtkFileBrowser* file_browser);
+static void on_folder_view_scrolled(GtkAdjustment* adjustment, PtkFileBrowser* file_browser);
 
 /* Get GtkTreePath of the item at coordinate x, y */
 static GtkTreePath* folder_view_get_tree_path_at_pos(PtkFileBrowser* file_browser, int x, int y);
@@ -176,6 +178,10 @@ static GtkTargetEntry drag_targets[] = {{"text/uri-list", 0, 0}};
 
 #define GDK_ACTION_ALL (GDK_ACTION_MOVE | GDK_ACTION_COPY | GDK_ACTION_LINK)
 
+/* larger selections are not sniffed on the main thread, see
+ * ptk_file_browser_get_selected_files */
+#define PTK_FILE_BROWSER_SNIFF_SELECTED 32
+
 // must match main-window.c  main_window_socket_command
 const char* column_titles[] = {N_("Name"), N_("Size"), N_("Type"), N_("Permission"), N_("Owner"), N_("Modified")};
 
@@ -1163,6 +1169,18 @@ void ptk_file_browser_init(PtkFileBrowser* file_browser)
     file_browser->folder_view_scroll = gtk_scrolled_window_new(NULL, NULL);
     gtk_paned_pack1(GTK_PANED(file_browser->hpane), file_browser->side_vbox, FALSE, FALSE);
     gtk_paned_pack2(GTK_PANED(file_browser->hpane), file_browser->folder_view_scroll, TRUE, TRUE);
+    g_signal_connect(gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(file_browser->folder_view_scroll)),
+                     "value-changed",
+                     G_CALLBACK(on_folder_view_scrolled),
+                     file_browser);
+    g_signal_connect(gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(file_browser->folder_view_scroll)),
+                     "changed",
+                     G_CALLBACK(on_folder_view_scrolled),
+                     file_browser);
+    g_signal_connect(gtk_scrolled_window_get_hadjustment(GTK_SCROLLED_WINDOW(file_browser->folder_view_scroll)),
+                     "value-changed",
+                     G_CALLBACK(on_folder_view_scrolled),
+                     file_browser);
 
     // fill side
 #if (GTK_MAJOR_VERSION == 3)
@@ -1297,6 +1315,8 @@ void ptk_file_browser_finalize(GObject* obj)
     if (file_browser->dir)
     {
         g_signal_handlers_disconnect_matched(file_browser->dir, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, file_browser);
+        if (file_browser->shown)
+            vfs_dir_set_shown(file_browser->dir, FALSE);
         g_object_unref(file_browser->dir);
     }
 
@@ -2043,6 +2063,10 @@ gboolean ptk_file_browser_chdir(PtkFileBrowser* file_browser, const char* folder
     if (file_browser->dir)
     {
         g_signal_handlers_disconnect_matched(file_browser->dir, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, file_browser);
+        // the dir may outlive this view, don't keep its sort keys around
+        vfs_dir_unload_collate_keys(file_browser->dir);
+        if (file_browser->shown)
+            vfs_dir_set_shown(file_browser->dir, FALSE);
         g_object_unref(file_browser->dir);
     }
 
@@ -2054,6 +2078,8 @@ gboolean ptk_file_browser_chdir(PtkFileBrowser* file_browser, const char* folder
     // load new dir
     file_browser->busy = TRUE;
     file_browser->dir = vfs_dir_get_by_path(path);
+    if (file_browser->shown)
+        vfs_dir_set_shown(file_browser->dir, TRUE);
 
     if (!file_browser->curHistory || path != (char*)file_browser->curHistory->data)
         g_free(path);
@@ -2066,7 +2092,11 @@ gboolean ptk_file_browser_chdir(PtkFileBrowser* file_browser, const char* folder
         file_browser->busy = FALSE;
     }
     else
+    {
         file_browser->busy = TRUE;
+        // show files while the dir is still loading
+        ptk_file_browser_update_model(file_browser);
+    }
 
     g_signal_connect(file_browser->dir, "file-listed", G_CALLBACK(on_dir_file_listed), file_browser);
 
@@ -2362,9 +2392,21 @@ void on_dir_file_listed(VFSDir* dir, gboolean is_cancelled, PtkFileBrowser* file
         g_signal_connect(dir, "file-created", G_CALLBACK(on_folder_content_changed), file_browser);
         g_signal_connect(dir, "file-deleted", G_CALLBACK(on_file_deleted), file_browser);
         g_signal_connect(dir, "file-changed", G_CALLBACK(on_folder_content_changed), file_browser);
+        g_signal_connect(dir, "file-renamed", G_CALLBACK(on_folder_content_changed), file_browser);
     }
 
-    ptk_file_browser_update_model(file_browser);
+    if (file_browser->busy && file_browser->file_list && PTK_FILE_LIST(file_browser->file_list)->dir == dir)
+    {
+        // files were streamed into the model while loading, so only sort them now
+        ptk_file_list_sort(PTK_FILE_LIST(file_browser->file_list));
+        if (G_LIKELY(!is_cancelled))
+            show_thumbnails(file_browser,
+                            PTK_FILE_LIST(file_browser->file_list),
+                            file_browser->large_icons,
+                            file_browser->max_thumbnail);
+    }
+    else
+        ptk_file_browser_update_model(file_browser);
     file_browser->busy = FALSE;
 
     /* Ensuring free space at the end of the heap is freed to the OS,
@@ -4037,6 +4079,13 @@ void ptk_file_browser_refresh(GtkWidget* item, PtkFileBrowser* file_browser)
     if (file_browser->dir)
     {
         g_signal_handlers_disconnect_matched(file_browser->dir, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, file_browser);
+        // don't get the same dir back from the cache of recent dirs
+        vfs_dir_uncache(file_browser->dir);
+        // nor a saved listing
+        if (file_browser->dir->list_cache)
+            vfs_list_cache_remove(file_browser->dir->path);
+        if (file_browser->shown)
+            vfs_dir_set_shown(file_browser->dir, FALSE);
         g_object_unref(file_browser->dir);
         file_browser->dir = NULL;
     }
@@ -4054,6 +4103,8 @@ void ptk_file_browser_refresh(GtkWidget* item, PtkFileBrowser* file_browser)
     // begin load dir
     file_browser->busy = TRUE;
     file_browser->dir = vfs_dir_get_by_path(ptk_file_browser_get_cwd(file_browser));
+    if (file_browser->shown)
+        vfs_dir_set_shown(file_browser->dir, TRUE);
     g_signal_emit(file_browser, signals[BEGIN_CHDIR_SIGNAL], 0);
     if (vfs_dir_is_file_listed(file_browser->dir))
     {
@@ -4067,6 +4118,8 @@ void ptk_file_browser_refresh(GtkWidget* item, PtkFileBrowser* file_browser)
         file_browser->busy = TRUE;
         g_free(file_browser->select_path);
         file_browser->select_path = g_strdup(cursor_path);
+        // show files while the dir is still loading
+        ptk_file_browser_update_model(file_browser);
     }
     g_signal_connect(file_browser->dir, "file-listed", G_CALLBACK(on_dir_file_listed), file_browser);
 
@@ -4078,6 +4131,16 @@ uint ptk_file_browser_get_n_all_files(PtkFileBrowser* file_browser)
     return file_browser->dir ? file_browser->dir->n_files : 0;
 }
 
+/* The browser became or is no longer the current tab of its panel */
+void ptk_file_browser_set_shown(PtkFileBrowser* file_browser, gboolean shown)
+{
+    if (!file_browser->shown == !shown)
+        return;
+    file_browser->shown = shown;
+    if (file_browser->dir)
+        vfs_dir_set_shown(file_browser->dir, shown);
+}
+
 uint ptk_file_browser_get_n_visible_files(PtkFileBrowser* file_browser)
 {
     return file_browser->file_list ? gtk_tree_model_iter_n_children(file_browser->file_list, NULL) : 0;
@@ -4708,6 +4771,9 @@ GList* ptk_file_browser_get_selected_files(PtkFileBrowser* file_browser)
 
     GList* sel;
     GList* file_list = NULL;
+    // callers act on the mime type, so don't hand out a guessed one, but
+    // only sniff a few files here, the worker sniffs large selections
+    gboolean sniff = g_list_length(sel_files) <= PTK_FILE_BROWSER_SNIFF_SELECTED;
 
     for (sel = sel_files; sel; sel = g_list_next(sel))
     {
@@ -4715,8 +4781,14 @@ GList* ptk_file_browser_get_selected_files(PtkFileBrowser* file_browser)
         VFSFileInfo* file;
         gtk_tree_model_get_iter(model, &it, (GtkTreePath*)sel->data);
         gtk_tree_model_get(model, &it, COL_FILE_INFO, &file, -1);
-        file_list = g_list_append(file_list, file);
-    }
+        if (sniff && file_browser->dir && vfs_dir_load_mime_type(file_browser->dir, file) &&
+            PTK_IS_FILE_LIST(model))
+            ptk_file_list_file_changed(file_browser->dir, file, PTK_FILE_LIST(model));
+        file_list = g_list_prepend(file_list, file);
+    }
+    file_list = g_list_reverse(file_list);
+    if (!sniff && file_browser->dir)
+        vfs_dir_load_mime_types(file_browser->dir, file_list);
     g_list_foreach(sel_files, (GFunc)gtk_tree_path_free, NULL);
     g_list_free(sel_files);
     return file_list;
@@ -5310,6 +5382,45 @@ void show_thumbnails(PtkFileBrowser* file_browser, PtkFileList* list, gboolean i
         max_file_size = 0;
     ptk_file_list_show_thumbnails(list, is_big, max_file_size);
     ptk_file_browser_update_toolbar_widgets(file_browser, NULL, XSET_TOOL_SHOW_THUMB);
+    if (file_browser)
+        on_folder_view_scrolled(NULL, file_browser);
+}
+
+static gboolean on_visible_range_timeout(PtkFileBrowser* file_browser)
+{
+    /* load mime types and thumbnails of the rows on screen before the rest of the folder */
+    GtkTreePath* start_path = NULL;
+    GtkTreePath* end_path = NULL;
+    gboolean found = FALSE;
+
+    file_browser->visible_range_timeout = 0;
+    if (!file_browser->file_list || !file_browser->folder_view ||
+        !gtk_widget_get_realized(file_browser->folder_view))
+        return FALSE;
+
+    if (file_browser->view_mode == PTK_FB_ICON_VIEW || file_browser->view_mode == PTK_FB_COMPACT_VIEW)
+        found = exo_icon_view_get_visible_range(EXO_ICON_VIEW(file_browser->folder_view), &start_path, &end_path);
+    else if (file_browser->view_mode == PTK_FB_LIST_VIEW)
+        found = gtk_tree_view_get_visible_range(GTK_TREE_VIEW(file_browser->folder_view), &start_path, &end_path);
+
+    if (found)
+    {
+        ptk_file_list_set_visible_range(PTK_FILE_LIST(file_browser->file_list),
+                                        gtk_tree_path_get_indices(start_path)[0],
+                                        gtk_tree_path_get_indices(end_path)[0]);
+        gtk_tree_path_free(start_path);
+        gtk_tree_path_free(end_path);
+    }
+    return FALSE;
+}
+
+void on_folder_view_scrolled(GtkAdjustment* adjustment, PtkFileBrowser* file_browser)
+{
+    // wait for scrolling to settle before loading the rows on screen
+    if (file_browser->visible_range_timeout)
+        return;
+    file_browser->visible_range_timeout =
+        g_timeout_add(100, (GSourceFunc)on_visible_range_timeout, file_browser);
 }
 
 void ptk_file_browser_show_thumbnails(PtkFileBrowser* file_browser, int max_file_size)
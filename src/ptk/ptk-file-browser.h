@@ -86,6 +86,7 @@ struct _PtkFileBrowser
     gboolean is_drag : 1;
     gboolean skip_release : 1;
     gboolean menu_shown : 1;
+    gboolean shown : 1; /* current tab of its panel, counted by its dir */
     char* book_set_name;
 
     /* folder view */
@@ -96,6 +97,7 @@ struct _PtkFileBrowser
 
     glong prev_update_time;
     uint update_timeout;
+    uint visible_range_timeout;
 
     // MOD
     int mypanel;
@@ -173,6 +175,7 @@ const char* ptk_file_browser_get_cwd(PtkFileBrowser* file_browser);
 
 uint ptk_file_browser_get_n_all_files(PtkFileBrowser* file_browser);
 uint ptk_file_browser_get_n_visible_files(PtkFileBrowser* file_browser);
+void ptk_file_browser_set_shown(PtkFileBrowser* file_browser, gboolean shown);
 
 uint ptk_file_browser_get_n_sel(PtkFileBrowser* file_browser, guint64* sel_size);
 
@@ -72,6 +72,8 @@ static void ptk_file_list_set_default_sort_func(GtkTreeSortable* sortable, GtkTr
 
 static void on_thumbnail_loaded(VFSDir* dir, VFSFileInfo* file, PtkFileList* list);
 
+static void on_files_loaded(VFSDir* dir, GList* files, PtkFileList* list);
+
 /*
  * already declared in ptk-file-list.h
 void ptk_file_list_file_created( VFSDir* dir, VFSFileInfo* file,
@@ -125,7 +127,9 @@ GType ptk_file_list_get_type(void)
 void ptk_file_list_init(PtkFileList* list)
 {
     list->n_files = 0;
-    list->files = NULL;
+    list->files = g_sequence_new((GDestroyNotify)vfs_file_info_unref);
+    list->file_iters = g_hash_table_new(g_direct_hash, g_direct_equal);
+    list->name_rows = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
     list->sort_order = -1;
     list->sort_col = -1;
     /* Random int to check whether an iter belongs to our model */
@@ -194,6 +198,9 @@ void ptk_file_list_finalize(GObject* object)
     PtkFileList* list = (PtkFileList*)object;
 
     ptk_file_list_set_dir(list, NULL);
+    g_hash_table_destroy(list->file_iters);
+    g_hash_table_destroy(list->name_rows);
+    g_sequence_free(list->files);
     /* must chain up - finalize parent */
     (*parent_class->finalize)(object);
 }
@@ -207,6 +214,15 @@ PtkFileList* ptk_file_list_new(VFSDir* dir, gboolean show_hidden)
     return list;
 }
 
+static gboolean on_resort_idle(PtkFileList* list)
+{
+    GDK_THREADS_ENTER();
+    list->resort_idle = 0;
+    ptk_file_list_sort(list);
+    GDK_THREADS_LEAVE();
+    return FALSE;
+}
+
 static void _ptk_file_list_file_changed(VFSDir* dir, VFSFileInfo* file, PtkFileList* list)
 {
     if (!file || !dir || dir->cancel)
@@ -214,6 +230,10 @@ static void _ptk_file_list_file_changed(VFSDir* dir, VFSFileInfo* file, PtkFileL
 
     ptk_file_list_file_changed(dir, file, list);
 
+    /* a sniffed or changed type may move the row, sort once per batch */
+    if (list->sort_col == COL_FILE_DESC && !list->resort_idle)
+        list->resort_idle = g_idle_add_full(G_PRIORITY_LOW, (GSourceFunc)on_resort_idle, list, NULL);
+
     /* check if reloading of thumbnail is needed.
      * See also desktop-window.c:on_file_changed() */
     if (list->max_thumbnail != 0 &&
@@ -225,6 +245,20 @@ static void _ptk_file_list_file_changed(VFSDir* dir, VFSFileInfo* file, PtkFileL
     }
 }
 
+static void _ptk_file_list_file_renamed(VFSDir* dir, VFSFileInfo* file, PtkFileList* list)
+{
+    ptk_file_list_file_renamed(dir, file, list);
+
+    /* the new name may make it an image or a video */
+    if (list->max_thumbnail != 0 &&
+        (vfs_file_info_is_video(file) ||
+         (file->size /*vfs_file_info_get_size( file )*/ < list->max_thumbnail && vfs_file_info_is_image(file))))
+    {
+        if (!vfs_file_info_is_thumbnail_loaded(file, list->big_thumbnail))
+            vfs_thumbnail_loader_request(list->dir, file, list->big_thumbnail);
+    }
+}
+
 static void _ptk_file_list_file_created(VFSDir* dir, VFSFileInfo* file, PtkFileList* list)
 {
     ptk_file_list_file_created(dir, file, list);
@@ -239,29 +273,65 @@ static void _ptk_file_list_file_created(VFSDir* dir, VFSFileInfo* file, PtkFileL
     }
 }
 
+static void ptk_file_list_index_row(PtkFileList* list, VFSFileInfo* file, GSequenceIter* l)
+{
+    g_hash_table_insert(list->file_iters, file, l);
+    g_hash_table_insert(list->name_rows, g_strdup(file->name), file);
+}
+
+static void ptk_file_list_unindex_row(PtkFileList* list, VFSFileInfo* file)
+{
+    g_hash_table_remove(list->file_iters, file);
+    if (g_hash_table_lookup(list->name_rows, file->name) == file)
+        g_hash_table_remove(list->name_rows, file->name);
+}
+
+/* The row of the file named name.  The entry of a renamed file is only
+ * dropped once its old name is looked up or reused, its file may be gone
+ * by then, so it is only read if it still has a row. */
+static VFSFileInfo* ptk_file_list_find_name(PtkFileList* list, const char* name)
+{
+    VFSFileInfo* file = (VFSFileInfo*)g_hash_table_lookup(list->name_rows, name);
+    if (file && (!g_hash_table_contains(list->file_iters, file) || strcmp(file->name, name)))
+    {
+        g_hash_table_remove(list->name_rows, name);
+        file = NULL;
+    }
+    return file;
+}
+
 void ptk_file_list_set_dir(PtkFileList* list, VFSDir* dir)
 {
     if (list->dir == dir)
         return;
 
+    if (list->resort_idle)
+    {
+        g_source_remove(list->resort_idle);
+        list->resort_idle = 0;
+    }
     if (list->dir)
     {
+        vfs_thumbnail_loader_prioritize(list->dir, list, NULL, list->big_thumbnail);
+        vfs_dir_set_shown_files(list->dir, list, NULL);
         if (list->max_thumbnail > 0)
         {
             /* cancel all possible pending requests */
             vfs_thumbnail_loader_cancel_all_requests(list->dir, list->big_thumbnail);
         }
-        g_list_foreach(list->files, (GFunc)vfs_file_info_unref, NULL);
-        g_list_free(list->files);
+        g_hash_table_remove_all(list->file_iters);
+        g_hash_table_remove_all(list->name_rows);
+        g_sequence_remove_range(g_sequence_get_begin_iter(list->files), g_sequence_get_end_iter(list->files));
         g_signal_handlers_disconnect_by_func(list->dir, _ptk_file_list_file_created, list);
         g_signal_handlers_disconnect_by_func(list->dir, ptk_file_list_file_deleted, list);
         g_signal_handlers_disconnect_by_func(list->dir, _ptk_file_list_file_changed, list);
+        g_signal_handlers_disconnect_by_func(list->dir, _ptk_file_list_file_renamed, list);
         g_signal_handlers_disconnect_by_func(list->dir, on_thumbnail_loaded, list);
+        g_signal_handlers_disconnect_by_func(list->dir, on_files_loaded, list);
         g_object_unref(list->dir);
     }
 
     list->dir = dir;
-    list->files = NULL;
     list->n_files = 0;
     if (!dir)
         return;
@@ -271,6 +341,9 @@ void ptk_file_list_set_dir(PtkFileList* list, VFSDir* dir)
     g_signal_connect(list->dir, "file-created", G_CALLBACK(_ptk_file_list_file_created), list);
     g_signal_connect(list->dir, "file-deleted", G_CALLBACK(ptk_file_list_file_deleted), list);
     g_signal_connect(list->dir, "file-changed", G_CALLBACK(_ptk_file_list_file_changed), list);
+    g_signal_connect(list->dir, "file-renamed", G_CALLBACK(_ptk_file_list_file_renamed), list);
+    /* rows are streamed in while the dir is still loading */
+    g_signal_connect(list->dir, "files-loaded", G_CALLBACK(on_files_loaded), list);
 
     if (dir && dir->file_list)
     {
@@ -279,7 +352,8 @@ void ptk_file_list_set_dir(PtkFileList* list, VFSDir* dir)
         {
             if (list->show_hidden || ((VFSFileInfo*)l->data)->disp_name[0] != '.')
             {
-                list->files = g_list_prepend(list->files, vfs_file_info_ref((VFSFileInfo*)l->data));
+                VFSFileInfo* file = vfs_file_info_ref((VFSFileInfo*)l->data);
+                ptk_file_list_index_row(list, file, g_sequence_prepend(list->files, file));
                 ++list->n_files;
             }
         }
@@ -322,14 +396,14 @@ gboolean ptk_file_list_get_iter(GtkTreeModel* tree_model, GtkTreeIter* iter, Gtk
     if (n >= list->n_files || n < 0)
         return FALSE;
 
-    GList* l = g_list_nth(list->files, n);
+    GSequenceIter* l = g_sequence_get_iter_at_pos(list->files, n);
 
-    g_assert(l != NULL);
+    g_assert(!g_sequence_iter_is_end(l));
 
     /* We simply store a pointer in the iter */
     iter->stamp = list->stamp;
     iter->user_data = l;
-    iter->user_data2 = l->data;
+    iter->user_data2 = g_sequence_get(l);
     iter->user_data3 = NULL; /* unused */
 
     return TRUE;
@@ -338,7 +412,7 @@ gboolean ptk_file_list_get_iter(GtkTreeModel* tree_model, GtkTreeIter* iter, Gtk
 GtkTreePath* ptk_file_list_get_path(GtkTreeModel* tree_model, GtkTreeIter* iter)
 {
     GtkTreePath* path;
-    GList* l;
+    GSequenceIter* l;
     PtkFileList* list = PTK_FILE_LIST(tree_model);
 
     g_return_val_if_fail(list, NULL);
@@ -346,10 +420,10 @@ GtkTreePath* ptk_file_list_get_path(GtkTreeModel* tree_model, GtkTreeIter* iter)
     g_return_val_if_fail(iter != NULL, NULL);
     g_return_val_if_fail(iter->user_data != NULL, NULL);
 
-    l = (GList*)iter->user_data;
+    l = (GSequenceIter*)iter->user_data;
 
     path = gtk_tree_path_new();
-    gtk_tree_path_append_index(path, g_list_index(list->files, l->data));
+    gtk_tree_path_append_index(path, g_sequence_iter_get_position(l));
     return path;
 }
 
@@ -364,8 +438,7 @@ void ptk_file_list_get_value(GtkTreeModel* tree_model, GtkTreeIter* iter, int co
 
     g_value_init(value, column_types[column]);
 
-    GList* l = (GList*)iter->user_data;
-    g_return_if_fail(l != NULL);
+    g_return_if_fail(iter->user_data != NULL);
 
     VFSFileInfo* info = (VFSFileInfo*)iter->user_data2;
 
@@ -374,7 +447,7 @@ void ptk_file_list_get_value(GtkTreeModel* tree_model, GtkTreeIter* iter, int co
     case COL_FILE_BIG_ICON:
         icon = NULL;
         /* special file can use special icons saved as thumbnails*/
-        if (info->flags == VFS_FILE_INFO_NONE && (list->max_thumbnail > info->size /*vfs_file_info_get_size( info )*/
+        if ((info->flags & ~VFS_FILE_INFO_MIME_PENDING) == VFS_FILE_INFO_NONE && (list->max_thumbnail > info->size /*vfs_file_info_get_size( info )*/
                                                   || (list->max_thumbnail != 0 && vfs_file_info_is_video(info))))
             icon = vfs_file_info_get_big_thumbnail(info);
 
@@ -408,7 +481,11 @@ void ptk_file_list_get_value(GtkTreeModel* tree_model, GtkTreeIter* iter, int co
             (S_ISLNK(info->mode) && 0 == strcmp(vfs_mime_type_get_type(info->mime_type), XDG_MIME_TYPE_DIRECTORY)))
             g_value_set_string(value, NULL);
         else
-            g_value_set_string(value, vfs_file_info_get_disp_size(info));
+        {
+            char buf[64];
+            vfs_file_info_get_disp_size(info, buf);
+            g_value_set_string(value, buf);
+        }
         break;
     case COL_FILE_DESC:
         g_value_set_string(value, vfs_file_info_get_mime_type_desc(info));
@@ -420,8 +497,12 @@ void ptk_file_list_get_value(GtkTreeModel* tree_model, GtkTreeIter* iter, int co
         g_value_set_string(value, vfs_file_info_get_disp_owner(info));
         break;
     case COL_FILE_MTIME:
-        g_value_set_string(value, vfs_file_info_get_disp_mtime(info));
+    {
+        char buf[64];
+        vfs_file_info_get_disp_mtime(info, buf);
+        g_value_set_string(value, buf);
         break;
+    }
     case COL_FILE_INFO:
         g_value_set_pointer(value, vfs_file_info_ref(info));
         break;
@@ -438,15 +519,15 @@ gboolean ptk_file_list_iter_next(GtkTreeModel* tree_model, GtkTreeIter* iter)
         return FALSE;
 
     PtkFileList* list = PTK_FILE_LIST(tree_model);
-    GList* l = (GList*)iter->user_data;
+    GSequenceIter* l = g_sequence_iter_next((GSequenceIter*)iter->user_data);
 
     /* Is this the last l in the list? */
-    if (!l->next)
+    if (g_sequence_iter_is_end(l))
         return FALSE;
 
     iter->stamp = list->stamp;
-    iter->user_data = l->next;
-    iter->user_data2 = l->next->data;
+    iter->user_data = l;
+    iter->user_data2 = g_sequence_get(l);
 
     return TRUE;
 }
@@ -464,13 +545,14 @@ gboolean ptk_file_list_iter_children(GtkTreeModel* tree_model, GtkTreeIter* iter
     PtkFileList* list = PTK_FILE_LIST(tree_model);
 
     /* No rows => no first row */
-    if (list->dir->n_files == 0)
+    if (list->n_files == 0)
         return FALSE;
 
     /* Set iter to first item in list */
+    GSequenceIter* l = g_sequence_get_begin_iter(list->files);
     iter->stamp = list->stamp;
-    iter->user_data = list->files;
-    iter->user_data2 = list->files->data;
+    iter->user_data = l;
+    iter->user_data2 = g_sequence_get(l);
     return TRUE;
 }
 
@@ -503,12 +585,12 @@ gboolean ptk_file_list_iter_nth_child(GtkTreeModel* tree_model, GtkTreeIter* ite
     if (n >= list->n_files || n < 0)
         return FALSE;
 
-    GList* l = g_list_nth(list->files, n);
-    g_assert(l != NULL);
+    GSequenceIter* l = g_sequence_get_iter_at_pos(list->files, n);
+    g_assert(!g_sequence_iter_is_end(l));
 
     iter->stamp = list->stamp;
     iter->user_data = l;
-    iter->user_data2 = l->data;
+    iter->user_data2 = g_sequence_get(l);
 
     return TRUE;
 }
@@ -592,11 +674,13 @@ static int ptk_file_list_compare(gconstpointer a, gconstpointer b, gpointer user
         result = strcmp(file_a->disp_perm, file_b->disp_perm);
         break;
     case COL_FILE_OWNER:
-        if (file_a->disp_owner && file_b->disp_owner)
-            result = g_ascii_strcasecmp(file_a->disp_owner, file_b->disp_owner);
-        else
-            result = g_ascii_strcasecmp(vfs_file_info_get_disp_owner(file_a), vfs_file_info_get_disp_owner(file_b));
+    {
+        /* interned, and cached by uid/gid, so cheap after the first call */
+        const char* owner_a = vfs_file_info_get_disp_owner(file_a);
+        const char* owner_b = vfs_file_info_get_disp_owner(file_b);
+        result = owner_a == owner_b ? 0 : g_ascii_strcasecmp(owner_a, owner_b);
         break;
+    }
     default:
         result = 0;
     }
@@ -618,10 +702,8 @@ static int ptk_file_list_compare(gconstpointer a, gconstpointer b, gpointer user
     if (list->sort_natural)
     {
         // natural
-        if (list->sort_case)
-            result = strcmp(file_a->collate_key, file_b->collate_key);
-        else
-            result = strcmp(file_a->collate_icase_key, file_b->collate_icase_key);
+        result = strcmp(vfs_file_info_get_collate_key(file_a, !list->sort_case),
+                        vfs_file_info_get_collate_key(file_b, !list->sort_case));
     }
     else
     {
@@ -643,18 +725,39 @@ void ptk_file_list_sort(PtkFileList* list)
         return;
 
     GHashTable* old_order = g_hash_table_new(g_direct_hash, g_direct_equal);
-    /* save old order */
-    GList* l;
+    /* save old order, sequence iters stay valid while sorting */
+    GSequenceIter* l;
     int i;
-    for (i = 0, l = list->files; l; l = l->next, ++i)
+
+    /* files still typed by their name are sorted by that guess, and sorted
+     * again when the worker has sniffed them, see on_resort_idle */
+    if (list->sort_col == COL_FILE_DESC && list->dir)
+    {
+        GList* pending = NULL;
+        for (l = g_sequence_get_begin_iter(list->files); !g_sequence_iter_is_end(l); l = g_sequence_iter_next(l))
+        {
+            VFSFileInfo* file = (VFSFileInfo*)g_sequence_get(l);
+            if (vfs_file_info_is_mime_pending(file))
+                pending = g_list_prepend(pending, file);
+        }
+        if (pending)
+        {
+            pending = g_list_reverse(pending);
+            vfs_dir_load_mime_types(list->dir, pending);
+            g_list_free(pending);
+        }
+    }
+    for (i = 0, l = g_sequence_get_begin_iter(list->files); !g_sequence_iter_is_end(l);
+         l = g_sequence_iter_next(l), ++i)
         g_hash_table_insert(old_order, l, GINT_TO_POINTER(i));
 
     /* sort the list */
-    list->files = g_list_sort_with_data(list->files, ptk_file_list_compare, list);
+    g_sequence_sort(list->files, ptk_file_list_compare, list);
 
     /* save new order */
     int* new_order = g_new(int, list->n_files);
-    for (i = 0, l = list->files; l; l = l->next, ++i)
+    for (i = 0, l = g_sequence_get_begin_iter(list->files); !g_sequence_iter_is_end(l);
+         l = g_sequence_iter_next(l), ++i)
         new_order[i] = GPOINTER_TO_INT(g_hash_table_lookup(old_order, l));
     g_hash_table_destroy(old_order);
     GtkTreePath* path = gtk_tree_path_new();
@@ -665,89 +768,44 @@ void ptk_file_list_sort(PtkFileList* list)
 
 gboolean ptk_file_list_find_iter(PtkFileList* list, GtkTreeIter* it, VFSFileInfo* fi)
 {
-    GList* l;
-    for (l = list->files; l; l = l->next)
+    GSequenceIter* l = g_hash_table_lookup(list->file_iters, fi);
+    if (G_UNLIKELY(!l))
     {
-        VFSFileInfo* fi2 = (VFSFileInfo*)l->data;
-        if (G_UNLIKELY(fi2 == fi || 0 == strcmp(vfs_file_info_get_name(fi), vfs_file_info_get_name(fi2))))
-        {
-            it->stamp = list->stamp;
-            it->user_data = l;
-            it->user_data2 = fi2;
-            return TRUE;
-        }
+        /* not the same VFSFileInfo, look for the same name */
+        VFSFileInfo* named = ptk_file_list_find_name(list, vfs_file_info_get_name(fi));
+        if (!named)
+            return FALSE;
+        l = g_hash_table_lookup(list->file_iters, named);
     }
-    return FALSE;
+    it->stamp = list->stamp;
+    it->user_data = l;
+    it->user_data2 = g_sequence_get(l);
+    return TRUE;
 }
 
 void ptk_file_list_file_created(VFSDir* dir, VFSFileInfo* file, PtkFileList* list)
 {
-    GList* l;
-    GList* ll = NULL;
+    GSequenceIter* l;
     GtkTreeIter it;
     GtkTreePath* path;
 
     if (!list->show_hidden && vfs_file_info_get_name(file)[0] == '.')
         return;
 
-    gboolean is_desktop = vfs_file_info_is_desktop_entry(file); // sfm
-    gboolean is_desktop2;
-
-    for (l = list->files; l; l = l->next)
-    {
-        VFSFileInfo* file2 = (VFSFileInfo*)l->data;
-        if (G_UNLIKELY(file == file2))
-        {
-            /* The file is already in the list */
-            return;
-        }
-
-        is_desktop2 = vfs_file_info_is_desktop_entry(file2);
-        if (is_desktop || is_desktop2)
-        {
-            // at least one is a desktop file, need to compare filenames
-            if (file->name && file2->name)
-            {
-                if (!strcmp(file->name, file2->name))
-                    return;
-            }
-        }
-        else if (ptk_file_list_compare(file2, file, list) == 0)
-        {
-            // disp_name matches ?
-            // ptk_file_list_compare may return 0 on differing display names
-            // if case-insensitive - need to compare filenames
-            if (list->sort_natural && list->sort_case)
-                return;
-            else if (!strcmp(file->name, file2->name))
-                return;
-        }
-
-        if (!ll && ptk_file_list_compare(file2, file, list) > 0)
-        {
-            if (!is_desktop && !is_desktop2)
-                break;
-            else
-                ll = l; // store insertion location based on disp_name
-        }
-    }
-
-    if (ll)
-        l = ll;
+    /* The file is already in the list, or another VFSFileInfo of the same
+     * name, eg a desktop entry, whose display name differs from its name */
+    if (g_hash_table_contains(list->file_iters, file) || ptk_file_list_find_name(list, file->name))
+        return;
 
-    list->files = g_list_insert_before(list->files, l, vfs_file_info_ref(file));
+    l = g_sequence_insert_sorted(list->files, vfs_file_info_ref(file), ptk_file_list_compare, list);
+    ptk_file_list_index_row(list, file, l);
     ++list->n_files;
 
-    if (l)
-        l = l->prev;
-    else
-        l = g_list_last(list->files);
-
     it.stamp = list->stamp;
     it.user_data = l;
     it.user_data2 = file;
 
-    path = gtk_tree_path_new_from_indices(g_list_index(list->files, l->data), -1);
+    path = gtk_tree_path_new_from_indices(g_sequence_iter_get_position(l), -1);
 
     gtk_tree_model_row_inserted(GTK_TREE_MODEL(list), path, &it);
 
@@ -756,7 +814,7 @@ void ptk_file_list_file_created(VFSDir* dir, VFSFileInfo* file, PtkFileList* lis
 
 void ptk_file_list_file_deleted(VFSDir* dir, VFSFileInfo* file, PtkFileList* list)
 {
-    GList* l;
+    GSequenceIter* l;
     GtkTreePath* path;
 
     /* If there is no file info, that means the dir itself was deleted. */
@@ -764,12 +822,12 @@ void ptk_file_list_file_deleted(VFSDir* dir, VFSFileInfo* file, PtkFileList* lis
     {
         /* Clear the whole list */
         path = gtk_tree_path_new_from_indices(0, -1);
-        for (l = list->files; l; l = list->files)
+        while (list->n_files > 0)
         {
             gtk_tree_model_row_deleted(GTK_TREE_MODEL(list), path);
-            file = (VFSFileInfo*)l->data;
-            list->files = g_list_delete_link(list->files, l);
-            vfs_file_info_unref(file);
+            l = g_sequence_get_begin_iter(list->files);
+            ptk_file_list_unindex_row(list, (VFSFileInfo*)g_sequence_get(l));
+            g_sequence_remove(l);
             --list->n_files;
         }
         gtk_tree_path_free(path);
@@ -779,45 +837,135 @@ void ptk_file_list_file_deleted(VFSDir* dir, VFSFileInfo* file, PtkFileList* lis
     if (!list->show_hidden && vfs_file_info_get_name(file)[0] == '.')
         return;
 
-    l = g_list_find(list->files, file);
+    l = g_hash_table_lookup(list->file_iters, file);
     if (!l)
         return;
 
-    path = gtk_tree_path_new_from_indices(g_list_index(list->files, l->data), -1);
+    path = gtk_tree_path_new_from_indices(g_sequence_iter_get_position(l), -1);
 
     gtk_tree_model_row_deleted(GTK_TREE_MODEL(list), path);
 
     gtk_tree_path_free(path);
 
-    list->files = g_list_delete_link(list->files, l);
-    vfs_file_info_unref(file);
+    ptk_file_list_unindex_row(list, file);
+    g_sequence_remove(l);
     --list->n_files;
 }
 
 void ptk_file_list_file_changed(VFSDir* dir, VFSFileInfo* file, PtkFileList* list)
 {
-    GList* l;
+    GSequenceIter* l;
     GtkTreeIter it;
     GtkTreePath* path;
 
     if (!list->show_hidden && vfs_file_info_get_name(file)[0] == '.')
         return;
-    l = g_list_find(list->files, file);
+    l = g_hash_table_lookup(list->file_iters, file);
 
     if (!l)
         return;
 
     it.stamp = list->stamp;
     it.user_data = l;
-    it.user_data2 = l->data;
+    it.user_data2 = file;
 
-    path = gtk_tree_path_new_from_indices(g_list_index(list->files, l->data), -1);
+    path = gtk_tree_path_new_from_indices(g_sequence_iter_get_position(l), -1);
 
     gtk_tree_model_row_changed(GTK_TREE_MODEL(list), path, &it);
 
     gtk_tree_path_free(path);
 }
 
+/* The row of a renamed file is moved to its new place, so the views keep
+ * it, and its selection, rather than deleting and inserting it */
+void ptk_file_list_file_renamed(VFSDir* dir, VFSFileInfo* file, PtkFileList* list)
+{
+    GSequenceIter* l = g_hash_table_lookup(list->file_iters, file);
+    if (!l)
+    {
+        /* was hidden */
+        ptk_file_list_file_created(dir, file, list);
+        return;
+    }
+
+    int old_pos = g_sequence_iter_get_position(l);
+    GtkTreePath* path;
+    if (!list->show_hidden && vfs_file_info_get_name(file)[0] == '.')
+    {
+        path = gtk_tree_path_new_from_indices(old_pos, -1);
+        gtk_tree_model_row_deleted(GTK_TREE_MODEL(list), path);
+        gtk_tree_path_free(path);
+        ptk_file_list_unindex_row(list, file);
+        g_sequence_remove(l);
+        --list->n_files;
+        return;
+    }
+
+    /* the entry of the old name is dropped when looked up */
+    g_hash_table_insert(list->name_rows, g_strdup(file->name), file);
+    g_sequence_sort_changed(l, ptk_file_list_compare, list);
+    int new_pos = g_sequence_iter_get_position(l);
+    if (new_pos != old_pos)
+    {
+        /* new_order[new position] = old position */
+        int* new_order = g_new(int, list->n_files);
+        int i;
+        for (i = 0; i < (int)list->n_files; ++i)
+            new_order[i] = i;
+        if (new_pos > old_pos)
+        {
+            for (i = old_pos; i < new_pos; ++i)
+                new_order[i] = i + 1;
+        }
+        else
+        {
+            for (i = new_pos + 1; i <= old_pos; ++i)
+                new_order[i] = i - 1;
+        }
+        new_order[new_pos] = old_pos;
+        path = gtk_tree_path_new();
+        gtk_tree_model_rows_reordered(GTK_TREE_MODEL(list), path, NULL, new_order);
+        gtk_tree_path_free(path);
+        g_free(new_order);
+    }
+
+    GtkTreeIter it;
+    it.stamp = list->stamp;
+    it.user_data = l;
+    it.user_data2 = file;
+    path = gtk_tree_path_new_from_indices(new_pos, -1);
+    gtk_tree_model_row_changed(GTK_TREE_MODEL(list), path, &it);
+    gtk_tree_path_free(path);
+}
+
+/* Append a chunk of files published by a loading dir, unsorted.
+ * The view sorts the list once the dir is fully listed. */
+void on_files_loaded(VFSDir* dir, GList* files, PtkFileList* list)
+{
+    GList* l;
+    GtkTreeIter it;
+    GtkTreePath* path;
+
+    for (l = files; l; l = l->next)
+    {
+        VFSFileInfo* file = (VFSFileInfo*)l->data;
+        if (!list->show_hidden && file->disp_name[0] == '.')
+            continue;
+
+        GSequenceIter* last = g_sequence_append(list->files, vfs_file_info_ref(file));
+        ptk_file_list_index_row(list, file, last);
+
+        it.stamp = list->stamp;
+        it.user_data = last;
+        it.user_data2 = file;
+
+        path = gtk_tree_path_new_from_indices(list->n_files, -1);
+        ++list->n_files;
+        gtk_tree_model_row_inserted(GTK_TREE_MODEL(list), path, &it);
+        gtk_tree_path_free(path);
+    }
+}
+
 void on_thumbnail_loaded(VFSDir* dir, VFSFileInfo* file, PtkFileList* list)
 {
     /* g_debug( "LOADED: %s", file->name ); */
@@ -829,7 +977,7 @@ void ptk_file_list_show_thumbnails(PtkFileList* list, gboolean is_big, int max_f
     if (!list)
         return;
 
-    GList* l;
+    GSequenceIter* l;
     VFSFileInfo* file;
 
     int old_max_thumbnail = list->max_thumbnail;
@@ -844,9 +992,9 @@ void ptk_file_list_show_thumbnails(PtkFileList* list, gboolean is_big, int max_f
             vfs_thumbnail_loader_cancel_all_requests(list->dir, list->big_thumbnail);
             g_signal_handlers_disconnect_by_func(list->dir, on_thumbnail_loaded, list);
 
-            for (l = list->files; l; l = l->next)
+            for (l = g_sequence_get_begin_iter(list->files); !g_sequence_iter_is_end(l); l = g_sequence_iter_next(l))
             {
-                file = (VFSFileInfo*)l->data;
+                file = (VFSFileInfo*)g_sequence_get(l);
                 if ((vfs_file_info_is_image(file) || vfs_file_info_is_video(file)) &&
                     vfs_file_info_is_thumbnail_loaded(file, is_big))
                 {
@@ -863,9 +1011,9 @@ void ptk_file_list_show_thumbnails(PtkFileList* list, gboolean is_big, int max_f
     }
     g_signal_connect(list->dir, "thumbnail-loaded", G_CALLBACK(on_thumbnail_loaded), list);
 
-    for (l = list->files; l; l = l->next)
+    for (l = g_sequence_get_begin_iter(list->files); !g_sequence_iter_is_end(l); l = g_sequence_iter_next(l))
     {
-        file = (VFSFileInfo*)l->data;
+        file = (VFSFileInfo*)g_sequence_get(l);
         if (list->max_thumbnail != 0 &&
             (vfs_file_info_is_video(file) ||
              (file->size /*vfs_file_info_get_size( file )*/ < list->max_thumbnail && vfs_file_info_is_image(file))))
@@ -880,3 +1028,45 @@ void ptk_file_list_show_thumbnails(PtkFileList* list, gboolean is_big, int max_f
         }
     }
 }
+
+/* Rows start to end (inclusive) are on screen - sniff the mime types they
+ * still lack and load their thumbnails first. */
+void ptk_file_list_set_visible_range(PtkFileList* list, int start, int end)
+{
+    if (!list || !list->dir || start < 0 || end < start)
+        return;
+
+    GSequenceIter* l;
+    GSequenceIter* last;
+    VFSFileInfo* file;
+    GList* files = NULL;
+    GList* pending = NULL;
+    GList* shown = NULL;
+
+    last = g_sequence_get_iter_at_pos(list->files, end + 1);
+    for (l = g_sequence_get_iter_at_pos(list->files, start); l != last; l = g_sequence_iter_next(l))
+    {
+        file = (VFSFileInfo*)g_sequence_get(l);
+        shown = g_list_prepend(shown, file);
+        if (vfs_file_info_is_mime_pending(file))
+            pending = g_list_prepend(pending, file);
+        else if (list->max_thumbnail != 0 &&
+                 (vfs_file_info_is_video(file) ||
+                  (file->size /*vfs_file_info_get_size( file )*/ < list->max_thumbnail && vfs_file_info_is_image(file))) &&
+                 !vfs_file_info_is_thumbnail_loaded(file, list->big_thumbnail))
+            files = g_list_prepend(files, file);
+    }
+    shown = g_list_reverse(shown);
+    vfs_dir_set_shown_files(list->dir, list, shown);
+    g_list_free(shown);
+    if (pending)
+    {
+        pending = g_list_reverse(pending);
+        vfs_dir_load_mime_types(list->dir, pending);
+        g_list_free(pending);
+    }
+    /* also when empty, to cancel the rows which scrolled out of view */
+    files = g_list_reverse(files);
+    vfs_thumbnail_loader_prioritize(list->dir, list, files, list->big_thumbnail);
+    g_list_free(files);
+}
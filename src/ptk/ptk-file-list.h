@@ -59,7 +59,9 @@ struct _PtkFileList
     GObject parent;
     /* <private> */
     VFSDir* dir;
-    GList* files;
+    GSequence* files;       /* rows in display order */
+    GHashTable* file_iters; /* VFSFileInfo => its GSequenceIter in files */
+    GHashTable* name_rows;  /* copy of a file name => VFSFileInfo of its row, stale after a rename */
     uint n_files;
 
     gboolean show_hidden : 1;
@@ -72,6 +74,7 @@ struct _PtkFileList
     gboolean sort_case;         // sfm
     gboolean sort_hidden_first; // sfm
     char sort_dir;              // sfm
+    uint resort_idle;           /* sorts again by type once types are sniffed */
     /* Random integer to check whether an iter belongs to our model */
     int stamp;
 };
@@ -100,7 +103,10 @@ void ptk_file_list_file_deleted(VFSDir* dir, VFSFileInfo* file, PtkFileList* lis
 
 void ptk_file_list_file_changed(VFSDir* dir, VFSFileInfo* file, PtkFileList* list);
 
+void ptk_file_list_file_renamed(VFSDir* dir, VFSFileInfo* file, PtkFileList* list);
+
 void ptk_file_list_show_thumbnails(PtkFileList* list, gboolean is_big, int max_file_size);
+void ptk_file_list_set_visible_range(PtkFileList* list, int start, int end);
 void ptk_file_list_sort(PtkFileList* list); // sfm
 
 G_END_DECLS
@@ -515,24 +515,34 @@ GtkWidget* file_properties_dlg_new(GtkWindow* parent, const char* dir_path, GLis
 
         gtk_editable_set_editable(GTK_EDITABLE(name), FALSE);
 
+        // atime and blocks are not kept in VFSFileInfo
+        struct stat file_stat;
+        char* file_path = g_build_filename(dir_path, vfs_file_info_get_name(file), NULL);
+        if (lstat(file_path, &file_stat) != 0)
+        {
+            file_stat.st_atime = 0;
+            file_stat.st_blocks = 0;
+        }
+        g_free(file_path);
 
         char buf[64];
         if (!vfs_file_info_is_dir(file))
         {
-            char buf2[32];
+            char buf2[64];
             /* Only single "file" is selected, so we don't need to
                 caculate total file size */
             need_calc_size = FALSE;
 
+            vfs_file_info_get_disp_size(file, buf2);
             g_snprintf(buf,
                        sizeof(buf),
                        _("%s  ( %lu bytes )"),
-                       vfs_file_info_get_disp_size(file),
+                       buf2,
                        (guint64)vfs_file_info_get_size(file));
             gtk_label_set_text(data->total_size_label, buf);
 
-            vfs_file_size_to_string(buf2, vfs_file_info_get_blocks(file) * 512);
-            g_snprintf(buf, sizeof(buf), _("%s  ( %lu bytes )"), buf2, (guint64)vfs_file_info_get_blocks(file) * 512);
+            vfs_file_size_to_string(buf2, (guint64)file_stat.st_blocks * 512);
+            g_snprintf(buf, sizeof(buf), _("%s  ( %lu bytes )"), buf2, (guint64)file_stat.st_blocks * 512);
             gtk_label_set_text(data->size_on_disk_label, buf);
 
             gtk_label_set_text(data->count_label, _("1 file"));
@@ -546,7 +556,7 @@ GtkWidget* file_properties_dlg_new(GtkWindow* parent, const char* dir_path, GLis
         gtk_entry_set_text(GTK_ENTRY(data->mtime), buf);
         data->orig_mtime = g_strdup(buf);
 
-        strftime(buf, sizeof(buf), time_format, localtime(vfs_file_info_get_atime(file)));
+        strftime(buf, sizeof(buf), time_format, localtime(&file_stat.st_atime));
         gtk_entry_set_text(GTK_ENTRY(data->atime), buf);
         data->orig_atime = g_strdup(buf);
 
@@ -32,17 +32,17 @@
 
 void ptk_file_task_lock(PtkFileTask* ptask)
 {
-    g_mutex_lock(ptask->task->mutex);
+    g_mutex_lock(&ptask->task->mutex);
 }
 
 void ptk_file_task_unlock(PtkFileTask* ptask)
 {
-    g_mutex_unlock(ptask->task->mutex);
+    g_mutex_unlock(&ptask->task->mutex);
 }
 
 gboolean ptk_file_task_trylock(PtkFileTask* ptask)
 {
-    return g_mutex_trylock(ptask->task->mutex);
+    return g_mutex_trylock(&ptask->task->mutex);
 }
 
 static gboolean on_vfs_file_task_state_cb(VFSFileTask* task, VFSFileTaskState state, gpointer state_data,
@@ -1701,7 +1701,7 @@ gboolean on_vfs_file_task_state_cb(VFSFileTask* task, VFSFileTaskState state, gp
         *ptask->query_new_dest = NULL;
         ptask->query_cond = g_cond_new();
         g_timer_stop(task->timer);
-        g_cond_wait(ptask->query_cond, task->mutex);
+        g_cond_wait(ptask->query_cond, &task->mutex);
         g_cond_free(ptask->query_cond);
         ptask->query_cond = NULL;
         ret = ptask->query_ret;
@@ -2646,7 +2646,8 @@ static void show_devices_menu(GtkTreeView* view, VFSVolume* vol, PtkFileBrowser*
 
     set = xset_get("dev_menu_settings");
     menu_elements = g_strdup_printf("dev_show sep_dm4 dev_menu_auto dev_exec dev_fs_cnf dev_net_cnf dev_mount_options "
-                                    "dev_change sep_dm5 dev_single dev_newtab dev_icon panel%d_font_dev",
+                                    "dev_change dev_list_cache dev_poll sep_dm5 dev_single dev_newtab dev_icon "
+                                    "panel%d_font_dev",
                                     file_browser->mypanel);
     xset_set_set(set, "desc", menu_elements);
     g_free(menu_elements);
@@ -2976,7 +2977,7 @@ int cmp_dev_name(VFSVolume* a, VFSVolume* b)
 void ptk_location_view_dev_menu(GtkWidget* parent, PtkFileBrowser* file_browser, GtkWidget* menu)
 { // add currently visible devices to menu with dev design mode callback
     const GList* v;
-    VFSVolume* vol;
+    VFSVolume* vol = NULL;
     GtkWidget* item;
     XSet* set;
     GList* names = NULL;
@@ -3038,7 +3039,8 @@ void ptk_location_view_dev_menu(GtkWidget* parent, PtkFileBrowser* file_browser,
 
     set = xset_get("dev_menu_settings");
     char* desc =
-        g_strdup_printf("dev_show sep_dm4 dev_menu_auto dev_exec dev_fs_cnf dev_net_cnf dev_mount_options dev_change%s",
+        g_strdup_printf("dev_show sep_dm4 dev_menu_auto dev_exec dev_fs_cnf dev_net_cnf dev_mount_options dev_change "
+                        "dev_list_cache dev_poll%s",
                         file_browser ? " dev_newtab" : "");
     xset_set_set(set, "desc", desc);
     g_free(desc);
@@ -76,6 +76,7 @@ void xset_parse(char* line);
 void xset_defaults();
 const gboolean use_si_prefix_default = FALSE;
 GList* xsets = NULL;
+static GHashTable* xset_hash = NULL; // name => XSet, indexes xsets
 GList* keysets = NULL;
 XSet* set_clipboard = NULL;
 gboolean clipboard_is_cut;
@@ -780,10 +781,32 @@ void xset_autosave_cancel()
     }
 }
 
+static void xset_hash_add(XSet* set)
+{
+    if (G_UNLIKELY(!xset_hash))
+        xset_hash = g_hash_table_new(g_str_hash, g_str_equal);
+    // keep the first set of a name, as a scan of xsets would find it
+    if (!g_hash_table_contains(xset_hash, set->name))
+        g_hash_table_insert(xset_hash, set->name, set);
+}
+
+static XSet* xset_hash_lookup(const char* name)
+{
+    if (G_UNLIKELY(!xset_hash))
+        return NULL;
+    return (XSet*)g_hash_table_lookup(xset_hash, name);
+}
+
 void xset_free_all()
 {
     GList* l;
 
+    if (xset_hash)
+    {
+        g_hash_table_destroy(xset_hash);
+        xset_hash = NULL;
+    }
+
     for (l = xsets; l; l = l->next)
     {
         XSet* set = l->data;
@@ -847,6 +870,8 @@ void xset_free_all()
 
 void xset_free(XSet* set)
 {
+    if (xset_hash && xset_hash_lookup(set->name) == set)
+        g_hash_table_remove(xset_hash, set->name);
     if (set->name)
         g_free(set->name);
     if (set->s)
@@ -943,19 +968,16 @@ XSet* xset_get(const char* name)
     if (!name)
         return NULL;
 
-    GList* l;
-    for (l = xsets; l; l = l->next)
-    {
-        if (!strcmp(name, ((XSet*)l->data)->name))
-        {
-            // existing xset
-            return l->data;
-        }
-    }
+    // existing xset
+    XSet* set = xset_hash_lookup(name);
+    if (set)
+        return set;
 
     // add new
-    xsets = g_list_prepend(xsets, xset_new(name));
-    return xsets->data;
+    set = xset_new(name);
+    xsets = g_list_prepend(xsets, set);
+    xset_hash_add(set);
+    return set;
 }
 
 XSet* xset_get_panel(int panel, const char* name)
@@ -1025,16 +1047,8 @@ XSet* xset_is(const char* name)
     if (!name)
         return NULL;
 
-    GList* l;
-    for (l = xsets; l; l = l->next)
-    {
-        if (!strcmp(name, ((XSet*)l->data)->name))
-        {
-            // existing xset
-            return l->data;
-        }
-    }
-    return NULL;
+    // existing xset
+    return xset_hash_lookup(name);
 }
 
 XSet* xset_set_b(const char* name, gboolean bval)
@@ -2768,6 +2782,7 @@ XSet* xset_get_by_plug_name(const char* plug_dir, const char* plug_name)
     set->plugin = TRUE;
     set->lock = FALSE;
     xsets = g_list_append(xsets, set);
+    xset_hash_add(set);
     return set;
 }
 
@@ -4216,7 +4231,7 @@ void xset_show_help(GtkWidget* parent, XSet* set, const char* anchor)
     if (parent)
         dlgparent = parent;
     else if (set)
-        dlgparent = set->browser;
+        dlgparent = GTK_WIDGET(set->browser);
 
     if (!set || set->lock)
     {
@@ -6177,7 +6192,7 @@ void xset_menu_cb(GtkWidget* item, XSet* set)
         cb_data = g_object_get_data(G_OBJECT(item), "cb_data");
     }
 
-    GtkWidget* parent = set->browser;
+    GtkWidget* parent = GTK_WIDGET(set->browser);
 
     if (set->plugin)
     {
@@ -8306,6 +8321,23 @@ void xset_defaults()
     set->s = g_strdup("cifs curlftpfs ftpfs fuse.sshfs nfs smbfs");
     set->z = g_strdup(set->s);
 
+    set = xset_set("dev_list_cache", "lbl", _("Cache _Listings"));
+    set->menu_style = XSET_MENU_CHECK;
+    set->line = g_strdup("#devices-settings-chdet");
+
+    set = xset_set("dev_poll", "lbl", _("_Poll Changes"));
+    xset_set_set(set,
+                 "desc",
+                 _("Folders excluded from change detection above are polled for changes made by other hosts.  Enter "
+                   "the longest interval between polls in seconds, and how many files are checked again per poll, "
+                   "separated by a space.  The interval grows up to this while a folder doesn't change.  Set the "
+                   "interval to 0 to disable polling."));
+    set->menu_style = XSET_MENU_STRING;
+    xset_set_set(set, "title", _("Poll Changes"));
+    set->line = g_strdup("#devices-settings-chdet");
+    set->s = g_strdup("60 200");
+    set->z = g_strdup(set->s);
+
     set = xset_set("dev_fs_cnf", "label", _("_Device Handlers"));
     xset_set_set(set, "icon", "gtk-preferences");
     set->line = g_strdup("#handlers-dev");
@@ -94,12 +94,12 @@ static void vfs_async_task_init(VFSAsyncTask* task)
 
 void vfs_async_task_lock(VFSAsyncTask* task)
 {
-    g_mutex_lock(task->lock);
+    g_mutex_lock(&task->lock);
 }
 
 void vfs_async_task_unlock(VFSAsyncTask* task)
 {
-    g_mutex_unlock(task->lock);
+    g_mutex_unlock(&task->lock);
 }
 
 VFSAsyncTask* vfs_async_task_new(VFSAsyncFunc task_func, gpointer user_data)
@@ -136,7 +136,7 @@ void vfs_async_task_finalize(GObject* object)
     vfs_async_task_real_cancel(task, TRUE);
     vfs_async_thread_cleanup(task, TRUE);
 
-    task->lock = NULL;
+    g_mutex_clear(&task->lock);
 
     if (G_OBJECT_CLASS(parent_class)->finalize)
         (*G_OBJECT_CLASS(parent_class)->finalize)(object);
@@ -151,48 +151,214 @@ gboolean on_idle(gpointer _task)
     return TRUE; /* the idle handler is removed in vfs_async_thread_cleanup. */
 }
 
-gpointer vfs_async_task_thread(gpointer _task)
+/* All tasks share a few worker threads.  Interactive tasks, such as
+ * listing the dir of the shown tab, go before background ones, and only a
+ * few tasks run on the same device at once so a slow disk or network
+ * mount doesn't take every thread. */
+#define VFS_ASYNC_TASK_MAX_THREADS    8
+#define VFS_ASYNC_TASK_MAX_PER_DEVICE 2
+
+static GMutex pool_lock;
+static GCond pool_cond; /* a task is done */
+static GThreadPool* pool = NULL;
+static GQueue pending[VFS_ASYNC_TASK_N_PRIORITIES] = {G_QUEUE_INIT, G_QUEUE_INIT};
+static GList* running = NULL; /* tasks given to a thread, detached ones included */
+static uint n_running = 0;     /* not detached */
+static uint n_detached = 0;
+
+/* pool_lock must be locked */
+static uint count_running_on_device(dev_t device)
+{
+    uint n = 0;
+    GList* l;
+    for (l = running; l; l = l->next)
+    {
+        if (((VFSAsyncTask*)l->data)->device == device)
+            ++n;
+    }
+    return n;
+}
+
+/* pool_lock must be locked */
+static void vfs_async_task_dispatch()
+{
+    int priority;
+    for (priority = 0; priority < VFS_ASYNC_TASK_N_PRIORITIES; ++priority)
+    {
+        GList* l = pending[priority].head;
+        while (l && n_running < VFS_ASYNC_TASK_MAX_THREADS)
+        {
+            GList* next = l->next;
+            VFSAsyncTask* task = (VFSAsyncTask*)l->data;
+            if (!task->device || count_running_on_device(task->device) < VFS_ASYNC_TASK_MAX_PER_DEVICE)
+            {
+                g_queue_delete_link(&pending[priority], l);
+                running = g_list_prepend(running, task);
+                ++n_running;
+                g_thread_pool_push(pool, task, NULL);
+            }
+            l = next;
+        }
+    }
+}
+
+/* pool_lock must be locked */
+static void vfs_async_task_set_max_threads()
+{
+    /* threads stuck in detached tasks don't count */
+    g_thread_pool_set_max_threads(pool, VFS_ASYNC_TASK_MAX_THREADS + n_detached, NULL);
+}
+
+static void vfs_async_task_thread(VFSAsyncTask* task, gpointer user_data)
 {
-    VFSAsyncTask* task = VFS_ASYNC_TASK(_task);
     gpointer ret = NULL;
     ret = task->func(task, task->user_data);
 
     vfs_async_task_lock(task);
-    task->idle_id = g_idle_add(on_idle, task); // runs in main loop thread
     task->ret_val = ret;
     task->finished = TRUE;
     vfs_async_task_unlock(task);
 
-    return ret;
+    g_mutex_lock(&pool_lock);
+    running = g_list_remove(running, task);
+    task->done = TRUE;
+    if (task->detached)
+    {
+        /* nobody waits for it anymore */
+        --n_detached;
+        vfs_async_task_set_max_threads();
+    }
+    else
+    {
+        --n_running;
+        task->idle_id = g_idle_add(on_idle, task); // runs in main loop thread
+    }
+    g_cond_broadcast(&pool_cond);
+    vfs_async_task_dispatch();
+    g_mutex_unlock(&pool_lock);
+
+    g_object_unref(task); /* ref of the pool */
+}
+
+void vfs_async_task_set_priority(VFSAsyncTask* task, VFSAsyncTaskPriority priority)
+{
+    g_mutex_lock(&pool_lock);
+    GList* l = g_queue_find(&pending[task->priority], task);
+    if (l)
+    {
+        g_queue_delete_link(&pending[task->priority], l);
+        /* the last one made interactive is the one the user looks at */
+        if (priority == VFS_ASYNC_TASK_INTERACTIVE)
+            g_queue_push_head(&pending[priority], task);
+        else
+            g_queue_push_tail(&pending[priority], task);
+    }
+    task->priority = priority;
+    g_mutex_unlock(&pool_lock);
+}
+
+void vfs_async_task_set_device(VFSAsyncTask* task, dev_t device)
+{
+    g_mutex_lock(&pool_lock);
+    task->device = device;
+    g_mutex_unlock(&pool_lock);
+}
+
+void vfs_async_task_set_detachable(VFSAsyncTask* task, gboolean detachable)
+{
+    task->detachable = detachable;
+}
+
+uint vfs_async_task_get_n_stuck()
+{
+    g_mutex_lock(&pool_lock);
+    uint n = n_detached;
+    g_mutex_unlock(&pool_lock);
+    return n;
 }
 
 void vfs_async_task_execute(VFSAsyncTask* task)
 {
-    task->thread = g_thread_new("async_task", vfs_async_task_thread, task);
+    g_mutex_lock(&pool_lock);
+    if (G_UNLIKELY(!pool))
+        pool = g_thread_pool_new((GFunc)vfs_async_task_thread, NULL, VFS_ASYNC_TASK_MAX_THREADS, FALSE, NULL);
+    task->started = TRUE;
+    task->done = FALSE;
+    task->detached = FALSE;
+    g_queue_push_tail(&pending[task->priority], g_object_ref(task));
+    vfs_async_task_dispatch();
+    g_mutex_unlock(&pool_lock);
+}
+
+/* A cancelled task still running this long after is reported as stuck */
+#define VFS_ASYNC_TASK_STUCK_DELAY 10 /* s */
+
+static gboolean on_stuck_check(VFSAsyncTask* task)
+{
+    g_mutex_lock(&pool_lock);
+    gboolean stuck = !task->done;
+    uint n_stuck = n_detached;
+    g_mutex_unlock(&pool_lock);
+    if (stuck)
+        g_warning("%u worker thread(s) stuck in cancelled tasks, eg on an unresponsive mount", n_stuck);
+    g_object_unref(task);
+    return FALSE;
 }
 
 void vfs_async_thread_cleanup(VFSAsyncTask* task, gboolean finalize)
 {
-    if (task->idle_id)
-    {
-        g_source_remove(task->idle_id);
-        task->idle_id = 0;
-    }
-    if (G_LIKELY(task->thread))
+    if (G_LIKELY(task->started))
     {
-        g_thread_join(task->thread);
-        task->thread = NULL;
+        /* a task still waiting for a thread is simply dropped, otherwise
+         * wait for its func to return, unless it can be left running */
+        g_mutex_lock(&pool_lock);
+        GList* l = g_queue_find(&pending[task->priority], task);
+        if (l)
+            g_queue_delete_link(&pending[task->priority], l);
+        else if (!task->done && task->detachable)
+        {
+            task->detached = TRUE;
+            --n_running;
+            ++n_detached;
+            vfs_async_task_set_max_threads();
+            vfs_async_task_dispatch();
+            g_timeout_add_seconds(VFS_ASYNC_TASK_STUCK_DELAY, (GSourceFunc)on_stuck_check, g_object_ref(task));
+        }
+        else
+        {
+            while (!task->done)
+                g_cond_wait(&pool_cond, &pool_lock);
+        }
+        g_mutex_unlock(&pool_lock);
+        task->started = FALSE;
+        vfs_async_task_lock(task);
         task->finished = TRUE;
+        vfs_async_task_unlock(task);
+        if (l)
+            g_object_unref(task); /* ref of the pool, the caller has another */
+
+        /* the thread adds it last, maybe after on_idle called this */
+        if (task->idle_id)
+        {
+            g_source_remove(task->idle_id);
+            task->idle_id = 0;
+        }
+
         /* Only emit the signal when we are not finalizing.
             Emitting signal on an object during destruction is not allowed. */
         if (G_LIKELY(!finalize))
             g_signal_emit(task, signals[FINISH_SIGNAL], 0, task->cancelled);
     }
+    else if (task->idle_id)
+    {
+        g_source_remove(task->idle_id);
+        task->idle_id = 0;
+    }
 }
 
 void vfs_async_task_real_cancel(VFSAsyncTask* task, gboolean finalize)
 {
-    if (!task->thread)
+    if (!task->started)
         return;
 
     /*
@@ -22,6 +22,7 @@
 #ifndef __VFS_ASYNC_TASK_H__
 #define __VFS_ASYNC_TASK_H__
 
+#include <sys/types.h>
 #include <glib.h>
 #include <glib-object.h>
 
@@ -35,6 +36,13 @@ typedef struct _VFSAsyncTaskClass VFSAsyncTaskClass;
 
 typedef gpointer (*VFSAsyncFunc)(VFSAsyncTask*, gpointer);
 
+typedef enum
+{
+    VFS_ASYNC_TASK_INTERACTIVE, /* the user is waiting for it */
+    VFS_ASYNC_TASK_BACKGROUND,
+    VFS_ASYNC_TASK_N_PRIORITIES
+} VFSAsyncTaskPriority;
+
 struct _VFSAsyncTask
 {
     GObject parent;
@@ -42,13 +50,20 @@ struct _VFSAsyncTask
     gpointer user_data;
     gpointer ret_val;
 
-    GThread* thread;
-    GMutex* lock;
+    GMutex lock;
+
+    VFSAsyncTaskPriority priority;
+    dev_t device; /* of the files it works on, 0 if unknown */
 
     uint idle_id;
     gboolean cancel : 1;
-    gboolean cancelled : 1;
     gboolean finished : 1;
+    gboolean detachable : 1; /* cancel doesn't wait for func to return */
+    /* not bit fields, a detached func may still write the ones above */
+    gboolean cancelled;
+    gboolean started; /* executed and not cleaned up yet */
+    gboolean done;           /* func returned, guarded by the pool lock */
+    gboolean detached;       /* cancelled while func was running, guarded by the pool lock */
 };
 
 struct _VFSAsyncTaskClass
@@ -64,6 +79,27 @@ gpointer vfs_async_task_get_data(VFSAsyncTask* task);
 void vfs_async_task_set_data(VFSAsyncTask* task, gpointer user_data);
 gpointer vfs_async_task_get_return_value(VFSAsyncTask* task);
 
+/* Tasks run in a shared pool of worker threads.  Priority may be changed
+ * while the task is still waiting for a thread.  The device is checked
+ * when the task is given a thread, but a running task may still set it
+ * from its func, so the next tasks on that device wait for it. */
+void vfs_async_task_set_priority(VFSAsyncTask* task, VFSAsyncTaskPriority priority);
+void vfs_async_task_set_device(VFSAsyncTask* task, dev_t device);
+
+/*
+ * By default cancelling a running task waits for its func to return.
+ * A detachable task is only flagged as cancelled, and its func may keep
+ * running for a while (eg blocked on a dead network mount).  So after
+ * vfs_async_task_is_cancelled may have become TRUE, func must only touch
+ * data shared with the main thread while holding vfs_async_task_lock,
+ * and after checking task->cancel again.  Its return value is discarded.
+ * The task object itself stays alive until func returns.
+ */
+void vfs_async_task_set_detachable(VFSAsyncTask* task, gboolean detachable);
+
+/* Number of cancelled detachable tasks whose func has not returned yet */
+uint vfs_async_task_get_n_stuck();
+
 /* Execute the async task */
 void vfs_async_task_execute(VFSAsyncTask* task);
 
@@ -22,7 +22,9 @@
 #endif
 
 #include <unistd.h> /* for read */
+#include <sys/syscall.h> /* for SYS_getdents64 */
 #include "vfs-volume.h"
+#include "vfs-list-cache.h"
 
 #include "utils.h"
 
@@ -45,19 +47,32 @@ static void vfs_dir_monitor_callback(VFSFileMonitor* fm, VFSFileMonitorEvent eve
 
 static void on_mime_type_reload(gpointer user_data);
 
-static void update_changed_files(gpointer key, gpointer data, gpointer user_data);
-static gboolean notify_file_change(gpointer user_data);
+static void vfs_dir_queue_change(VFSDir* dir, const char* file_name);
+static gboolean vfs_dir_notify_changes(VFSDir* dir);
 static gboolean update_file_info(VFSDir* dir, VFSFileInfo* file);
 
 static void on_list_task_finished(VFSAsyncTask* task, gboolean is_cancelled, VFSDir* dir);
+static void on_rescan_task_finished(VFSAsyncTask* task, gboolean is_cancelled, VFSDir* dir);
+static void vfs_dir_queue_rescan(VFSDir* dir);
+static void vfs_dir_balance_watches(VFSDir* used_dir);
+static void vfs_dir_start_polling(VFSDir* dir);
+static void vfs_dir_stop_polling(VFSDir* dir);
+static void vfs_dir_get_poll_limits(uint* max_interval, uint* max_files);
+static void vfs_dir_schedule_poll(VFSDir* dir, gboolean changed);
+static void vfs_dir_free_poll_files(GArray* files);
+static void vfs_dir_poll(VFSDir* dir, uint max_files);
+static void vfs_dir_demote_monitor(VFSDir* dir);
+static void vfs_dir_promote_monitor(VFSDir* dir);
 
 enum
 {
     FILE_CREATED_SIGNAL = 0,
     FILE_DELETED_SIGNAL,
     FILE_CHANGED_SIGNAL,
+    FILE_RENAMED_SIGNAL,
     THUMBNAIL_LOADED_SIGNAL,
     FILE_LISTED_SIGNAL,
+    FILES_LOADED_SIGNAL,
     N_SIGNALS
 };
 
@@ -66,7 +81,6 @@ static GObjectClass* parent_class = NULL;
 
 static GHashTable* dir_hash = NULL;
 static GList* mime_cb = NULL;
-static uint change_notify_timeout = 0;
 static uint theme_change_notify = 0;
 
 static gboolean is_desktop_set = FALSE;
@@ -154,6 +168,21 @@ void vfs_dir_class_init(VFSDirClass* klass)
                                                 1,
                                                 G_TYPE_POINTER);
 
+    /*
+     * file-renamed is emitted when a file was renamed within the dir.
+     * The param is the same VFSFileInfo as before, with its new name.
+     */
+    signals[FILE_RENAMED_SIGNAL] = g_signal_new("file-renamed",
+                                                G_TYPE_FROM_CLASS(klass),
+                                                G_SIGNAL_RUN_FIRST,
+                                                G_STRUCT_OFFSET(VFSDirClass, file_renamed),
+                                                NULL,
+                                                NULL,
+                                                g_cclosure_marshal_VOID__POINTER,
+                                                G_TYPE_NONE,
+                                                1,
+                                                G_TYPE_POINTER);
+
     signals[THUMBNAIL_LOADED_SIGNAL] = g_signal_new("thumbnail-loaded",
                                                     G_TYPE_FROM_CLASS(klass),
                                                     G_SIGNAL_RUN_FIRST,
@@ -176,6 +205,22 @@ void vfs_dir_class_init(VFSDirClass* klass)
                                                1,
                                                G_TYPE_BOOLEAN);
 
+    /*
+     * files-loaded is emitted while the dir is still loading, every time
+     * the loader publishes a chunk of files. The param is a GList of the
+     * VFSFileInfo just added to file_list, owned by the dir.
+     */
+    signals[FILES_LOADED_SIGNAL] = g_signal_new("files-loaded",
+                                                G_TYPE_FROM_CLASS(klass),
+                                                G_SIGNAL_RUN_FIRST,
+                                                G_STRUCT_OFFSET(VFSDirClass, files_loaded),
+                                                NULL,
+                                                NULL,
+                                                g_cclosure_marshal_VOID__POINTER,
+                                                G_TYPE_NONE,
+                                                1,
+                                                G_TYPE_POINTER);
+
     /* FIXME: Is there better way to do this? */
     if (G_UNLIKELY(!is_desktop_set))
         vfs_get_desktop_dir();
@@ -185,16 +230,18 @@ void vfs_dir_class_init(VFSDirClass* klass)
 static void vfs_dir_init(VFSDir* dir)
 {
     g_mutex_init(&dir->mutex);
+    /* keys are the names of the files themselves, not copies */
+    dir->file_hash = g_hash_table_new(g_str_hash, g_str_equal);
 }
 
 void vfs_dir_lock(VFSDir* dir)
 {
-    g_mutex_lock(dir->mutex);
+    g_mutex_lock(&dir->mutex);
 }
 
 void vfs_dir_unlock(VFSDir* dir)
 {
-    g_mutex_unlock(dir->mutex);
+    g_mutex_unlock(&dir->mutex);
 }
 
 void vfs_dir_clear(VFSDir* dir)
@@ -202,6 +249,15 @@ void vfs_dir_clear(VFSDir* dir)
     g_mutex_clear(&dir->mutex);
 }
 
+/* Drop the dir's ref on one of its files */
+static void vfs_dir_release_file(VFSFileInfo* file)
+{
+    /* a file still used elsewhere must not pin the names of the whole listing */
+    if (g_atomic_int_get(&file->n_ref) > 1)
+        vfs_file_info_detach_arena(file);
+    vfs_file_info_unref(file);
+}
+
 /* destructor */
 
 void vfs_dir_finalize(GObject* obj)
@@ -221,15 +277,58 @@ void vfs_dir_finalize(GObject* obj)
         g_object_unref(dir->task);
         dir->task = NULL;
     }
+    if (dir->rescan_task)
+    {
+        g_signal_handlers_disconnect_by_func(dir->rescan_task, on_rescan_task_finished, dir);
+        vfs_async_task_cancel(dir->rescan_task);
+        g_object_unref(dir->rescan_task);
+        dir->rescan_task = NULL;
+    }
+    if (dir->loaded_idle)
+    {
+        g_source_remove(dir->loaded_idle);
+        dir->loaded_idle = 0;
+    }
+    if (dir->loaded_files)
+    {
+        g_list_foreach(dir->loaded_files, (GFunc)vfs_dir_release_file, NULL);
+        g_list_free(dir->loaded_files);
+        dir->loaded_files = NULL;
+    }
+    if (dir->revalidated_files)
+    {
+        g_list_foreach(dir->revalidated_files, (GFunc)vfs_dir_release_file, NULL);
+        g_list_free(dir->revalidated_files);
+        dir->revalidated_files = NULL;
+    }
+    if (dir->load_changes)
+    {
+        g_hash_table_destroy(dir->load_changes);
+        dir->load_changes = NULL;
+    }
+    vfs_dir_free_poll_files(dir->poll_files);
+    dir->poll_files = NULL;
+    g_list_free_full(dir->poll_changed, g_free);
+    dir->poll_changed = NULL;
+    g_free(dir->poll_cursor);
+    dir->poll_cursor = NULL;
+    if (dir->shown_files)
+    {
+        g_hash_table_destroy(dir->shown_files);
+        dir->shown_files = NULL;
+    }
     if (dir->monitor)
     {
         vfs_file_monitor_remove(dir->monitor, vfs_dir_monitor_callback, dir);
     }
+    vfs_dir_stop_polling(dir);
     if (dir->path)
     {
         if (G_LIKELY(dir_hash))
         {
-            g_hash_table_remove(dir_hash, dir->path);
+            /* a stale dir was replaced already, see vfs_dir_get_by_path */
+            if (g_hash_table_lookup(dir_hash, dir->path) == dir)
+                g_hash_table_remove(dir_hash, dir->path);
 
             /* There is no VFSDir instance */
             if (0 == g_hash_table_size(dir_hash))
@@ -240,12 +339,6 @@ void vfs_dir_finalize(GObject* obj)
                 vfs_mime_type_remove_reload_cb(mime_cb);
                 mime_cb = NULL;
 
-                if (change_notify_timeout)
-                {
-                    g_source_remove(change_notify_timeout);
-                    change_notify_timeout = 0;
-                }
-
                 g_signal_handler_disconnect(gtk_icon_theme_get_default(), theme_change_notify);
                 theme_change_notify = 0;
             }
@@ -264,24 +357,19 @@ void vfs_dir_finalize(GObject* obj)
 
     if (dir->file_list)
     {
-        g_list_foreach(dir->file_list, (GFunc)vfs_file_info_unref, NULL);
+        g_list_foreach(dir->file_list, (GFunc)vfs_dir_release_file, NULL);
         g_list_free(dir->file_list);
         dir->file_list = NULL;
         dir->n_files = 0;
     }
+    g_hash_table_destroy(dir->file_hash);
+    dir->file_hash = NULL;
 
-    if (dir->changed_files)
-    {
-        g_slist_foreach(dir->changed_files, (GFunc)vfs_file_info_unref, NULL);
-        g_slist_free(dir->changed_files);
-        dir->changed_files = NULL;
-    }
-
-    if (dir->created_files)
+    /* notify_timeout was removed with the other sources of dir above */
+    if (dir->pending_changes)
     {
-        g_slist_foreach(dir->created_files, (GFunc)g_free, NULL);
-        g_slist_free(dir->created_files);
-        dir->created_files = NULL;
+        g_hash_table_destroy(dir->pending_changes);
+        dir->pending_changes = NULL;
     }
 
     vfs_dir_clear(dir);
@@ -298,18 +386,32 @@ void vfs_dir_set_property(GObject* obj, uint prop_id, const GValue* value, GPara
 
 static GList* vfs_dir_find_file(VFSDir* dir, const char* file_name, VFSFileInfo* file)
 {
-    GList* l;
-    for (l = dir->file_list; l; l = l->next)
+    if (G_UNLIKELY(!file_name))
+        file_name = file->name;
+    return (GList*)g_hash_table_lookup(dir->file_hash, file_name);
+}
+
+/* Prepend file to file_list and index it by name, dir must be locked */
+static void vfs_dir_insert_file(VFSDir* dir, VFSFileInfo* file)
+{
+    dir->file_list = g_list_prepend(dir->file_list, file);
+    g_hash_table_insert(dir->file_hash, file->name, dir->file_list);
+    ++dir->n_files;
+}
+
+/* While loading, an event may be about a file the loader listed but didn't
+ * publish yet.  Its name is kept to check the file again once it is, see
+ * vfs_dir_publish_loaded_files. */
+static void vfs_dir_queue_load_change(VFSDir* dir, const char* file_name)
+{
+    if (dir->task)
     {
-        VFSFileInfo* file2 = (VFSFileInfo*)l->data;
-        if (G_UNLIKELY(file == file2))
-            return l;
-        if (file2->name && 0 == strcmp(file2->name, file_name))
-        {
-            return l;
-        }
+        if (!dir->load_changes)
+            dir->load_changes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        if (!g_hash_table_contains(dir->load_changes, file_name))
+            g_hash_table_add(dir->load_changes, g_strdup(file_name));
     }
-    return NULL;
+    vfs_dir_queue_change(dir, file_name);
 }
 
 /* signal handlers */
@@ -325,11 +427,7 @@ void vfs_dir_emit_file_created(VFSDir* dir, const char* file_name, gboolean forc
         return;
     }
 
-    dir->created_files = g_slist_append(dir->created_files, g_strdup(file_name));
-    if (0 == change_notify_timeout)
-    {
-        change_notify_timeout = g_timeout_add_full(G_PRIORITY_LOW, 200, notify_file_change, NULL, NULL);
-    }
+    vfs_dir_queue_load_change(dir, file_name);
 }
 
 void vfs_dir_emit_file_deleted(VFSDir* dir, const char* file_name, VFSFileInfo* file)
@@ -343,27 +441,18 @@ void vfs_dir_emit_file_deleted(VFSDir* dir, const char* file_name, VFSFileInfo*
         g_list_foreach(dir->file_list, (GFunc)vfs_file_info_unref, NULL);
         g_list_free(dir->file_list);
         dir->file_list = NULL;
+        dir->n_files = 0;
+        g_hash_table_remove_all(dir->file_hash);
         vfs_dir_unlock(dir);
 
         g_signal_emit(dir, signals[FILE_DELETED_SIGNAL], 0, file);
         return;
     }
 
-    GList* l = vfs_dir_find_file(dir, file_name, file);
-    if (G_LIKELY(l))
-    {
-        VFSFileInfo* file_found = vfs_file_info_ref((VFSFileInfo*)l->data);
-        if (!g_slist_find(dir->changed_files, file_found))
-        {
-            dir->changed_files = g_slist_prepend(dir->changed_files, file_found);
-            if (0 == change_notify_timeout)
-            {
-                change_notify_timeout = g_timeout_add_full(G_PRIORITY_LOW, 200, notify_file_change, NULL, NULL);
-            }
-        }
-        else
-            vfs_file_info_unref(file_found);
-    }
+    if (G_LIKELY(vfs_dir_find_file(dir, file_name, file)))
+        vfs_dir_queue_change(dir, file_name);
+    else if (dir->task)
+        vfs_dir_queue_load_change(dir, file_name);
 }
 
 void vfs_dir_emit_file_changed(VFSDir* dir, const char* file_name, VFSFileInfo* file, gboolean force)
@@ -386,34 +475,57 @@ void vfs_dir_emit_file_changed(VFSDir* dir, const char* file_name, VFSFileInfo*
     GList* l = vfs_dir_find_file(dir, file_name, file);
     if (G_LIKELY(l))
     {
-        file = vfs_file_info_ref((VFSFileInfo*)l->data);
-        if (!g_slist_find(dir->changed_files, file))
+        /* In a quiet dir, show the first change right away.  It is
+         * checked again with the next batch, like any later change. */
+        if (!force && !dir->notify_timeout)
         {
-            if (force)
-            {
-                dir->changed_files = g_slist_prepend(dir->changed_files, file);
-                if (0 == change_notify_timeout)
-                {
-                    change_notify_timeout = g_timeout_add_full(G_PRIORITY_LOW, 100, notify_file_change, NULL, NULL);
-                }
-            }
-            else if (G_LIKELY(update_file_info(dir, file))) // update file info the first time
-            {
-                dir->changed_files = g_slist_prepend(dir->changed_files, file);
-                if (0 == change_notify_timeout)
-                {
-                    change_notify_timeout = g_timeout_add_full(G_PRIORITY_LOW, 500, notify_file_change, NULL, NULL);
-                }
+            file = vfs_file_info_ref((VFSFileInfo*)l->data);
+            if (G_LIKELY(update_file_info(dir, file)))
                 g_signal_emit(dir, signals[FILE_CHANGED_SIGNAL], 0, file);
-            }
-        }
-        else
             vfs_file_info_unref(file);
+        }
+        vfs_dir_queue_change(dir, file_name);
     }
+    else if (dir->task)
+        vfs_dir_queue_load_change(dir, file_name);
 
     vfs_dir_unlock(dir);
 }
 
+/* A rename keeps the VFSFileInfo of the file, so its thumbnail and its
+ * rows in the views, with their selection, stay as they are */
+void vfs_dir_emit_file_renamed(VFSDir* dir, const char* old_name, const char* new_name)
+{
+    VFSFileInfo* file = NULL;
+
+    vfs_dir_lock(dir);
+    GList* l = vfs_dir_find_file(dir, old_name, NULL);
+    if (l && !vfs_dir_find_file(dir, new_name, NULL))
+    {
+        VFSFileInfo* renamed = (VFSFileInfo*)l->data;
+        char* full_path = g_build_filename(dir->path, new_name, NULL);
+        /* file_hash is keyed by the name being replaced */
+        g_hash_table_remove(dir->file_hash, renamed->name);
+        if (vfs_file_info_rename(renamed, full_path, new_name))
+            file = vfs_file_info_ref(renamed);
+        g_hash_table_insert(dir->file_hash, renamed->name, l);
+        g_free(full_path);
+    }
+    vfs_dir_unlock(dir);
+
+    if (file)
+    {
+        g_signal_emit(dir, signals[FILE_RENAMED_SIGNAL], 0, file);
+        vfs_file_info_unref(file);
+    }
+    else
+    {
+        /* not listed yet, replacing another file or already gone */
+        vfs_dir_emit_file_deleted(dir, old_name, NULL);
+        vfs_dir_emit_file_created(dir, new_name, FALSE);
+    }
+}
+
 void vfs_dir_emit_thumbnail_loaded(VFSDir* dir, VFSFileInfo* file)
 {
     GList* l;
@@ -442,17 +554,177 @@ VFSDir* vfs_dir_new(const char* path)
     VFSDir* dir = (VFSDir*)g_object_new(VFS_TYPE_DIR, NULL);
     dir->path = g_strdup(path);
     dir->avoid_changes = vfs_volume_dir_avoid_changes(path);
+    dir->list_cache = dir->avoid_changes && xset_get_b("dev_list_cache");
     // g_printf("vfs_dir_new %s  avoid_changes=%s\n", dir->path, dir->avoid_changes ? "TRUE" : "FALSE" );
     return dir;
 }
 
+/* Move files listed by the loader into file_list, runs in main thread */
+static void vfs_dir_publish_loaded_files(VFSDir* dir)
+{
+    vfs_dir_lock(dir);
+    GList* files = dir->loaded_files;
+    dir->loaded_files = NULL;
+    if (dir->loaded_idle)
+    {
+        g_source_remove(dir->loaded_idle);
+        dir->loaded_idle = 0;
+    }
+
+    GList* published = NULL;
+    GList* l;
+    for (l = files; l; l = l->next)
+    {
+        VFSFileInfo* file = (VFSFileInfo*)l->data;
+        if (G_UNLIKELY(g_hash_table_lookup(dir->file_hash, file->name)))
+        {
+            /* already added by a file monitor event while loading */
+            vfs_file_info_unref(file);
+            continue;
+        }
+        dir->file_list = g_list_prepend(dir->file_list, file);
+        g_hash_table_insert(dir->file_hash, file->name, dir->file_list);
+        ++dir->n_files;
+        published = g_list_prepend(published, file);
+    }
+    g_list_free(files);
+    vfs_dir_unlock(dir);
+
+    if (published)
+    {
+        g_signal_emit(dir, signals[FILES_LOADED_SIGNAL], 0, published);
+        /* an event may have come before the file was published, maybe
+         * even checked already and found nothing */
+        if (dir->load_changes)
+        {
+            for (l = published; l; l = l->next)
+            {
+                const char* name = ((VFSFileInfo*)l->data)->name;
+                if (g_hash_table_contains(dir->load_changes, name))
+                    vfs_dir_queue_change(dir, name);
+            }
+        }
+        g_list_free(published);
+    }
+}
+
+static gboolean on_loaded_files_idle(VFSDir* dir)
+{
+    vfs_dir_lock(dir);
+    dir->loaded_idle = 0;
+    vfs_dir_unlock(dir);
+    vfs_dir_publish_loaded_files(dir);
+    return FALSE;
+}
+
+/* dir must be locked */
+static void vfs_dir_remove_listed(VFSDir* dir, GList* l)
+{
+    VFSFileInfo* file = (VFSFileInfo*)l->data;
+    g_hash_table_remove(dir->file_hash, file->name);
+    dir->file_list = g_list_delete_link(dir->file_list, l);
+    --dir->n_files;
+    g_signal_emit(dir, signals[FILE_DELETED_SIGNAL], 0, file);
+    vfs_dir_release_file(file);
+}
+
+/* Replace the files shown from a cached listing, or before a rescan, by
+ * those listed again.
+ * Files still listed keep their VFSFileInfo, updated in place if they
+ * changed, so only the differences are signaled.
+ * Returns TRUE if there was any. */
+static gboolean vfs_dir_update_listing(VFSDir* dir, GList* files)
+{
+    GHashTable* listed = g_hash_table_new(g_str_hash, g_str_equal);
+    GList* removed = NULL;
+    gboolean changed = FALSE;
+    GList* l;
+
+    vfs_dir_lock(dir);
+    for (l = files; l; l = l->next)
+        g_hash_table_add(listed, ((VFSFileInfo*)l->data)->name);
+    for (l = dir->file_list; l; l = l->next)
+    {
+        VFSFileInfo* file = (VFSFileInfo*)l->data;
+        if (!g_hash_table_contains(listed, file->name))
+            removed = g_list_prepend(removed, file->name);
+    }
+    g_hash_table_destroy(listed);
+
+    for (l = removed; l; l = l->next)
+        vfs_dir_remove_listed(dir, (GList*)g_hash_table_lookup(dir->file_hash, l->data));
+    changed = !!removed;
+    g_list_free(removed);
+
+    for (l = files; l; l = l->next)
+    {
+        VFSFileInfo* file = (VFSFileInfo*)l->data;
+        GList* old_l = (GList*)g_hash_table_lookup(dir->file_hash, file->name);
+        if (old_l)
+        {
+            VFSFileInfo* old = (VFSFileInfo*)old_l->data;
+            if (old->mode != file->mode || old->size != file->size || old->mtime != file->mtime ||
+                old->mtime_nsec != file->mtime_nsec || old->uid != file->uid || old->gid != file->gid)
+            {
+                /* the views know the old VFSFileInfo, its rows stay */
+                vfs_file_info_update(old, file);
+                g_signal_emit(dir, signals[FILE_CHANGED_SIGNAL], 0, old);
+                changed = TRUE;
+            }
+            vfs_file_info_unref(file);
+            continue;
+        }
+        vfs_dir_insert_file(dir, file);
+        g_signal_emit(dir, signals[FILE_CREATED_SIGNAL], 0, file);
+        changed = TRUE;
+    }
+    g_list_free(files);
+    vfs_dir_unlock(dir);
+    return changed;
+}
+
 void on_list_task_finished(VFSAsyncTask* task, gboolean is_cancelled, VFSDir* dir)
 {
+    /* the last chunk must reach the file list before file-listed */
+    vfs_dir_publish_loaded_files(dir);
+    if (dir->load_changes)
+    {
+        g_hash_table_destroy(dir->load_changes);
+        dir->load_changes = NULL;
+    }
+
+    vfs_dir_lock(dir);
+    gboolean revalidated = dir->revalidated;
+    GList* files = dir->revalidated_files;
+    dir->revalidated = FALSE;
+    dir->revalidated_files = NULL;
+    vfs_dir_unlock(dir);
+    if (revalidated)
+        vfs_dir_update_listing(dir, files);
+
     g_object_unref(dir->task);
     dir->task = NULL;
     g_signal_emit(dir, signals[FILE_LISTED_SIGNAL], 0, is_cancelled);
     dir->file_listed = 1;
     dir->load_complete = 1;
+
+    /* no watch was left for it */
+    if (!dir->monitor && !is_cancelled)
+        vfs_dir_balance_watches(dir);
+    else if (dir->avoid_changes && !is_cancelled)
+    {
+        /* polled instead of watched */
+        uint max_interval, max_files;
+        vfs_dir_get_poll_limits(&max_interval, &max_files);
+        if (max_interval)
+            vfs_dir_demote_monitor(dir);
+    }
+
+    if (dir->rescan_again && !is_cancelled)
+    {
+        dir->rescan_again = FALSE;
+        vfs_dir_queue_rescan(dir);
+    }
 }
 
 void vfs_dir_load(VFSDir* dir)
@@ -470,210 +742,602 @@ void vfs_dir_load(VFSDir* dir)
             dir->is_home = TRUE;
 
         dir->task = vfs_async_task_new((VFSAsyncFunc)vfs_dir_load_thread, dir);
+        /* only a few dirs of the same device are listed at once.  The
+         * disk isn't touched here, a dir on no known volume gets its
+         * device from the load thread. */
+        dir->device = vfs_volume_get_device_of_dir(dir->path);
+        vfs_async_task_set_device(dir->task, dir->device);
+        /* cancelling doesn't wait for a stuck listing */
+        vfs_async_task_set_detachable(dir->task, TRUE);
         g_signal_connect(dir->task, "finish", G_CALLBACK(on_list_task_finished), dir);
         vfs_async_task_execute(dir->task);
     }
 }
 
-gpointer vfs_dir_load_thread(VFSAsyncTask* task, VFSDir* dir)
-{
-    dir->file_listed = 0;
-    dir->load_complete = 0;
-    if (dir->path)
-    {
-        /* Install file alteration monitor */
-        dir->monitor = vfs_file_monitor_add_dir(dir->path, vfs_dir_monitor_callback, dir);
-
-        GDir* dir_content = g_dir_open(dir->path, 0, NULL);
+/* Size of the buffer handed to getdents64, enough for a few thousand entries per call */
+#define VFS_DIR_DENTS_BUF_SIZE (256 * 1024)
 
-        if (dir_content)
-        {
-            const char* file_name;
-            while (!vfs_async_task_is_cancelled(dir->task) && (file_name = g_dir_read_name(dir_content)))
-            {
-                char* full_path = g_build_filename(dir->path, file_name, NULL);
-                if (!full_path)
-                    continue;
+/* While loading, listed files are handed to the main thread in chunks of
+ * at most this many files, or after this many microseconds */
+#define VFS_DIR_CHUNK_FILES    2000
+#define VFS_DIR_CHUNK_INTERVAL (100 * 1000)
 
-                /* FIXME: Is locking GDK needed here? */
-                /* GDK_THREADS_ENTER(); */
-                VFSFileInfo* file = vfs_file_info_new();
-                if (G_LIKELY(vfs_file_info_get(file, full_path, file_name)))
-                {
-                    vfs_dir_lock(dir);
+struct linux_dirent64
+{
+    guint64 d_ino;
+    gint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
 
-                    /* Special processing for desktop folder */
-                    vfs_file_info_load_special_info(file, full_path);
-                    dir->file_list = g_list_prepend(dir->file_list, file);
-                    vfs_dir_unlock(dir);
-                    ++dir->n_files;
-                }
-                else
-                {
-                    vfs_file_info_unref(file);
-                }
-                /* GDK_THREADS_LEAVE(); */
-                g_free(full_path);
-            }
-            g_dir_close(dir_content);
-        }
+/* Queue a chunk of listed files and have the main thread publish them.
+ * The task lock keeps dir alive unless the load was cancelled. */
+static void vfs_dir_add_files(VFSAsyncTask* task, VFSDir* dir, GList* files)
+{
+    if (!files)
+        return;
+    vfs_async_task_lock(task);
+    if (vfs_async_task_is_cancelled(task))
+        vfs_file_info_list_free(files);
+    else
+    {
+        vfs_dir_lock(dir);
+        dir->loaded_files = g_list_concat(files, dir->loaded_files);
+        if (!dir->loaded_idle)
+            dir->loaded_idle = g_idle_add((GSourceFunc)on_loaded_files_idle, dir);
+        vfs_dir_unlock(dir);
     }
-    return NULL;
+    vfs_async_task_unlock(task);
 }
 
-gboolean vfs_dir_is_loading(VFSDir* dir)
+static gint64 vfs_dir_stat_mtime(const struct stat* dir_stat)
 {
-    return dir->task ? TRUE : FALSE;
+    return (gint64)dir_stat->st_mtim.tv_sec * 1000000000 + dir_stat->st_mtim.tv_nsec;
 }
 
-gboolean vfs_dir_is_file_listed(VFSDir* dir)
+/* Recorded when the dir is listed, then compared by the poll task */
+static void vfs_dir_set_poll_mtime(VFSAsyncTask* task, VFSDir* dir, const struct stat* dir_stat)
 {
-    return dir->file_listed;
+    vfs_async_task_lock(task);
+    if (!vfs_async_task_is_cancelled(task))
+    {
+        vfs_dir_lock(dir);
+        dir->poll_mtime = dir_stat ? vfs_dir_stat_mtime(dir_stat) : 0;
+        vfs_dir_unlock(dir);
+    }
+    vfs_async_task_unlock(task);
 }
 
-void vfs_cancel_load(VFSDir* dir)
+/* Hand a complete new listing to the main thread, which keeps the
+ * unchanged files, see vfs_dir_update_listing */
+static void vfs_dir_set_revalidated_files(VFSAsyncTask* task, VFSDir* dir, GList* files)
 {
-    dir->cancel = TRUE;
-    if (dir->task)
+    vfs_async_task_lock(task);
+    if (!vfs_async_task_is_cancelled(task))
     {
-        // g_printf("spacefm: vfs_cancel_load -> vfs_async_task_cancel\n");
-        vfs_async_task_cancel(dir->task);
-        /* don't do g_object_unref on task here since this is done in the handler of "finish" signal. */
-        dir->task = NULL;
+        vfs_dir_lock(dir);
+        vfs_file_info_list_free(dir->revalidated_files);
+        dir->revalidated_files = files;
+        dir->revalidated = TRUE;
+        vfs_dir_unlock(dir);
+        files = NULL;
     }
+    vfs_async_task_unlock(task);
+    vfs_file_info_list_free(files);
 }
 
-gboolean update_file_info(VFSDir* dir, VFSFileInfo* file)
+static VFSFileInfo* vfs_dir_get_file(int dir_fd, const char* path, const char* file_name,
+                                     VFSFileInfoArena* arena, GString* listing)
 {
-    gboolean ret = FALSE;
-
-    /* FIXME: Dirty hack: steal the string to prevent memory allocation */
-    char* file_name = file->name;
-    if (file->name == file->disp_name)
-        file->disp_name = NULL;
-    file->name = NULL;
-
-    char* full_path = g_build_filename(dir->path, file_name, NULL);
-    if (G_LIKELY(full_path))
+    VFSFileInfo* file = vfs_file_info_new();
+    if (G_UNLIKELY(!vfs_file_info_get_at(file, dir_fd, path, file_name, arena)))
     {
-        if (G_LIKELY(vfs_file_info_get(file, full_path, file_name)))
-        {
-            ret = TRUE;
-            /* if( G_UNLIKELY(is_desktop) ) */
-            vfs_file_info_load_special_info(file, full_path);
-        }
-        else /* The file doesn't exist */
-        {
-            GList* l;
-            l = g_list_find(dir->file_list, file);
-            if (G_UNLIKELY(l))
-            {
-                dir->file_list = g_list_delete_link(dir->file_list, l);
-                --dir->n_files;
-                if (file)
-                {
-                    g_signal_emit(dir, signals[FILE_DELETED_SIGNAL], 0, file);
-                    vfs_file_info_unref(file);
-                }
-            }
-            ret = FALSE;
-        }
+        vfs_file_info_unref(file);
+        return NULL;
+    }
+    /* Special processing for desktop folder */
+    if (G_UNLIKELY(g_str_has_suffix(file_name, ".desktop")))
+    {
+        char* full_path = g_build_filename(path, file_name, NULL);
+        vfs_file_info_load_special_info(file, full_path);
         g_free(full_path);
     }
-    g_free(file_name);
-    return ret;
+    if (listing)
+        vfs_list_cache_add(listing, file);
+    return file;
 }
 
-void update_changed_files(gpointer key, gpointer data, gpointer user_data)
+/* Stat the files named again, for a dir whose entries are known to be
+ * unchanged.  Returns TRUE unless task is cancelled. */
+static gboolean vfs_dir_restat_files(VFSAsyncTask* task, int dir_fd, const char* path, GPtrArray* names,
+                                     VFSFileInfoArena* arena, GString* listing, GList** files_ret)
 {
-    VFSDir* dir = (VFSDir*)data;
-
-    if (dir->changed_files)
+    GList* files = NULL;
+    uint i;
+    for (i = 0; i < names->len && !vfs_async_task_is_cancelled(task); ++i)
     {
-        vfs_dir_lock(dir);
-        GSList* l;
-        for (l = dir->changed_files; l; l = l->next)
-        {
-            VFSFileInfo* file = vfs_file_info_ref((VFSFileInfo*)l->data); ///
-            if (update_file_info(dir, file))
-            {
-                g_signal_emit(dir, signals[FILE_CHANGED_SIGNAL], 0, file);
-                vfs_file_info_unref(file);
-            }
-            // else was deleted, signaled, and unrefed in update_file_info
-        }
-        g_slist_free(dir->changed_files);
-        dir->changed_files = NULL;
-        vfs_dir_unlock(dir);
+        VFSFileInfo* file = vfs_dir_get_file(dir_fd, path, (const char*)g_ptr_array_index(names, i), arena, listing);
+        if (G_LIKELY(file))
+            files = g_list_prepend(files, file);
     }
+    *files_ret = files;
+    return !vfs_async_task_is_cancelled(task);
 }
 
-void update_created_files(gpointer key, gpointer data, gpointer user_data)
+/* Read the entries of dir_fd until all are read or task is cancelled.
+ * If chunked they are handed to the main thread as they are read, the
+ * rest is returned in files.  Returns TRUE if the listing is complete. */
+static gboolean vfs_dir_read_files(VFSAsyncTask* task, VFSDir* dir, int dir_fd, const char* path,
+                                   VFSFileInfoArena* arena, GString* listing, gboolean chunked, GList** files_ret)
 {
-    VFSDir* dir = (VFSDir*)data;
-
-    if (dir->created_files)
+    char* buf = g_malloc(VFS_DIR_DENTS_BUF_SIZE);
+    GList* files = NULL;
+    int n_files = 0;
+    gint64 chunk_time = g_get_monotonic_time();
+    long nread = 0;
+    while (!vfs_async_task_is_cancelled(task) &&
+           (nread = syscall(SYS_getdents64, dir_fd, buf, VFS_DIR_DENTS_BUF_SIZE)) > 0)
     {
-        GSList* l;
-        vfs_dir_lock(dir);
-        for (l = dir->created_files; l; l = l->next)
+        long pos;
+        for (pos = 0; pos < nread;)
         {
-            GList* ll;
-            VFSFileInfo* file;
-            if (!(ll = vfs_dir_find_file(dir, (char*)l->data, NULL)))
+            struct linux_dirent64* dent = (struct linux_dirent64*)(buf + pos);
+            pos += dent->d_reclen;
+
+            const char* file_name = dent->d_name;
+            if (file_name[0] == '.' && (file_name[1] == '\0' || (file_name[1] == '.' && file_name[2] == '\0')))
+                continue;
+
+            VFSFileInfo* file = vfs_dir_get_file(dir_fd, path, file_name, arena, listing);
+            if (G_LIKELY(file))
             {
-                // file is not in dir file_list
-                char* full_path = g_build_filename(dir->path, (char*)l->data, NULL);
-                file = vfs_file_info_new();
-                if (vfs_file_info_get(file, full_path, NULL))
-                {
-                    // add new file to dir file_list
-                    vfs_file_info_load_special_info(file, full_path);
-                    dir->file_list = g_list_prepend(dir->file_list, vfs_file_info_ref(file));
-                    ++dir->n_files;
-                    g_signal_emit(dir, signals[FILE_CREATED_SIGNAL], 0, file);
-                }
-                // else file doesn't exist in filesystem
-                vfs_file_info_unref(file);
-                g_free(full_path);
+                files = g_list_prepend(files, file);
+                ++n_files;
             }
-            else
+
+            if (chunked && (n_files >= VFS_DIR_CHUNK_FILES ||
+                            (files && g_get_monotonic_time() - chunk_time >= VFS_DIR_CHUNK_INTERVAL)))
             {
-                // file already exists in dir file_list
-                file = vfs_file_info_ref((VFSFileInfo*)ll->data);
-                if (update_file_info(dir, file))
-                {
-                    g_signal_emit(dir, signals[FILE_CHANGED_SIGNAL], 0, file);
-                    vfs_file_info_unref(file);
-                }
-                // else was deleted, signaled, and unrefed in update_file_info
+                vfs_dir_add_files(task, dir, files);
+                files = NULL;
+                n_files = 0;
+                chunk_time = g_get_monotonic_time();
             }
-            g_free((char*)l->data); // free file_name string
         }
-        g_slist_free(dir->created_files);
-        dir->created_files = NULL;
-        vfs_dir_unlock(dir);
     }
+    g_free(buf);
+    *files_ret = files;
+    return nread == 0 && !vfs_async_task_is_cancelled(task);
 }
 
-gboolean notify_file_change(gpointer user_data)
+/* The task is detachable, so once it is cancelled dir may be freed while
+ * this still runs, eg blocked on a dead network mount.  dir is only touched
+ * while holding the task lock after checking that it wasn't cancelled. */
+gpointer vfs_dir_load_thread(VFSAsyncTask* task, VFSDir* dir)
 {
-    // GDK_THREADS_ENTER();  //sfm not needed because in main thread?
-    g_hash_table_foreach(dir_hash, update_changed_files, NULL);
-    g_hash_table_foreach(dir_hash, update_created_files, NULL);
-    /* remove the timeout */
-    change_notify_timeout = 0;
+    vfs_async_task_lock(task);
+    if (vfs_async_task_is_cancelled(task) || !dir->path)
+    {
+        vfs_async_task_unlock(task);
+        return NULL;
+    }
+    char* path = g_strdup(dir->path);
+    gboolean list_cache = dir->list_cache;
+    dir->file_listed = 0;
+    dir->load_complete = 0;
+    vfs_async_task_unlock(task);
+
+    /* Install file alteration monitor */
+    VFSFileMonitor* monitor = vfs_file_monitor_add_dir(path, NULL, NULL);
+    if (monitor)
+    {
+        vfs_async_task_lock(task);
+        if (vfs_async_task_is_cancelled(task))
+            vfs_file_monitor_remove(monitor, NULL, NULL);
+        else
+        {
+            vfs_file_monitor_add_callback(monitor, vfs_dir_monitor_callback, dir);
+            dir->monitor = monitor;
+        }
+        vfs_async_task_unlock(task);
+    }
+
+    VFSFileInfoArena* arena = vfs_file_info_arena_new();
+
+    /* Show the saved listing before anything is read from a slow dir.
+     * Its names stay in arena, the files are handed to the dir. */
+    gint64 cached_mtime = 0;
+    GPtrArray* cached_names = NULL;
+    if (list_cache)
+    {
+        GList* cached_files = vfs_list_cache_load(path, &cached_mtime, arena);
+        if (cached_files)
+        {
+            cached_names = g_ptr_array_new();
+            GList* l;
+            for (l = cached_files; l; l = l->next)
+                g_ptr_array_add(cached_names, ((VFSFileInfo*)l->data)->name);
+        }
+        vfs_dir_add_files(task, dir, cached_files);
+    }
+    gboolean cached = !!cached_names;
+
+    struct stat dir_stat;
+    gboolean stat_ok = stat(path, &dir_stat) == 0;
+    gint64 mtime_ns = stat_ok ? vfs_dir_stat_mtime(&dir_stat) : 0;
+    vfs_dir_set_poll_mtime(task, dir, stat_ok ? &dir_stat : NULL);
+
+    int dir_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd != -1)
+    {
+        struct stat fd_stat;
+        if (fstat(dir_fd, &fd_stat) == 0)
+        {
+            vfs_async_task_set_device(task, fd_stat.st_dev);
+            vfs_async_task_lock(task);
+            if (!vfs_async_task_is_cancelled(task))
+                dir->device = fd_stat.st_dev;
+            vfs_async_task_unlock(task);
+        }
+
+        GString* listing = list_cache ? vfs_list_cache_begin(path, mtime_ns) : NULL;
+        GList* files = NULL;
+        gboolean complete;
+        /* no file was added or removed since the listing was saved, but
+         * files may have been changed in place */
+        if (cached && mtime_ns && mtime_ns == cached_mtime)
+            complete = vfs_dir_restat_files(task, dir_fd, path, cached_names, arena, listing, &files);
+        else
+            /* a cached listing is replaced at once when done */
+            complete = vfs_dir_read_files(task, dir, dir_fd, path, arena, listing, !cached, &files);
+        close(dir_fd);
+
+        /* an incomplete listing must not replace a cached one */
+        if (listing && complete)
+            vfs_list_cache_commit(path, listing);
+        else if (listing)
+            g_string_free(listing, TRUE);
+        if (!cached)
+            vfs_dir_add_files(task, dir, files);
+        else if (complete)
+            vfs_dir_set_revalidated_files(task, dir, files);
+        else
+            vfs_file_info_list_free(files);
+    }
+    if (cached_names)
+        g_ptr_array_free(cached_names, TRUE);
+    vfs_file_info_arena_unref(arena);
+    g_free(path);
+    return NULL;
+}
+
+gboolean vfs_dir_is_loading(VFSDir* dir)
+{
+    return dir->task ? TRUE : FALSE;
+}
+
+static void vfs_dir_set_load_priority(VFSDir* dir, VFSAsyncTaskPriority priority)
+{
+    dir->priority = priority;
+    if (dir->task)
+        vfs_async_task_set_priority(dir->task, priority);
+    else if (priority == VFS_ASYNC_TASK_INTERACTIVE && dir->polled)
+    {
+        /* the user looks at it again, don't wait for a long interval */
+        vfs_dir_schedule_poll(dir, TRUE);
+        vfs_dir_balance_watches(dir);
+    }
+}
+
+void vfs_dir_set_shown(VFSDir* dir, gboolean shown)
+{
+    if (shown)
+        ++dir->n_shown;
+    else if (dir->n_shown > 0)
+        --dir->n_shown;
+    /* still shown by another panel or window */
+    vfs_dir_set_load_priority(dir, dir->n_shown > 0 ? VFS_ASYNC_TASK_INTERACTIVE : VFS_ASYNC_TASK_BACKGROUND);
+}
+
+static void free_shown_files(GList* files)
+{
+    g_list_free_full(files, (GDestroyNotify)vfs_file_info_unref);
+}
+
+void vfs_dir_set_shown_files(VFSDir* dir, gpointer view, GList* files)
+{
+    if (!files)
+    {
+        if (dir->shown_files)
+            g_hash_table_remove(dir->shown_files, view);
+        return;
+    }
+    if (G_UNLIKELY(!dir->shown_files))
+        dir->shown_files = g_hash_table_new_full(g_direct_hash, NULL, NULL, (GDestroyNotify)free_shown_files);
+    files = g_list_copy(files);
+    g_list_foreach(files, (GFunc)vfs_file_info_ref, NULL);
+    g_hash_table_insert(dir->shown_files, view, files);
+}
+
+gboolean vfs_dir_is_file_listed(VFSDir* dir)
+{
+    return dir->file_listed;
+}
+
+void vfs_cancel_load(VFSDir* dir)
+{
+    dir->cancel = TRUE;
+    if (dir->task)
+    {
+        // g_printf("spacefm: vfs_cancel_load -> vfs_async_task_cancel\n");
+        vfs_async_task_cancel(dir->task);
+        /* don't do g_object_unref on task here since this is done in the handler of "finish" signal. */
+        dir->task = NULL;
+    }
+}
+
+gboolean update_file_info(VFSDir* dir, VFSFileInfo* file)
+{
+    gboolean ret = FALSE;
+
+    /* vfs_file_info_get frees the old name, which is also the key of the
+     * file in file_hash, so unhash it first and rehash the new name */
+    char* file_name = g_strdup(file->name);
+    GList* l = g_hash_table_lookup(dir->file_hash, file_name);
+    gboolean listed = l && l->data == file;
+    if (listed)
+        g_hash_table_remove(dir->file_hash, file_name);
+
+    char* full_path = g_build_filename(dir->path, file_name, NULL);
+    if (G_LIKELY(full_path))
+    {
+        if (G_LIKELY(vfs_file_info_get(file, full_path, file_name)))
+        {
+            ret = TRUE;
+            /* if( G_UNLIKELY(is_desktop) ) */
+            vfs_file_info_load_special_info(file, full_path);
+            if (listed)
+                g_hash_table_insert(dir->file_hash, file->name, l);
+        }
+        else /* The file doesn't exist */
+        {
+            if (G_UNLIKELY(listed))
+            {
+                dir->file_list = g_list_delete_link(dir->file_list, l);
+                --dir->n_files;
+                if (file)
+                {
+                    g_signal_emit(dir, signals[FILE_DELETED_SIGNAL], 0, file);
+                    vfs_file_info_unref(file);
+                }
+            }
+            ret = FALSE;
+        }
+        g_free(full_path);
+    }
+    g_free(file_name);
+    return ret;
+}
+
+/* Created, deleted and changed files are not handled one event at a time.
+ * Their names are collected per dir, and each is checked once per batch:
+ * a listed file is reloaded (or found deleted), an unlisted one is added
+ * if it exists.  So any sequence of events on a name costs one stat.
+ * The delay between batches grows while a dir keeps changing (a build,
+ * a download...) and shrinks back once it calms down. */
+#define VFS_DIR_NOTIFY_MIN_INTERVAL 100  /* ms */
+#define VFS_DIR_NOTIFY_MAX_INTERVAL 2000 /* ms */
+#define VFS_DIR_NOTIFY_BUSY_CHANGES 64   /* more events per batch than this is busy */
+
+static void vfs_dir_queue_change(VFSDir* dir, const char* file_name)
+{
+    if (G_UNLIKELY(!dir->pending_changes))
+        dir->pending_changes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    if (!g_hash_table_contains(dir->pending_changes, file_name))
+        g_hash_table_add(dir->pending_changes, g_strdup(file_name));
+    ++dir->n_changes;
+
+    if (!dir->notify_timeout)
+    {
+        /* back to short delays after a quiet while */
+        gint64 idle_ms = (g_get_monotonic_time() - dir->last_notify) / 1000;
+        if (!dir->notify_interval || idle_ms > 4 * (gint64)dir->notify_interval)
+            dir->notify_interval = VFS_DIR_NOTIFY_MIN_INTERVAL;
+        dir->notify_timeout = g_timeout_add_full(G_PRIORITY_LOW,
+                                                 dir->notify_interval,
+                                                 (GSourceFunc)vfs_dir_notify_changes,
+                                                 dir,
+                                                 NULL);
+    }
+}
+
+/* Check the files of the pending changes and emit the signals */
+static void vfs_dir_flush_changes(VFSDir* dir)
+{
+    GHashTable* pending = dir->pending_changes;
+    if (!pending)
+        return;
+    dir->pending_changes = NULL;
+
+    vfs_dir_lock(dir);
+    GHashTableIter it;
+    const char* file_name;
+    g_hash_table_iter_init(&it, pending);
+    while (g_hash_table_iter_next(&it, (gpointer*)&file_name, NULL))
+    {
+        VFSFileInfo* file;
+        GList* l = vfs_dir_find_file(dir, file_name, NULL);
+        if (l)
+        {
+            // file already exists in dir file_list
+            file = vfs_file_info_ref((VFSFileInfo*)l->data);
+            if (update_file_info(dir, file))
+                g_signal_emit(dir, signals[FILE_CHANGED_SIGNAL], 0, file);
+            // else was deleted, signaled, and removed in update_file_info
+            vfs_file_info_unref(file);
+        }
+        else
+        {
+            // file is not in dir file_list
+            char* full_path = g_build_filename(dir->path, file_name, NULL);
+            file = vfs_file_info_new();
+            if (vfs_file_info_get(file, full_path, NULL))
+            {
+                // add new file to dir file_list
+                vfs_file_info_load_special_info(file, full_path);
+                vfs_dir_insert_file(dir, vfs_file_info_ref(file));
+                g_signal_emit(dir, signals[FILE_CREATED_SIGNAL], 0, file);
+            }
+            // else file doesn't exist in filesystem
+            vfs_file_info_unref(file);
+            g_free(full_path);
+        }
+    }
+    vfs_dir_unlock(dir);
+    g_hash_table_destroy(pending);
+}
+
+static gboolean vfs_dir_notify_changes(VFSDir* dir)
+{
+    // GDK_THREADS_ENTER();  //sfm not needed because in main thread?
+    dir->notify_timeout = 0;
+    uint n_changes = dir->n_changes;
+    dir->n_changes = 0;
+
+    gint64 start = g_get_monotonic_time();
+    vfs_dir_flush_changes(dir);
+    dir->last_notify = g_get_monotonic_time();
+
+    /* wait longer while busy, and at least 4 times what the batch took
+     * so that the UI is never kept busy more than a fifth of the time */
+    uint interval = dir->notify_interval;
+    if (n_changes > VFS_DIR_NOTIFY_BUSY_CHANGES)
+        interval *= 2;
+    else if (n_changes < VFS_DIR_NOTIFY_BUSY_CHANGES / 4)
+        interval /= 2;
+    interval = MAX(interval, (uint)((dir->last_notify - start) / 1000) * 4);
+    dir->notify_interval = CLAMP(interval, VFS_DIR_NOTIFY_MIN_INTERVAL, VFS_DIR_NOTIFY_MAX_INTERVAL);
     // GDK_THREADS_LEAVE();
     return FALSE;
 }
 
+static void flush_notify_cache(const char* path, VFSDir* dir, gpointer user_data)
+{
+    if (dir->notify_timeout)
+    {
+        g_source_remove(dir->notify_timeout);
+        dir->notify_timeout = 0;
+    }
+    vfs_dir_flush_changes(dir);
+}
+
 void vfs_dir_flush_notify_cache()
 {
-    if (change_notify_timeout)
-        g_source_remove(change_notify_timeout);
-    change_notify_timeout = 0;
-    g_hash_table_foreach(dir_hash, update_changed_files, NULL);
-    g_hash_table_foreach(dir_hash, update_created_files, NULL);
+    if (dir_hash)
+        g_hash_table_foreach(dir_hash, (GHFunc)flush_notify_cache, NULL);
+}
+
+/* When the file monitor lost events, eg on an inotify queue overflow, the
+ * dir is listed again and only the differences from file_list are
+ * signaled.  Overflows come in bursts, so the rescan waits a little. */
+#define VFS_DIR_RESCAN_DELAY 500
+
+static gpointer vfs_dir_rescan_thread(VFSAsyncTask* task, VFSDir* dir)
+{
+    vfs_async_task_lock(task);
+    if (vfs_async_task_is_cancelled(task))
+    {
+        vfs_async_task_unlock(task);
+        return NULL;
+    }
+    char* path = g_strdup(dir->path);
+    gboolean list_cache = dir->list_cache;
+    vfs_async_task_unlock(task);
+
+    int dir_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd != -1)
+    {
+        struct stat dir_stat;
+        gboolean stat_ok = fstat(dir_fd, &dir_stat) == 0;
+        VFSFileInfoArena* arena = vfs_file_info_arena_new();
+        GString* listing = list_cache ? vfs_list_cache_begin(path, stat_ok ? vfs_dir_stat_mtime(&dir_stat) : 0) : NULL;
+        GList* files = NULL;
+        gboolean complete = vfs_dir_read_files(task, dir, dir_fd, path, arena, listing, FALSE, &files);
+        close(dir_fd);
+
+        if (listing && complete)
+            vfs_list_cache_commit(path, listing);
+        else if (listing)
+            g_string_free(listing, TRUE);
+        if (complete)
+        {
+            vfs_dir_set_poll_mtime(task, dir, stat_ok ? &dir_stat : NULL);
+            vfs_dir_set_revalidated_files(task, dir, files);
+        }
+        else
+            vfs_file_info_list_free(files);
+        vfs_file_info_arena_unref(arena);
+    }
+    g_free(path);
+    return NULL;
+}
+
+void on_rescan_task_finished(VFSAsyncTask* task, gboolean is_cancelled, VFSDir* dir)
+{
+    vfs_dir_lock(dir);
+    gboolean revalidated = dir->revalidated;
+    GList* files = dir->revalidated_files;
+    GList* changed_files = dir->poll_changed;
+    dir->revalidated = FALSE;
+    dir->revalidated_files = NULL;
+    dir->poll_changed = NULL;
+    vfs_dir_unlock(dir);
+    gboolean changed = revalidated && vfs_dir_update_listing(dir, files);
+
+    /* files the poll task found changed are checked like monitor events */
+    GList* l;
+    for (l = changed_files; l; l = l->next)
+        vfs_dir_queue_change(dir, (const char*)l->data);
+    changed = changed || changed_files != NULL;
+    g_list_free_full(changed_files, g_free);
+
+    g_object_unref(dir->rescan_task);
+    dir->rescan_task = NULL;
+
+    if (dir->polled && !is_cancelled)
+        vfs_dir_schedule_poll(dir, changed);
+
+    if (dir->rescan_again && !is_cancelled)
+    {
+        dir->rescan_again = FALSE;
+        vfs_dir_queue_rescan(dir);
+    }
+}
+
+static gboolean vfs_dir_rescan(VFSDir* dir)
+{
+    dir->rescan_timeout = 0;
+    if (dir->task || dir->rescan_task)
+    {
+        /* the current listing may have missed the lost events */
+        dir->rescan_again = TRUE;
+        return FALSE;
+    }
+
+    dir->rescan_task = vfs_async_task_new((VFSAsyncFunc)vfs_dir_rescan_thread, dir);
+    vfs_async_task_set_priority(dir->rescan_task, VFS_ASYNC_TASK_BACKGROUND);
+    vfs_async_task_set_device(dir->rescan_task, dir->device);
+    vfs_async_task_set_detachable(dir->rescan_task, TRUE);
+    g_signal_connect(dir->rescan_task, "finish", G_CALLBACK(on_rescan_task_finished), dir);
+    vfs_async_task_execute(dir->rescan_task);
+    return FALSE;
+}
+
+void vfs_dir_queue_rescan(VFSDir* dir)
+{
+    if (!dir->rescan_timeout)
+        dir->rescan_timeout = g_timeout_add(VFS_DIR_RESCAN_DELAY, (GSourceFunc)vfs_dir_rescan, dir);
 }
 
 /* Callback function which will be called when monitored events happen */
@@ -693,6 +1357,12 @@ void vfs_dir_monitor_callback(VFSFileMonitor* fm, VFSFileMonitorEvent event, con
     case VFS_FILE_MONITOR_CHANGE:
         vfs_dir_emit_file_changed(dir, file_name, NULL, FALSE);
         break;
+    case VFS_FILE_MONITOR_OVERFLOW:
+        vfs_dir_queue_rescan(dir);
+        break;
+    case VFS_FILE_MONITOR_RENAME:
+        vfs_dir_emit_file_renamed(dir, fm->renamed_from, file_name);
+        break;
     default:
         g_warning("Error: unrecognized file monitor signal!");
     }
@@ -742,6 +1412,401 @@ VFSDir* vfs_dir_get_by_path_soft(const char* path)
     return dir;
 }
 
+/* Recently used dirs stay loaded after their last user is gone, so that
+ * going back to them is instant.  The cache holds a toggle ref on each, so
+ * it is trimmed as soon as a dir is left, and their file monitors keep
+ * them up to date meanwhile. */
+#define VFS_DIR_CACHE_MAX_DIRS  8
+#define VFS_DIR_CACHE_MAX_FILES 200000
+
+static GQueue dir_cache = G_QUEUE_INIT; /* most recently used first */
+static int cache_trim_queued = 0;
+
+static gboolean vfs_dir_is_unused(VFSDir* dir)
+{
+    /* only the cache's ref is left */
+    return dir->cached && g_atomic_int_get((int*)&G_OBJECT(dir)->ref_count) == 1;
+}
+
+/* An unused dir whose changes were not monitored may be out of date */
+static gboolean vfs_dir_needs_revalidation(VFSDir* dir)
+{
+    return vfs_dir_is_unused(dir) && (!dir->monitor || dir->avoid_changes);
+}
+
+/* Shown as cached meanwhile, the poll task rescans the dir if its mtime
+ * changed since it was listed, see vfs_dir_poll_thread */
+static void vfs_dir_revalidate(VFSDir* dir)
+{
+    if (dir->task || dir->rescan_task)
+        return;
+    uint max_interval, max_files;
+    vfs_dir_get_poll_limits(&max_interval, &max_files);
+    vfs_dir_poll(dir, max_files);
+}
+
+static void on_cached_dir_toggled(gpointer data, GObject* obj, gboolean is_last_ref);
+
+static void vfs_dir_cache_remove_link(GList* l)
+{
+    VFSDir* dir = (VFSDir*)l->data;
+    g_queue_delete_link(&dir_cache, l);
+    dir->cached = FALSE;
+    g_object_remove_toggle_ref(G_OBJECT(dir), on_cached_dir_toggled, NULL);
+}
+
+/* The caller holds a ref on dir.  It stays cached while others use it. */
+void vfs_dir_uncache(VFSDir* dir)
+{
+    if (g_atomic_int_get((int*)&G_OBJECT(dir)->ref_count) > 2)
+        return;
+    GList* l = g_queue_find(&dir_cache, dir);
+    if (l)
+        vfs_dir_cache_remove_link(l);
+}
+
+static void vfs_dir_cache_trim()
+{
+    /* dirs in use cost nothing extra, limit the others */
+    uint n_dirs = 0;
+    int n_files = 0;
+    GList* l;
+    for (l = dir_cache.head; l;)
+    {
+        GList* next = l->next;
+        VFSDir* cached = (VFSDir*)l->data;
+        if (vfs_dir_is_unused(cached))
+        {
+            ++n_dirs;
+            n_files += cached->n_files;
+            /* a dir left before it was listed isn't worth finishing */
+            if (cached->task || n_dirs > VFS_DIR_CACHE_MAX_DIRS || n_files > VFS_DIR_CACHE_MAX_FILES)
+                vfs_dir_cache_remove_link(l);
+        }
+        l = next;
+    }
+}
+
+static void vfs_dir_cache_add(VFSDir* dir)
+{
+    GList* l = g_queue_find(&dir_cache, dir);
+    if (l)
+    {
+        g_queue_unlink(&dir_cache, l);
+        g_queue_push_head_link(&dir_cache, l);
+    }
+    else
+    {
+        g_object_add_toggle_ref(G_OBJECT(dir), on_cached_dir_toggled, NULL);
+        g_queue_push_head(&dir_cache, dir);
+        dir->cached = TRUE;
+    }
+    vfs_dir_cache_trim();
+}
+
+static gboolean on_cache_trim_idle(gpointer user_data)
+{
+    GDK_THREADS_ENTER();
+    g_atomic_int_set(&cache_trim_queued, 0);
+    vfs_dir_cache_trim();
+    GDK_THREADS_LEAVE();
+    return FALSE;
+}
+
+/* Only the cache's ref is left, the dir was just left by its last user.
+ * This runs inside g_object_unref, so the cache is trimmed later. */
+static void on_cached_dir_toggled(gpointer data, GObject* obj, gboolean is_last_ref)
+{
+    if (is_last_ref && g_atomic_int_compare_and_exchange(&cache_trim_queued, 0, 1))
+        g_idle_add(on_cache_trim_idle, NULL);
+}
+
+/* inotify watches are limited, see vfs_file_monitor_get_watch_usage.
+ * When most are used, the dirs least likely to be looked at give up
+ * their file monitor: unused cached dirs, least recently used first, then
+ * dirs only shown in hidden tabs.  Instead, they are polled, see below.
+ * They get a monitor again when they are used and enough watches are
+ * free. */
+#define VFS_DIR_WATCHES_HIGH 75 /* % of the budget, dirs are demoted above this */
+#define VFS_DIR_WATCHES_LOW  50 /* % of the budget, down to this */
+
+/* Changes made by other hosts on network and fuse filesystems, see
+ * vfs_volume_dir_avoid_changes, raise no inotify event either, so these
+ * dirs are polled too.  A poll runs as a background task so that a slow
+ * mount never blocks the main loop: if the dir's mtime changed, files were
+ * added or removed and the dir is rescanned, otherwise a few of its files
+ * are stat'ed again in turn.  The interval doubles while nothing changes.
+ * The longest interval and the files stat'ed per poll are set by the
+ * "dev_poll" setting, an interval of 0 doesn't poll network dirs.
+ * Only dirs without a file monitor are polled, a network dir gives up its
+ * monitor when it is polled instead, unless the watch is shared. */
+#define VFS_DIR_POLL_TICK         1  /* s */
+#define VFS_DIR_POLL_MIN_INTERVAL 3  /* s */
+#define VFS_DIR_POLL_MAX_INTERVAL 60 /* s, unless set */
+#define VFS_DIR_POLL_MAX_FILES    200
+
+typedef struct
+{
+    char* name;
+    mode_t mode;
+    uid_t uid;
+    gid_t gid;
+    off_t size;
+    time_t mtime;
+    guint32 mtime_nsec;
+} PollFile;
+
+static GList* polled_dirs = NULL;
+static uint poll_timeout = 0;
+
+static void vfs_dir_get_poll_limits(uint* max_interval, uint* max_files)
+{
+    *max_interval = VFS_DIR_POLL_MAX_INTERVAL;
+    *max_files = VFS_DIR_POLL_MAX_FILES;
+    const char* limits = xset_get_s("dev_poll");
+    if (limits)
+        sscanf(limits, "%u %u", max_interval, max_files);
+}
+
+static void vfs_dir_free_poll_files(GArray* files)
+{
+    if (!files)
+        return;
+    uint i;
+    for (i = 0; i < files->len; ++i)
+        g_free(g_array_index(files, PollFile, i).name);
+    g_array_free(files, TRUE);
+}
+
+static gpointer vfs_dir_poll_thread(VFSAsyncTask* task, VFSDir* dir)
+{
+    vfs_async_task_lock(task);
+    if (vfs_async_task_is_cancelled(task))
+    {
+        vfs_async_task_unlock(task);
+        return NULL;
+    }
+    char* path = g_strdup(dir->path);
+    vfs_dir_lock(dir);
+    gint64 poll_mtime = dir->poll_mtime;
+    GArray* files = dir->poll_files;
+    dir->poll_files = NULL;
+    vfs_dir_unlock(dir);
+    vfs_async_task_unlock(task);
+
+    struct stat dir_stat;
+    int dir_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd == -1 || fstat(dir_fd, &dir_stat) != 0 || vfs_dir_stat_mtime(&dir_stat) != poll_mtime)
+    {
+        /* files were added, removed or renamed */
+        if (dir_fd != -1)
+            close(dir_fd);
+        vfs_dir_free_poll_files(files);
+        g_free(path);
+        return vfs_dir_rescan_thread(task, dir);
+    }
+
+    GList* changed = NULL;
+    uint i;
+    for (i = 0; files && i < files->len && !vfs_async_task_is_cancelled(task); ++i)
+    {
+        PollFile* file = &g_array_index(files, PollFile, i);
+        struct stat file_stat;
+        if (fstatat(dir_fd, file->name, &file_stat, AT_SYMLINK_NOFOLLOW) != 0 || file_stat.st_mode != file->mode ||
+            file_stat.st_uid != file->uid || file_stat.st_gid != file->gid || file_stat.st_size != file->size ||
+            file_stat.st_mtim.tv_sec != file->mtime || file_stat.st_mtim.tv_nsec != file->mtime_nsec)
+            changed = g_list_prepend(changed, g_strdup(file->name));
+    }
+    close(dir_fd);
+
+    vfs_async_task_lock(task);
+    if (!vfs_async_task_is_cancelled(task))
+    {
+        vfs_dir_lock(dir);
+        dir->poll_changed = g_list_concat(changed, dir->poll_changed);
+        vfs_dir_unlock(dir);
+        changed = NULL;
+    }
+    vfs_async_task_unlock(task);
+    g_list_free_full(changed, g_free);
+    vfs_dir_free_poll_files(files);
+    g_free(path);
+    return NULL;
+}
+
+/* The files to stat again are copied, the task can't read file_list */
+static void vfs_dir_poll(VFSDir* dir, uint max_files)
+{
+    GArray* files = g_array_sized_new(FALSE, FALSE, sizeof(PollFile), MIN(max_files, (uint)dir->n_files));
+    /* the file the last poll stopped at, from the start if it is gone */
+    GList* l = dir->poll_cursor ? vfs_dir_find_file(dir, dir->poll_cursor, NULL) : NULL;
+    if (!l)
+        l = dir->file_list;
+    for (; l && files->len < max_files; l = l->next)
+    {
+        VFSFileInfo* file = (VFSFileInfo*)l->data;
+        PollFile poll_file = {
+            g_strdup(file->name), file->mode, file->uid, file->gid, file->size, file->mtime, file->mtime_nsec};
+        g_array_append_val(files, poll_file);
+    }
+    g_free(dir->poll_cursor);
+    dir->poll_cursor = l ? g_strdup(((VFSFileInfo*)l->data)->name) : NULL;
+
+    vfs_dir_lock(dir);
+    vfs_dir_free_poll_files(dir->poll_files);
+    dir->poll_files = files;
+    vfs_dir_unlock(dir);
+
+    dir->rescan_task = vfs_async_task_new((VFSAsyncFunc)vfs_dir_poll_thread, dir);
+    vfs_async_task_set_priority(dir->rescan_task, VFS_ASYNC_TASK_BACKGROUND);
+    vfs_async_task_set_device(dir->rescan_task, dir->device);
+    vfs_async_task_set_detachable(dir->rescan_task, TRUE);
+    g_signal_connect(dir->rescan_task, "finish", G_CALLBACK(on_rescan_task_finished), dir);
+    vfs_async_task_execute(dir->rescan_task);
+}
+
+static void vfs_dir_schedule_poll(VFSDir* dir, gboolean changed)
+{
+    uint max_interval, max_files;
+    vfs_dir_get_poll_limits(&max_interval, &max_files);
+    max_interval = MAX(max_interval, VFS_DIR_POLL_MIN_INTERVAL);
+    if (changed || !dir->poll_interval)
+        dir->poll_interval = VFS_DIR_POLL_MIN_INTERVAL;
+    else
+        dir->poll_interval = MIN(dir->poll_interval * 2, max_interval);
+    dir->poll_next = g_get_monotonic_time() + (gint64)dir->poll_interval * G_USEC_PER_SEC;
+}
+
+static gboolean on_poll_timeout(gpointer user_data)
+{
+    uint max_interval, max_files;
+    vfs_dir_get_poll_limits(&max_interval, &max_files);
+    gint64 now = g_get_monotonic_time();
+    GList* l;
+    for (l = polled_dirs; l;)
+    {
+        VFSDir* dir = (VFSDir*)l->data;
+        l = l->next;
+        /* watched dirs are never polled */
+        if (dir->monitor)
+            vfs_dir_stop_polling(dir);
+        /* polling of network dirs was turned off, they are watched again */
+        else if (dir->avoid_changes && !max_interval)
+            vfs_dir_promote_monitor(dir);
+        else if (!dir->task && !dir->rescan_task && now >= dir->poll_next)
+            vfs_dir_poll(dir, max_files);
+    }
+    return TRUE;
+}
+
+static void vfs_dir_start_polling(VFSDir* dir)
+{
+    if (dir->polled)
+        return;
+    dir->polled = TRUE;
+    /* poll_mtime is the one recorded by the last listing, so a dir
+     * changed since then is rescanned by its first poll */
+    dir->poll_interval = 0;
+    vfs_dir_schedule_poll(dir, FALSE);
+    polled_dirs = g_list_prepend(polled_dirs, dir);
+    if (!poll_timeout)
+        poll_timeout = g_timeout_add_seconds(VFS_DIR_POLL_TICK, on_poll_timeout, NULL);
+}
+
+void vfs_dir_stop_polling(VFSDir* dir)
+{
+    if (!dir->polled)
+        return;
+    dir->polled = FALSE;
+    g_free(dir->poll_cursor);
+    dir->poll_cursor = NULL;
+    polled_dirs = g_list_remove(polled_dirs, dir);
+    if (!polled_dirs && poll_timeout)
+    {
+        g_source_remove(poll_timeout);
+        poll_timeout = 0;
+    }
+}
+
+static gboolean vfs_dir_watches_above(uint percent)
+{
+    uint used, budget;
+    vfs_file_monitor_get_watch_usage(&used, &budget);
+    return (guint64)used * 100 >= (guint64)budget * percent;
+}
+
+static void vfs_dir_demote_monitor(VFSDir* dir)
+{
+    /* a loading dir installs its monitor itself, and the watch of a
+     * monitor shared with others, eg the dir tree, wouldn't be freed */
+    if (!dir->monitor || dir->task || g_atomic_int_get(&dir->monitor->n_ref) > 1)
+        return;
+    /* changes made from now on are seen by polling */
+    vfs_dir_start_polling(dir);
+    vfs_file_monitor_remove(dir->monitor, vfs_dir_monitor_callback, dir);
+    dir->monitor = NULL;
+}
+
+static void vfs_dir_promote_monitor(VFSDir* dir)
+{
+    if (dir->monitor || !dir->polled || dir->task)
+        return;
+    /* the monitor doesn't see changes made by other hosts, network dirs
+     * stay polled unless polling was turned off */
+    if (dir->avoid_changes)
+    {
+        uint max_interval, max_files;
+        vfs_dir_get_poll_limits(&max_interval, &max_files);
+        if (max_interval)
+            return;
+    }
+    dir->monitor = vfs_file_monitor_add_dir(dir->path, vfs_dir_monitor_callback, dir);
+    if (!dir->monitor)
+        return;
+    vfs_dir_stop_polling(dir);
+    /* polling misses files changed without changing the dir */
+    vfs_dir_queue_rescan(dir);
+}
+
+static void demote_background_dir(const char* path, VFSDir* dir, VFSDir* used_dir)
+{
+    if (dir != used_dir && dir->n_shown == 0 && dir->priority == VFS_ASYNC_TASK_BACKGROUND &&
+        vfs_dir_watches_above(VFS_DIR_WATCHES_LOW))
+        vfs_dir_demote_monitor(dir);
+}
+
+/* Make room for the watch of used_dir, if any, when watches run short */
+void vfs_dir_balance_watches(VFSDir* used_dir)
+{
+    static gboolean was_short = FALSE;
+    gboolean is_short = vfs_dir_watches_above(VFS_DIR_WATCHES_HIGH);
+    if (is_short && !was_short)
+    {
+        uint used, budget;
+        vfs_file_monitor_get_watch_usage(&used, &budget);
+        g_warning("%u of %u inotify watches used, polling unused and background folders", used, budget);
+    }
+    was_short = is_short;
+
+    if (is_short)
+    {
+        GList* l;
+        for (l = dir_cache.tail; l && vfs_dir_watches_above(VFS_DIR_WATCHES_LOW); l = l->prev)
+        {
+            VFSDir* cached = (VFSDir*)l->data;
+            if (cached != used_dir && vfs_dir_is_unused(cached))
+                vfs_dir_demote_monitor(cached);
+        }
+        if (dir_hash && vfs_dir_watches_above(VFS_DIR_WATCHES_LOW))
+            g_hash_table_foreach(dir_hash, (GHFunc)demote_background_dir, used_dir);
+    }
+
+    if (used_dir && used_dir->polled && !vfs_dir_watches_above(VFS_DIR_WATCHES_HIGH))
+        vfs_dir_promote_monitor(used_dir);
+    else if (used_dir && !used_dir->monitor && !used_dir->task)
+        vfs_dir_start_polling(used_dir);
+}
+
 VFSDir* vfs_dir_get_by_path(const char* path)
 {
     VFSDir* dir = NULL;
@@ -756,16 +1821,19 @@ VFSDir* vfs_dir_get_by_path(const char* path)
                 g_signal_connect(gtk_icon_theme_get_default(), "changed", G_CALLBACK(on_theme_changed), NULL);
     }
     else
-    {
         dir = g_hash_table_lookup(dir_hash, path);
-    }
 
     if (G_UNLIKELY(!mime_cb))
         mime_cb = vfs_mime_type_add_reload_cb(on_mime_type_reload, NULL);
 
     if (dir)
     {
+        gboolean revalidate = vfs_dir_needs_revalidation(dir);
         g_object_ref(dir);
+        /* wanted again, not only by a hidden tab */
+        dir->priority = VFS_ASYNC_TASK_INTERACTIVE;
+        if (revalidate || dir->polled)
+            vfs_dir_revalidate(dir);
     }
     else
     {
@@ -773,32 +1841,222 @@ VFSDir* vfs_dir_get_by_path(const char* path)
         vfs_dir_load(dir); /* asynchronous operation */
         g_hash_table_insert(dir_hash, (gpointer)dir->path, (gpointer)dir);
     }
+    vfs_dir_cache_add(dir);
+    vfs_dir_balance_watches(dir);
     return dir;
 }
 
-static void reload_mime_type(char* key, VFSDir* dir, gpointer user_data)
+/* Files are listed with a mime type guessed from their name only, see
+ * vfs_file_info_get_at.  The content of the others is sniffed on demand.
+ * The same worker re-types the files when the mime database changes. */
+
+typedef struct
 {
-    GList* l;
     VFSFileInfo* file;
+    char* name;
+    struct stat file_stat;
+    time_t mtime;
+    VFSMimeType* mime_type;
+} MimeSniff;
 
-    if (G_UNLIKELY(!dir || !dir->file_list))
-        return;
-    vfs_dir_lock(dir);
-    for (l = dir->file_list; l; l = l->next)
+typedef struct
+{
+    VFSDir* dir;
+    GArray* sniffs;
+    gboolean retype; /* re-typing after a mime database reload */
+} MimeSniffJob;
+
+#define MIME_RETYPE_JOB_FILES 1024
+
+static GThreadPool* mime_sniff_pool = NULL;
+static GHashTable* mime_sniff_queued = NULL; /* files in a job, main thread only */
+
+gboolean vfs_dir_load_mime_type(VFSDir* dir, VFSFileInfo* file)
+{
+    if (!vfs_file_info_is_mime_pending(file))
+        return FALSE;
+    char* full_path = g_build_filename(dir->path, vfs_file_info_get_name(file), NULL);
+    gboolean changed = vfs_file_info_load_mime_type(file, full_path);
+    g_free(full_path);
+    return changed;
+}
+
+static gboolean on_mime_sniff_job_done(MimeSniffJob* job)
+{
+    GDK_THREADS_ENTER();
+
+    VFSDir* dir = job->dir;
+    uint i;
+    for (i = 0; i < job->sniffs->len; ++i)
     {
-        file = (VFSFileInfo*)l->data;
-        char* full_path = g_build_filename(dir->path, vfs_file_info_get_name(file), NULL);
-        vfs_file_info_reload_mime_type(file, full_path);
-        /* g_debug( "reload %s", full_path ); */
-        g_free(full_path);
+        MimeSniff* sniff = &g_array_index(job->sniffs, MimeSniff, i);
+        VFSFileInfo* file = sniff->file;
+        if (!job->retype)
+            g_hash_table_remove(mime_sniff_queued, file);
+
+        /* the file may have been reloaded, renamed or removed meanwhile */
+        vfs_dir_lock(dir);
+        gboolean listed = !strcmp(file->name, sniff->name) && vfs_dir_find_file(dir, file->name, file);
+        vfs_dir_unlock(dir);
+        if (listed && sniff->mime_type && file->mtime == sniff->mtime &&
+            job->retype != vfs_file_info_is_mime_pending(file))
+        {
+            /* a reload replaces all VFSMimeType, only a new type name is a change */
+            gboolean changed = !job->retype || strcmp(vfs_mime_type_get_type(file->mime_type),
+                                                      vfs_mime_type_get_type(sniff->mime_type));
+            if (vfs_file_info_set_sniffed_mime_type(file, sniff->mime_type) && changed)
+            {
+                if (job->retype)
+                {
+                    char* full_path = g_build_filename(dir->path, file->name, NULL);
+                    vfs_file_info_load_special_info(file, full_path);
+                    g_free(full_path);
+                }
+                g_signal_emit(dir, signals[FILE_CHANGED_SIGNAL], 0, file);
+            }
+            sniff->mime_type = NULL;
+        }
+
+        if (sniff->mime_type)
+            vfs_mime_type_unref(sniff->mime_type);
+        vfs_file_info_unref(file);
+        g_free(sniff->name);
     }
+    g_array_free(job->sniffs, TRUE);
+    g_object_unref(dir);
+    g_slice_free(MimeSniffJob, job);
+
+    GDK_THREADS_LEAVE();
+    return FALSE;
+}
+
+static MimeSniffJob* mime_sniff_job_new(VFSDir* dir, gboolean retype)
+{
+    MimeSniffJob* job = g_slice_new(MimeSniffJob);
+    job->dir = g_object_ref(dir);
+    job->sniffs = g_array_new(FALSE, TRUE, sizeof(MimeSniff));
+    job->retype = retype;
+    return job;
+}
+
+static void mime_sniff_job_add(MimeSniffJob* job, VFSFileInfo* file)
+{
+    MimeSniff sniff;
+    sniff.file = vfs_file_info_ref(file);
+    sniff.name = g_strdup(file->name);
+    sniff.file_stat.st_mode = file->mode;
+    sniff.file_stat.st_size = file->size;
+    sniff.mtime = file->mtime;
+    sniff.mime_type = NULL;
+    g_array_append_val(job->sniffs, sniff);
+}
 
+static void mime_sniff_job_run(MimeSniffJob* job, gpointer user_data)
+{
+    uint i;
+    for (i = 0; i < job->sniffs->len; ++i)
+    {
+        MimeSniff* sniff = &g_array_index(job->sniffs, MimeSniff, i);
+        /* the file itself may be updated by the main thread meanwhile */
+        char* path = g_build_filename(job->dir->path, sniff->name, NULL);
+        sniff->mime_type = vfs_mime_type_get_from_file(path, NULL, &sniff->file_stat);
+        g_free(path);
+    }
+    /* results are applied in the main thread, which also owns the dir ref */
+    g_idle_add((GSourceFunc)on_mime_sniff_job_done, job);
+}
+
+static void mime_sniff_job_push(MimeSniffJob* job)
+{
+    /* one thread keeps the disk from seeking between files */
+    if (G_UNLIKELY(!mime_sniff_pool))
+        mime_sniff_pool = g_thread_pool_new((GFunc)mime_sniff_job_run, NULL, 1, FALSE, NULL);
+    g_thread_pool_push(mime_sniff_pool, job, NULL);
+}
+
+/* Sniff the pending files among files in a worker thread.
+ * "file-changed" is emitted for those whose type turns out different. */
+void vfs_dir_load_mime_types(VFSDir* dir, GList* files)
+{
+    MimeSniffJob* job = NULL;
+    GList* l;
+    for (l = files; l; l = l->next)
+    {
+        VFSFileInfo* file = (VFSFileInfo*)l->data;
+        if (!vfs_file_info_is_mime_pending(file))
+            continue;
+        if (G_UNLIKELY(!mime_sniff_queued))
+            mime_sniff_queued = g_hash_table_new(g_direct_hash, NULL);
+        else if (g_hash_table_contains(mime_sniff_queued, file))
+            continue;
+        g_hash_table_add(mime_sniff_queued, file);
+
+        if (!job)
+            job = mime_sniff_job_new(dir, FALSE);
+        mime_sniff_job_add(job, file);
+    }
+    if (job)
+        mime_sniff_job_push(job);
+}
+
+static void mime_retype_job_add(VFSDir* dir, MimeSniffJob** job, VFSFileInfo* file)
+{
+    if (!*job)
+        *job = mime_sniff_job_new(dir, TRUE);
+    mime_sniff_job_add(*job, file);
+    if ((*job)->sniffs->len >= MIME_RETYPE_JOB_FILES)
+    {
+        mime_sniff_job_push(*job);
+        *job = NULL;
+    }
+}
+
+/* Re-type the files of dir in the worker, in jobs of a bounded size,
+ * the rows on screen first */
+static void vfs_dir_retype_files(VFSDir* dir)
+{
+    MimeSniffJob* job = NULL;
+    GHashTable* shown = NULL;
+    GHashTableIter it;
+    GList* files;
+    GList* l;
+
+    if (dir->shown_files)
+    {
+        shown = g_hash_table_new(g_direct_hash, NULL);
+        g_hash_table_iter_init(&it, dir->shown_files);
+        while (g_hash_table_iter_next(&it, NULL, (gpointer*)&files))
+        {
+            for (l = files; l; l = l->next)
+            {
+                VFSFileInfo* file = (VFSFileInfo*)l->data;
+                if (vfs_file_info_is_mime_pending(file) || !g_hash_table_add(shown, file))
+                    continue;
+                mime_retype_job_add(dir, &job, file);
+            }
+        }
+        /* don't wait for a full job */
+        if (job)
+        {
+            mime_sniff_job_push(job);
+            job = NULL;
+        }
+    }
+
+    vfs_dir_lock(dir);
     for (l = dir->file_list; l; l = l->next)
     {
-        file = (VFSFileInfo*)l->data;
-        g_signal_emit(dir, signals[FILE_CHANGED_SIGNAL], 0, file);
+        VFSFileInfo* file = (VFSFileInfo*)l->data;
+        /* files still pending are sniffed with the new database anyway */
+        if (vfs_file_info_is_mime_pending(file) || (shown && g_hash_table_contains(shown, file)))
+            continue;
+        mime_retype_job_add(dir, &job, file);
     }
     vfs_dir_unlock(dir);
+    if (job)
+        mime_sniff_job_push(job);
+    if (shown)
+        g_hash_table_destroy(shown);
 }
 
 static void on_mime_type_reload(gpointer user_data)
@@ -806,7 +2064,28 @@ static void on_mime_type_reload(gpointer user_data)
     if (!dir_hash)
         return;
     /* g_debug( "reload mime-type" ); */
-    g_hash_table_foreach(dir_hash, (GHFunc)reload_mime_type, NULL);
+
+    /* the worker takes jobs in order, so queue the dirs on screen first,
+     * then those of hidden tabs, then those only kept in the cache of
+     * recent dirs */
+    GList* dirs = g_hash_table_get_values(dir_hash);
+    GList* l;
+    for (l = dirs; l; l = l->next)
+    {
+        if (((VFSDir*)l->data)->n_shown > 0)
+            vfs_dir_retype_files((VFSDir*)l->data);
+    }
+    for (l = dirs; l; l = l->next)
+    {
+        if (((VFSDir*)l->data)->n_shown == 0 && !vfs_dir_is_unused((VFSDir*)l->data))
+            vfs_dir_retype_files((VFSDir*)l->data);
+    }
+    for (l = dirs; l; l = l->next)
+    {
+        if (((VFSDir*)l->data)->n_shown == 0 && vfs_dir_is_unused((VFSDir*)l->data))
+            vfs_dir_retype_files((VFSDir*)l->data);
+    }
+    g_list_free(dirs);
 }
 
 /* Thanks to the freedesktop.org, things are much more complicated now... */
@@ -889,6 +2168,18 @@ void vfs_dir_unload_thumbnails(VFSDir* dir, gboolean is_big)
 #endif
 }
 
+/* Drop the sort keys of a dir no longer on screen, they are
+ * recomputed on demand if it is sorted again */
+void vfs_dir_unload_collate_keys(VFSDir* dir)
+{
+    GList* l;
+
+    vfs_dir_lock(dir);
+    for (l = dir->file_list; l; l = l->next)
+        vfs_file_info_unload_collate_keys((VFSFileInfo*)l->data);
+    vfs_dir_unlock(dir);
+}
+
 // sfm added mime change timer
 uint mime_change_timer = 0;
 VFSDir* mime_dir = NULL;
@@ -942,6 +2233,7 @@ void vfs_dir_monitor_mime()
             g_signal_connect(mime_dir, "file-created", G_CALLBACK(mime_change), NULL);
             g_signal_connect(mime_dir, "file-deleted", G_CALLBACK(mime_change), NULL);
             g_signal_connect(mime_dir, "file-changed", G_CALLBACK(mime_change), NULL);
+            g_signal_connect(mime_dir, "file-renamed", G_CALLBACK(mime_change), NULL);
         }
         // g_printf("MIME-UPDATE watch started\n" );
     }
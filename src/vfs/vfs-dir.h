@@ -36,6 +36,7 @@ struct _VFSDir
     char* disp_path;
     GList* file_list;
     int n_files;
+    GHashTable* file_hash; /* file name => link in file_list */
 
     union
     {
@@ -53,7 +54,7 @@ struct _VFSDir
     /*<private>*/
     VFSFileMonitor* monitor;
 
-    GMutex* mutex; /* Used to guard file_list */
+    GMutex mutex; /* Used to guard file_list */
 
     VFSAsyncTask* task;
     gboolean file_listed : 1;
@@ -61,11 +62,39 @@ struct _VFSDir
     gboolean cancel : 1;
     gboolean show_hidden : 1;
     gboolean avoid_changes : 1; // sfm
+    gboolean list_cache : 1;    /* shown from vfs-list-cache.h while listed again */
+    gboolean cached : 1;        /* in the cache of recent dirs, which holds a ref */
 
     struct _VFSThumbnailLoader* thumbnail_loader;
 
-    GSList* changed_files;
-    GSList* created_files; // MOD
+    GHashTable* pending_changes; /* names of the files to recheck in the next batch */
+    uint notify_timeout;
+    uint notify_interval; /* delay of the next batch in ms, adapts to the rate of changes */
+    uint n_changes;       /* events since the last batch */
+    gint64 last_notify;   /* monotonic time of the last batch */
+
+    GList* loaded_files; /* listed by the loader but not yet published, guarded by mutex */
+    uint loaded_idle;
+    GHashTable* load_changes; /* names of the files with events while loading */
+    GList* revalidated_files; /* listed again after a cached listing or a rescan, guarded by mutex */
+    gboolean revalidated;     /* revalidated_files is set, it may be empty */
+
+    VFSAsyncTask* rescan_task; /* lists the dir again after file monitor events were lost */
+    uint rescan_timeout;
+    gboolean rescan_again; /* events were lost while listing */
+
+    VFSAsyncTaskPriority priority; /* background if only shown in a hidden tab */
+    int n_shown;                   /* views showing the dir on screen, see vfs_dir_set_shown */
+    GHashTable* shown_files;       /* view => list of its rows on screen, main thread only */
+    gboolean polled;               /* changes are polled, see vfs_dir_start_polling */
+    gint64 poll_mtime;             /* of the dir when it was listed, in ns, guarded by mutex */
+    uint poll_interval;            /* s, doubles while the dir doesn't change */
+    gint64 poll_next;              /* monotonic time of the next poll */
+    char* poll_cursor;             /* name of the next file to stat again */
+    GArray* poll_files;            /* handed to the poll task, guarded by mutex */
+    GList* poll_changed;           /* names found changed by the poll task, guarded by mutex */
+
+    dev_t device; /* of the dir, 0 if unknown */
 };
 
 struct _VFSDirClass
@@ -75,8 +104,10 @@ struct _VFSDirClass
     void (*file_created)(VFSDir* dir, VFSFileInfo* file);
     void (*file_deleted)(VFSDir* dir, VFSFileInfo* file);
     void (*file_changed)(VFSDir* dir, VFSFileInfo* file);
+    void (*file_renamed)(VFSDir* dir, VFSFileInfo* file);
     void (*thumbnail_loaded)(VFSDir* dir, VFSFileInfo* file);
     void (*file_listed)(VFSDir* dir);
+    void (*files_loaded)(VFSDir* dir, GList* files);
     void (*load_complete)(VFSDir* dir);
     /*  void (*need_reload) ( VFSDir* dir ); */
     /*  void (*update_mime) ( VFSDir* dir ); */
@@ -91,17 +122,31 @@ GType vfs_dir_get_type(void);
 
 VFSDir* vfs_dir_get_by_path(const char* path);
 VFSDir* vfs_dir_get_by_path_soft(const char* path);
+void vfs_dir_uncache(VFSDir* dir);
 
 gboolean vfs_dir_is_loading(VFSDir* dir);
+/* Count a view which starts or stops showing the dir on screen.  Dirs only
+ * shown in hidden tabs are listed after the others, and are the first to
+ * lose their file monitor when inotify watches run short. */
+void vfs_dir_set_shown(VFSDir* dir, gboolean shown);
+/* The rows of a view currently on screen, which are re-typed first after
+ * a mime database reload.  NULL forgets the view. */
+void vfs_dir_set_shown_files(VFSDir* dir, gpointer view, GList* files);
 void vfs_dir_cancel_load(VFSDir* dir);
 gboolean vfs_dir_is_file_listed(VFSDir* dir);
 
 void vfs_dir_unload_thumbnails(VFSDir* dir, gboolean is_big);
+void vfs_dir_unload_collate_keys(VFSDir* dir);
+
+/* sniff the content of files whose mime type is still pending */
+gboolean vfs_dir_load_mime_type(VFSDir* dir, VFSFileInfo* file);
+void vfs_dir_load_mime_types(VFSDir* dir, GList* files);
 
 /* emit signals */
 void vfs_dir_emit_file_created(VFSDir* dir, const char* file_name, gboolean force);
 void vfs_dir_emit_file_deleted(VFSDir* dir, const char* file_name, VFSFileInfo* file);
 void vfs_dir_emit_file_changed(VFSDir* dir, const char* file_name, VFSFileInfo* file, gboolean force);
+void vfs_dir_emit_file_renamed(VFSDir* dir, const char* old_name, const char* new_name);
 void vfs_dir_emit_thumbnail_loaded(VFSDir* dir, VFSFileInfo* file);
 void vfs_dir_flush_notify_cache();
 
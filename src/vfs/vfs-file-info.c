@@ -13,6 +13,7 @@
 #include "vfs-file-info.h"
 #include <glib.h>
 #include <glib/gi18n.h>
+#include <fcntl.h> /* for fstatat */
 #include <grp.h> /* Query group name */
 #include <pwd.h> /* Query user name */
 #include <string.h>
@@ -38,6 +39,57 @@ VFSFileInfo* vfs_file_info_new()
     return fi;
 }
 
+/* The names of the files listed by one directory load are packed in an
+ * arena rather than allocated one by one.  Only the loading thread adds
+ * names; every file whose name is in the arena holds a ref on it. */
+struct _VFSFileInfoArena
+{
+    int n_ref;
+    GStringChunk* names;
+};
+
+VFSFileInfoArena* vfs_file_info_arena_new()
+{
+    VFSFileInfoArena* arena = g_slice_new(VFSFileInfoArena);
+    arena->n_ref = 1;
+    arena->names = g_string_chunk_new(16384);
+    return arena;
+}
+
+void vfs_file_info_arena_unref(VFSFileInfoArena* arena)
+{
+    if (g_atomic_int_dec_and_test(&arena->n_ref))
+    {
+        g_string_chunk_free(arena->names);
+        g_slice_free(VFSFileInfoArena, arena);
+    }
+}
+
+static void vfs_file_info_free_name(VFSFileInfo* fi)
+{
+    if (fi->arena)
+    {
+        vfs_file_info_arena_unref(fi->arena);
+        fi->arena = NULL;
+    }
+    else
+        g_free(fi->name);
+    fi->name = NULL;
+}
+
+/* Move the name out of the arena, so that a file kept after its dir is
+ * gone doesn't keep the names of the whole listing alive */
+void vfs_file_info_detach_arena(VFSFileInfo* fi)
+{
+    if (!fi->arena)
+        return;
+    char* name = g_strdup(fi->name);
+    if (fi->disp_name == fi->name)
+        fi->disp_name = name;
+    vfs_file_info_free_name(fi);
+    fi->name = name;
+}
+
 static void vfs_file_info_clear(VFSFileInfo* fi)
 {
     if (fi->disp_name && fi->disp_name != fi->name)
@@ -46,10 +98,7 @@ static void vfs_file_info_clear(VFSFileInfo* fi)
         fi->disp_name = NULL;
     }
     if (fi->name)
-    {
-        g_free(fi->name);
-        fi->name = NULL;
-    }
+        vfs_file_info_free_name(fi);
     if (fi->collate_key) // sfm
     {
         g_free(fi->collate_key);
@@ -60,21 +109,7 @@ static void vfs_file_info_clear(VFSFileInfo* fi)
         g_free(fi->collate_icase_key);
         fi->collate_icase_key = NULL;
     }
-    if (fi->disp_size)
-    {
-        g_free(fi->disp_size);
-        fi->disp_size = NULL;
-    }
-    if (fi->disp_owner)
-    {
-        g_free(fi->disp_owner);
-        fi->disp_owner = NULL;
-    }
-    if (fi->disp_mtime)
-    {
-        g_free(fi->disp_mtime);
-        fi->disp_mtime = NULL;
-    }
+    fi->disp_owner = NULL;
     if (fi->big_thumbnail)
     {
         g_object_unref(fi->big_thumbnail);
@@ -111,6 +146,27 @@ void vfs_file_info_unref(VFSFileInfo* fi)
     }
 }
 
+static void vfs_file_info_set_stat(VFSFileInfo* fi, struct stat* file_stat)
+{
+    /* This is time-consuming but can save much memory */
+    fi->mode = file_stat->st_mode;
+    fi->uid = file_stat->st_uid;
+    fi->gid = file_stat->st_gid;
+    fi->size = file_stat->st_size;
+    // g_printf("size %s %llu\n", fi->name, fi->size );
+    fi->mtime = file_stat->st_mtime;
+    fi->mtime_nsec = file_stat->st_mtim.tv_nsec;
+
+    if (G_LIKELY(utf8_file_name && g_utf8_validate(fi->name, -1, NULL)))
+    {
+        fi->disp_name = fi->name; /* Don't duplicate the name and save memory */
+    }
+    else
+    {
+        fi->disp_name = g_filename_display_name(fi->name);
+    }
+}
+
 gboolean vfs_file_info_get(VFSFileInfo* fi, const char* file_path, const char* base_name)
 {
     struct stat file_stat;
@@ -123,32 +179,73 @@ gboolean vfs_file_info_get(VFSFileInfo* fi, const char* file_path, const char* b
 
     if (lstat(file_path, &file_stat) == 0)
     {
-        /* This is time-consuming but can save much memory */
-        fi->mode = file_stat.st_mode;
-        fi->dev = file_stat.st_dev;
-        fi->uid = file_stat.st_uid;
-        fi->gid = file_stat.st_gid;
-        fi->size = file_stat.st_size;
-        // g_printf("size %s %llu\n", fi->name, fi->size );
-        fi->mtime = file_stat.st_mtime;
-        fi->atime = file_stat.st_atime;
-        fi->blksize = file_stat.st_blksize;
-        fi->blocks = file_stat.st_blocks;
-
-        if (G_LIKELY(utf8_file_name && g_utf8_validate(fi->name, -1, NULL)))
+        vfs_file_info_set_stat(fi, &file_stat);
+        fi->mime_type = vfs_mime_type_get_from_file(file_path, fi->disp_name, &file_stat);
+        return TRUE;
+    }
+    else
+        fi->mime_type = vfs_mime_type_get_from_type(XDG_MIME_TYPE_UNKNOWN);
+    return FALSE;
+}
+
+static void vfs_file_info_set_arena_name(VFSFileInfo* fi, const char* base_name, VFSFileInfoArena* arena)
+{
+    if (arena)
+    {
+        fi->name = g_string_chunk_insert(arena->names, base_name);
+        g_atomic_int_inc(&arena->n_ref);
+        fi->arena = arena;
+    }
+    else
+        fi->name = g_strdup(base_name);
+}
+
+/* Type fi by its name only, type_stat is NULL for a broken link.
+ * The content is not read, see VFS_FILE_INFO_MIME_PENDING. */
+static VFSMimeType* vfs_file_info_guess_mime_type(VFSFileInfo* fi, struct stat* type_stat)
+{
+    const char* type;
+    fi->flags &= ~VFS_FILE_INFO_MIME_PENDING;
+    if (G_UNLIKELY(!type_stat))
+        type = XDG_MIME_TYPE_UNKNOWN;
+    else
+    {
+        type = mime_type_get_by_filename(fi->disp_name, type_stat);
+        if (G_UNLIKELY(!strcmp(type, XDG_MIME_TYPE_UNKNOWN)))
         {
-            fi->disp_name = fi->name; /* Don't duplicate the name and save memory */
+            /* same as mime_type_get_by_file without magic */
+            if (type_stat->st_size > 0 && S_ISREG(type_stat->st_mode))
+                fi->flags |= VFS_FILE_INFO_MIME_PENDING;
+            else
+                type = XDG_MIME_TYPE_PLAIN_TEXT;
         }
-        else
+    }
+    return vfs_mime_type_get_from_type(type);
+}
+
+gboolean vfs_file_info_get_at(VFSFileInfo* fi, int dir_fd, const char* dir_path, const char* base_name,
+                              VFSFileInfoArena* arena)
+{
+    struct stat file_stat;
+    vfs_file_info_clear(fi);
+    vfs_file_info_set_arena_name(fi, base_name, arena);
+
+    if (fstatat(dir_fd, base_name, &file_stat, AT_SYMLINK_NOFOLLOW) == 0)
+    {
+        vfs_file_info_set_stat(fi, &file_stat);
+
+        /* Symlinks are typed by their target, which must be stat'ed to
+         * know if it is a directory.  The content is not read here. */
+        struct stat target_stat;
+        struct stat* type_stat = &file_stat;
+        if (G_UNLIKELY(S_ISLNK(file_stat.st_mode)))
         {
-            fi->disp_name = g_filename_display_name(fi->name);
+            type_stat = &target_stat;
+            if (fstatat(dir_fd, base_name, &target_stat, 0) != 0)
+                type_stat = NULL;
         }
-        fi->mime_type = vfs_mime_type_get_from_file(file_path, fi->disp_name, &file_stat);
-        // sfm get collate keys
-        fi->collate_key = g_utf8_collate_key_for_filename(fi->disp_name, -1);
-        char* str = g_utf8_casefold(fi->disp_name, -1);
-        fi->collate_icase_key = g_utf8_collate_key_for_filename(str, -1);
-        g_free(str);
+
+        fi->mime_type = vfs_file_info_guess_mime_type(fi, type_stat);
         return TRUE;
     }
     else
@@ -156,6 +253,106 @@ gboolean vfs_file_info_get(VFSFileInfo* fi, const char* file_path, const char* b
     return FALSE;
 }
 
+void vfs_file_info_get_cached(VFSFileInfo* fi, const char* base_name, struct stat* file_stat, const char* mime_type,
+                              gboolean mime_pending, VFSFileInfoArena* arena)
+{
+    vfs_file_info_clear(fi);
+    vfs_file_info_set_arena_name(fi, base_name, arena);
+    vfs_file_info_set_stat(fi, file_stat);
+    if (mime_pending)
+        fi->flags |= VFS_FILE_INFO_MIME_PENDING;
+    fi->mime_type = vfs_mime_type_get_from_type(mime_type);
+}
+
+/* Give fi the new name of its renamed file.  Thumbnails and other loaded
+ * data are kept unless the type guessed from the new name differs.
+ * Returns FALSE, leaving fi unchanged, if the file is gone. */
+gboolean vfs_file_info_rename(VFSFileInfo* fi, const char* full_path, const char* new_name)
+{
+    struct stat file_stat;
+    if (lstat(full_path, &file_stat) != 0)
+        return FALSE;
+
+    if (fi->disp_name && fi->disp_name != fi->name)
+        g_free(fi->disp_name);
+    fi->disp_name = NULL;
+    vfs_file_info_free_name(fi);
+    fi->name = g_strdup(new_name);
+    vfs_file_info_unload_collate_keys(fi);
+    fi->disp_perm[0] = '\0';
+    vfs_file_info_set_stat(fi, &file_stat);
+
+    struct stat target_stat;
+    struct stat* type_stat = &file_stat;
+    if (G_UNLIKELY(S_ISLNK(file_stat.st_mode)))
+        type_stat = stat(full_path, &target_stat) == 0 ? &target_stat : NULL;
+    gboolean was_pending = vfs_file_info_is_mime_pending(fi);
+    VFSMimeType* mime_type = vfs_file_info_guess_mime_type(fi, type_stat);
+    if (vfs_file_info_is_mime_pending(fi))
+    {
+        /* the new name tells nothing, the content is the same */
+        if (!was_pending)
+            fi->flags &= ~VFS_FILE_INFO_MIME_PENDING;
+        vfs_mime_type_unref(mime_type);
+    }
+    else if (!strcmp(vfs_mime_type_get_type(mime_type), vfs_mime_type_get_type(fi->mime_type)))
+        vfs_mime_type_unref(mime_type);
+    else
+    {
+        vfs_mime_type_unref(fi->mime_type);
+        fi->mime_type = mime_type;
+        if (fi->big_thumbnail)
+        {
+            g_object_unref(fi->big_thumbnail);
+            fi->big_thumbnail = NULL;
+        }
+        if (fi->small_thumbnail)
+        {
+            g_object_unref(fi->small_thumbnail);
+            fi->small_thumbnail = NULL;
+        }
+    }
+    fi->flags &= ~VFS_FILE_INFO_DESKTOP_ENTRY;
+    vfs_file_info_load_special_info(fi, full_path);
+    return TRUE;
+}
+
+/* Take the stat and type of newer, the same file listed again, so that
+ * fi stays the one shown in the views.  Its thumbnails are replaced by
+ * those of newer if the content changed. */
+void vfs_file_info_update(VFSFileInfo* fi, VFSFileInfo* newer)
+{
+    gboolean content_changed = fi->size != newer->size || fi->mtime != newer->mtime ||
+                               fi->mtime_nsec != newer->mtime_nsec || fi->mode != newer->mode;
+    fi->mode = newer->mode;
+    fi->uid = newer->uid;
+    fi->gid = newer->gid;
+    fi->size = newer->size;
+    fi->mtime = newer->mtime;
+    fi->mtime_nsec = newer->mtime_nsec;
+    fi->flags = newer->flags;
+    fi->disp_owner = NULL;
+    fi->disp_perm[0] = '\0';
+
+    vfs_mime_type_ref(newer->mime_type);
+    vfs_mime_type_unref(fi->mime_type);
+    fi->mime_type = newer->mime_type;
+
+    /* a desktop entry is shown with the name it sets */
+    if (newer->disp_name != newer->name && g_strcmp0(fi->disp_name, newer->disp_name))
+        vfs_file_info_set_disp_name(fi, newer->disp_name);
+
+    if (content_changed)
+    {
+        if (fi->big_thumbnail)
+            g_object_unref(fi->big_thumbnail);
+        fi->big_thumbnail = newer->big_thumbnail ? g_object_ref(newer->big_thumbnail) : NULL;
+        if (fi->small_thumbnail)
+            g_object_unref(fi->small_thumbnail);
+        fi->small_thumbnail = newer->small_thumbnail ? g_object_ref(newer->small_thumbnail) : NULL;
+    }
+}
+
 const char* vfs_file_info_get_name(VFSFileInfo* fi)
 {
     return fi->name;
@@ -172,18 +369,39 @@ void vfs_file_info_set_disp_name(VFSFileInfo* fi, const char* name)
     if (fi->disp_name && fi->disp_name != fi->name)
         g_free(fi->disp_name);
     fi->disp_name = g_strdup(name);
-    // sfm get new collate keys
+    vfs_file_info_unload_collate_keys(fi);
+}
+
+/* The collate keys are only needed to sort by name, so they are
+ * computed on first use and can be dropped again at any time */
+const char* vfs_file_info_get_collate_key(VFSFileInfo* fi, gboolean icase)
+{
+    if (icase)
+    {
+        if (G_UNLIKELY(!fi->collate_icase_key))
+        {
+            char* str = g_utf8_casefold(fi->disp_name, -1);
+            fi->collate_icase_key = g_utf8_collate_key_for_filename(str, -1);
+            g_free(str);
+        }
+        return fi->collate_icase_key;
+    }
+    if (G_UNLIKELY(!fi->collate_key))
+        fi->collate_key = g_utf8_collate_key_for_filename(fi->disp_name, -1);
+    return fi->collate_key;
+}
+
+void vfs_file_info_unload_collate_keys(VFSFileInfo* fi)
+{
     g_free(fi->collate_key);
+    fi->collate_key = NULL;
     g_free(fi->collate_icase_key);
-    fi->collate_key = g_utf8_collate_key_for_filename(fi->disp_name, -1);
-    char* str = g_utf8_casefold(fi->disp_name, -1);
-    fi->collate_icase_key = g_utf8_collate_key_for_filename(str, -1);
-    g_free(str);
+    fi->collate_icase_key = NULL;
 }
 
 void vfs_file_info_set_name(VFSFileInfo* fi, const char* name)
 {
-    g_free(fi->name);
+    vfs_file_info_free_name(fi);
     fi->name = g_strdup(name);
 }
 
@@ -192,20 +410,10 @@ off_t vfs_file_info_get_size(VFSFileInfo* fi)
     return fi->size;
 }
 
-const char* vfs_file_info_get_disp_size(VFSFileInfo* fi)
+/* Not kept in fi to save memory, buf should hold 64 bytes */
+void vfs_file_info_get_disp_size(VFSFileInfo* fi, char* buf)
 {
-    if (G_UNLIKELY(!fi->disp_size))
-    {
-        char buf[64];
-        vfs_file_size_to_string(buf, fi->size);
-        fi->disp_size = g_strdup(buf);
-    }
-    return fi->disp_size;
-}
-
-off_t vfs_file_info_get_blocks(VFSFileInfo* fi)
-{
-    return fi->blocks;
+    vfs_file_size_to_string(buf, fi->size);
 }
 
 VFSMimeType* vfs_file_info_get_mime_type(VFSFileInfo* fi)
@@ -234,12 +442,45 @@ void vfs_file_info_reload_mime_type(VFSFileInfo* fi, const char* full_path)
     file_stat.st_blksize = fi->blksize;
     file_stat.st_blocks = fi->blocks;
     */
+    fi->flags &= ~VFS_FILE_INFO_MIME_PENDING;
     VFSMimeType* old_mime_type = fi->mime_type;
     fi->mime_type = vfs_mime_type_get_from_file(full_path, fi->name, &file_stat);
     vfs_file_info_load_special_info(fi, full_path);
     vfs_mime_type_unref(old_mime_type); /* FIXME: is vfs_mime_type_unref needed ?*/
 }
 
+gboolean vfs_file_info_is_mime_pending(VFSFileInfo* fi)
+{
+    return !!(fi->flags & VFS_FILE_INFO_MIME_PENDING);
+}
+
+/* Sniff the content of a file whose type is pending, see vfs_file_info_get_at.
+ * Returns TRUE if the mime type changed. */
+gboolean vfs_file_info_load_mime_type(VFSFileInfo* fi, const char* full_path)
+{
+    if (!(fi->flags & VFS_FILE_INFO_MIME_PENDING))
+        return FALSE;
+
+    struct stat file_stat;
+    file_stat.st_mode = fi->mode;
+    file_stat.st_size = fi->size;
+    return vfs_file_info_set_sniffed_mime_type(
+        fi,
+        vfs_mime_type_get_from_file(full_path, fi->name, &file_stat));
+}
+
+/* Replace a pending mime type with one sniffed elsewhere, eg. in a worker thread.
+ * Takes ownership of mime_type.  Returns TRUE if the mime type changed. */
+gboolean vfs_file_info_set_sniffed_mime_type(VFSFileInfo* fi, VFSMimeType* mime_type)
+{
+    fi->flags &= ~VFS_FILE_INFO_MIME_PENDING;
+    VFSMimeType* old_mime_type = fi->mime_type;
+    fi->mime_type = mime_type;
+    if (old_mime_type)
+        vfs_mime_type_unref(old_mime_type);
+    return mime_type != old_mime_type;
+}
+
 const char* vfs_file_info_get_mime_type_desc(VFSFileInfo* fi)
 {
     return vfs_mime_type_get_description(fi->mime_type);
@@ -250,7 +491,7 @@ GdkPixbuf* vfs_file_info_get_big_icon(VFSFileInfo* fi)
     /* get special icons for special files, especially for
        some desktop icons */
 
-    if (G_UNLIKELY(fi->flags != VFS_FILE_INFO_NONE))
+    if (G_UNLIKELY((fi->flags & ~VFS_FILE_INFO_MIME_PENDING) != VFS_FILE_INFO_NONE))
     {
         int w;
         int h;
@@ -312,60 +553,97 @@ GdkPixbuf* vfs_file_info_get_small_thumbnail(VFSFileInfo* fi)
     return fi->small_thumbnail ? g_object_ref(fi->small_thumbnail) : NULL;
 }
 
-const char* vfs_file_info_get_disp_owner(VFSFileInfo* fi)
+/* User and group names may come from LDAP, SSSD... through nsswitch, so
+ * look each id up once in a while only.  Names are interned strings and
+ * stay valid after their entry expires. */
+#define OWNER_NAME_TTL (5 * 60 * G_USEC_PER_SEC)
+
+typedef struct
 {
+    const char* name;
+    gint64 expires;
+} OwnerName;
 
-    /* FIXME: user names should be cached */
-    if (!fi->disp_owner)
+G_LOCK_DEFINE_STATIC(owner_names);
+static GHashTable* user_names = NULL;  /* uid => OwnerName */
+static GHashTable* group_names = NULL; /* gid => OwnerName */
+
+static void owner_name_free(OwnerName* owner)
+{
+    g_slice_free(OwnerName, owner);
+}
+
+/* owner_names must be locked */
+static const char* get_owner_name(GHashTable** names, guint id, gboolean is_group, gint64 now)
+{
+    if (G_UNLIKELY(!*names))
+        *names = g_hash_table_new_full(g_direct_hash, NULL, NULL, (GDestroyNotify)owner_name_free);
+
+    OwnerName* owner = (OwnerName*)g_hash_table_lookup(*names, GUINT_TO_POINTER(id));
+    if (G_LIKELY(owner && owner->expires > now))
+        return owner->name;
+
+    const char* name = NULL;
+    if (is_group)
     {
-        char* user_name;
-        struct passwd* puser = getpwuid(fi->uid);
+        struct group* pgroup = getgrgid(id);
+        if (pgroup && pgroup->gr_name && *pgroup->gr_name)
+            name = g_intern_string(pgroup->gr_name);
+    }
+    else
+    {
+        struct passwd* puser = getpwuid(id);
         if (puser && puser->pw_name && *puser->pw_name)
-            user_name = puser->pw_name;
-        else
-        {
-            char uid_str_buf[32];
-            g_snprintf(uid_str_buf, sizeof(uid_str_buf), "%d", fi->uid);
-            user_name = uid_str_buf;
-        }
+            name = g_intern_string(puser->pw_name);
+    }
+    if (!name)
+    {
+        char id_str_buf[32];
+        g_snprintf(id_str_buf, sizeof(id_str_buf), "%u", id);
+        name = g_intern_string(id_str_buf);
+    }
 
-        char* group_name;
-        struct group* pgroup = getgrgid(fi->gid);
-        if (pgroup && pgroup->gr_name && *pgroup->gr_name)
-            group_name = pgroup->gr_name;
-        else
-        {
-            char gid_str_buf[32];
-            g_snprintf(gid_str_buf, sizeof(gid_str_buf), "%d", fi->gid);
-            group_name = gid_str_buf;
-        }
-        fi->disp_owner = g_strdup_printf("%s:%s", user_name, group_name);
+    if (!owner)
+    {
+        owner = g_slice_new(OwnerName);
+        g_hash_table_insert(*names, GUINT_TO_POINTER(id), owner);
     }
-    return fi->disp_owner;
+    owner->name = name;
+    owner->expires = now + OWNER_NAME_TTL;
+    return name;
 }
 
-const char* vfs_file_info_get_disp_mtime(VFSFileInfo* fi)
+const char* vfs_file_info_get_disp_owner(VFSFileInfo* fi)
 {
-    if (!fi->disp_mtime)
+    if (!fi->disp_owner)
     {
-        char buf[64];
-        strftime(buf,
-                 sizeof(buf),
-                 app_settings.date_format, //"%Y-%m-%d %H:%M",
-                 localtime(&fi->mtime));
-        fi->disp_mtime = g_strdup(buf);
+        gint64 now = g_get_monotonic_time();
+        G_LOCK(owner_names);
+        const char* user_name = get_owner_name(&user_names, fi->uid, FALSE, now);
+        const char* group_name = get_owner_name(&group_names, fi->gid, TRUE, now);
+        G_UNLOCK(owner_names);
+
+        char* owner = g_strconcat(user_name, ":", group_name, NULL);
+        fi->disp_owner = g_intern_string(owner);
+        g_free(owner);
     }
-    return fi->disp_mtime;
+    return fi->disp_owner;
 }
 
-time_t* vfs_file_info_get_mtime(VFSFileInfo* fi)
+/* Not kept in fi to save memory, buf should hold 64 bytes */
+void vfs_file_info_get_disp_mtime(VFSFileInfo* fi, char* buf)
 {
-    return &fi->mtime;
+    struct tm tm;
+    if (!strftime(buf,
+                  64,
+                  app_settings.date_format, //"%Y-%m-%d %H:%M",
+                  localtime_r(&fi->mtime, &tm)))
+        buf[0] = '\0';
 }
 
-time_t* vfs_file_info_get_atime(VFSFileInfo* fi)
+time_t* vfs_file_info_get_mtime(VFSFileInfo* fi)
 {
-    return &fi->atime;
+    return &fi->mtime;
 }
 
 static void get_file_perm_string(char* perm, mode_t mode)
@@ -728,34 +1006,38 @@ gboolean vfs_file_info_is_thumbnail_loaded(VFSFileInfo* fi, gboolean big)
     return (fi->small_thumbnail != NULL);
 }
 
-gboolean vfs_file_info_load_thumbnail(VFSFileInfo* fi, const char* full_path, gboolean big)
+/* Reads the thumbnail of a file without touching its VFSFileInfo, so that
+ * the thumbnail workers never see a file being renamed or updated. */
+GdkPixbuf* vfs_file_info_read_thumbnail(const char* full_path, time_t mtime, gboolean big)
 {
-    if (big)
-    {
-        if (fi->big_thumbnail)
-            return TRUE;
-    }
-    else
+    return vfs_thumbnail_load_for_file(full_path, big ? big_thumb_size : small_thumb_size, mtime);
+}
+
+/* Takes the thumbnail read by vfs_file_info_read_thumbnail, or falls back
+ * to the mime_type icon if there is none.  Main thread only. */
+void vfs_file_info_set_thumbnail(VFSFileInfo* fi, GdkPixbuf* thumbnail, gboolean big)
+{
+    GdkPixbuf** slot = big ? &fi->big_thumbnail : &fi->small_thumbnail;
+    if (*slot)
     {
-        if (fi->small_thumbnail)
-            return TRUE;
+        if (thumbnail)
+            g_object_unref(thumbnail);
+        return;
     }
-    GdkPixbuf* thumbnail = vfs_thumbnail_load_for_file(full_path, big ? big_thumb_size : small_thumb_size, fi->mtime);
     if (G_LIKELY(thumbnail))
-    {
-        if (big)
-            fi->big_thumbnail = thumbnail;
-        else
-            fi->small_thumbnail = thumbnail;
-    }
-    else /* fallback to mime_type icon */
-    {
-        if (big)
-            fi->big_thumbnail = vfs_file_info_get_big_icon(fi);
-        else
-            fi->small_thumbnail = vfs_file_info_get_small_icon(fi);
-    }
-    return (thumbnail != NULL);
+        *slot = thumbnail;
+    else
+        *slot = big ? vfs_file_info_get_big_icon(fi) : vfs_file_info_get_small_icon(fi);
+}
+
+gboolean vfs_file_info_load_thumbnail(VFSFileInfo* fi, const char* full_path, gboolean big)
+{
+    if (vfs_file_info_is_thumbnail_loaded(fi, big))
+        return TRUE;
+    GdkPixbuf* thumbnail = vfs_file_info_read_thumbnail(full_path, fi->mtime, big);
+    gboolean loaded = thumbnail != NULL;
+    vfs_file_info_set_thumbnail(fi, thumbnail, big);
+    return loaded;
 }
 
 void vfs_file_info_set_thumbnail_size(int big, int small)
@@ -764,6 +1046,65 @@ void vfs_file_info_set_thumbnail_size(int big, int small)
     small_thumb_size = small;
 }
 
+/* Parsed desktop entries, so that reloading the icons of a listing or
+ * updating a file doesn't parse every .desktop file again.  Entries are
+ * parsed by the dir loading thread, hence the lock. */
+#define DESKTOP_CACHE_MAX_ENTRIES 4096
+
+typedef struct
+{
+    VFSAppDesktop* desktop;
+    time_t mtime;
+    off_t size;
+} DesktopCacheEntry;
+
+G_LOCK_DEFINE_STATIC(desktop_cache);
+static GHashTable* desktop_cache = NULL; /* path => DesktopCacheEntry */
+
+static void desktop_cache_entry_free(DesktopCacheEntry* entry)
+{
+    vfs_app_desktop_unref(entry->desktop);
+    g_slice_free(DesktopCacheEntry, entry);
+}
+
+/* Returns a new ref on the parsed desktop entry of fi */
+static VFSAppDesktop* get_cached_desktop(VFSFileInfo* fi, const char* file_path)
+{
+    VFSAppDesktop* desktop = NULL;
+
+    G_LOCK(desktop_cache);
+    if (G_UNLIKELY(!desktop_cache))
+        desktop_cache = g_hash_table_new_full(g_str_hash,
+                                              g_str_equal,
+                                              g_free,
+                                              (GDestroyNotify)desktop_cache_entry_free);
+    DesktopCacheEntry* entry = (DesktopCacheEntry*)g_hash_table_lookup(desktop_cache, file_path);
+    if (entry && entry->mtime == fi->mtime && entry->size == fi->size)
+    {
+        desktop = entry->desktop;
+        vfs_app_desktop_ref(desktop);
+    }
+    G_UNLOCK(desktop_cache);
+    if (desktop)
+        return desktop;
+
+    /* parse outside of the lock, a racing thread only parses it twice */
+    desktop = vfs_app_desktop_new(file_path);
+
+    entry = g_slice_new(DesktopCacheEntry);
+    entry->desktop = desktop;
+    entry->mtime = fi->mtime;
+    entry->size = fi->size;
+    vfs_app_desktop_ref(desktop);
+
+    G_LOCK(desktop_cache);
+    if (g_hash_table_size(desktop_cache) >= DESKTOP_CACHE_MAX_ENTRIES)
+        g_hash_table_remove_all(desktop_cache);
+    g_hash_table_replace(desktop_cache, g_strdup(file_path), entry);
+    G_UNLOCK(desktop_cache);
+    return desktop;
+}
+
 void vfs_file_info_load_special_info(VFSFileInfo* fi, const char* file_path)
 {
     /*if ( G_LIKELY(fi->type) && G_UNLIKELY(fi->type->name, "application/x-desktop") ) */
@@ -774,7 +1115,7 @@ void vfs_file_info_load_special_info(VFSFileInfo* fi, const char* file_path)
         char* file_dir = g_path_get_dirname(file_path);
 
         fi->flags |= VFS_FILE_INFO_DESKTOP_ENTRY;
-        VFSAppDesktop* desktop = vfs_app_desktop_new(file_path);
+        VFSAppDesktop* desktop = get_cached_desktop(fi, file_path);
 
         // MOD  display real filenames of .desktop files not in desktop folder
         if (desktop_dir && !strcmp(file_dir, desktop_dir))
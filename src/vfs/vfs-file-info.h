@@ -39,38 +39,38 @@ typedef enum
     VFS_FILE_INFO_DESKTOP_ENTRY = (1 << 2),
     VFS_FILE_INFO_MOUNT_POINT = (1 << 3),
     VFS_FILE_INFO_REMOTE = (1 << 4),
-    VFS_FILE_INFO_VIRTUAL = (1 << 5)
+    VFS_FILE_INFO_VIRTUAL = (1 << 5),
+    VFS_FILE_INFO_MIME_PENDING = (1 << 6) /* mime_type is a guess, content not sniffed yet */
 } VFSFileInfoFlag; /* For future use, not all supported now */
 
 typedef struct _VFSFileInfo VFSFileInfo;
+typedef struct _VFSFileInfoArena VFSFileInfoArena;
 
+/* One is kept for every file of every loaded dir, so keep it small */
 struct _VFSFileInfo
 {
     /* struct stat file_stat; */
-    /* Only use some members of struct stat to reduce memory usage */
+    /* Only use some members of struct stat to reduce memory usage.
+     * Rarely shown ones like atime and blocks are read by lstat when needed. */
     mode_t mode;
-    dev_t dev;
     uid_t uid;
     gid_t gid;
+    VFSFileInfoFlag flags; /* if it's a special file */
     off_t size;
     time_t mtime;
-    time_t atime;
-    long blksize; // sfm was long then blksize_t but blksize_t not defined for squeeze gcc
-    blkcnt_t blocks;
+    guint32 mtime_nsec; /* so that changes within a second are seen */
 
     char* name;                 /* real name on file system */
     char* disp_name;            /* displayed name (in UTF-8) */
-    char* collate_key;          // sfm sort key
+    VFSFileInfoArena* arena;    /* holds name if not NULL */
+    char* collate_key;          // sfm sort key, see vfs_file_info_get_collate_key
     char* collate_icase_key;    // sfm case folded sort key
-    char* disp_size;            /* displayed human-readable file size */
-    char* disp_owner;           /* displayed owner:group pair */
-    char* disp_mtime;           /* displayed last modification time */
-    char disp_perm[12];         /* displayed permission in string form */
+    const char* disp_owner;     /* displayed owner:group pair, interned */
     VFSMimeType* mime_type;     /* mime type related information */
     GdkPixbuf* big_thumbnail;   /* thumbnail of the file */
     GdkPixbuf* small_thumbnail; /* thumbnail of the file */
+    char disp_perm[12];         /* displayed permission in string form */
 
-    VFSFileInfoFlag flags; /* if it's a special file */
     /*<private>*/
     int n_ref;
 };
@@ -81,7 +81,24 @@ VFSFileInfo* vfs_file_info_new();
 VFSFileInfo* vfs_file_info_ref(VFSFileInfo* fi);
 void vfs_file_info_unref(VFSFileInfo* fi);
 
+VFSFileInfoArena* vfs_file_info_arena_new();
+void vfs_file_info_arena_unref(VFSFileInfoArena* arena);
+void vfs_file_info_detach_arena(VFSFileInfo* fi);
+
 gboolean vfs_file_info_get(VFSFileInfo* fi, const char* file_path, const char* base_name);
+/* Same as vfs_file_info_get, but stats base_name relative to an open directory fd.
+ * The content of files is not sniffed: if the name doesn't tell the mime type,
+ * it is left unknown and flagged VFS_FILE_INFO_MIME_PENDING until
+ * vfs_file_info_load_mime_type is called.
+ * If arena is not NULL, the name is stored in it. */
+gboolean vfs_file_info_get_at(VFSFileInfo* fi, int dir_fd, const char* dir_path, const char* base_name,
+                              VFSFileInfoArena* arena);
+/* Fill fi from a saved listing instead of the file system, see vfs-list-cache.h */
+void vfs_file_info_get_cached(VFSFileInfo* fi, const char* base_name, struct stat* file_stat, const char* mime_type,
+                              gboolean mime_pending, VFSFileInfoArena* arena);
+
+gboolean vfs_file_info_rename(VFSFileInfo* fi, const char* full_path, const char* new_name);
+void vfs_file_info_update(VFSFileInfo* fi, VFSFileInfo* newer);
 
 const char* vfs_file_info_get_name(VFSFileInfo* fi);
 const char* vfs_file_info_get_disp_name(VFSFileInfo* fi);
@@ -89,27 +106,32 @@ const char* vfs_file_info_get_disp_name(VFSFileInfo* fi);
 void vfs_file_info_set_name(VFSFileInfo* fi, const char* name);
 void vfs_file_info_set_disp_name(VFSFileInfo* fi, const char* name);
 
-off_t vfs_file_info_get_size(VFSFileInfo* fi);
-const char* vfs_file_info_get_disp_size(VFSFileInfo* fi);
+const char* vfs_file_info_get_collate_key(VFSFileInfo* fi, gboolean icase);
+void vfs_file_info_unload_collate_keys(VFSFileInfo* fi);
 
-off_t vfs_file_info_get_blocks(VFSFileInfo* fi);
+off_t vfs_file_info_get_size(VFSFileInfo* fi);
+void vfs_file_info_get_disp_size(VFSFileInfo* fi, char* buf);
 
 mode_t vfs_file_info_get_mode(VFSFileInfo* fi);
 
 VFSMimeType* vfs_file_info_get_mime_type(VFSFileInfo* fi);
 void vfs_file_info_reload_mime_type(VFSFileInfo* fi, const char* full_path);
+gboolean vfs_file_info_is_mime_pending(VFSFileInfo* fi);
+gboolean vfs_file_info_load_mime_type(VFSFileInfo* fi, const char* full_path);
+gboolean vfs_file_info_set_sniffed_mime_type(VFSFileInfo* fi, VFSMimeType* mime_type);
 
 const char* vfs_file_info_get_mime_type_desc(VFSFileInfo* fi);
 
 const char* vfs_file_info_get_disp_owner(VFSFileInfo* fi);
-const char* vfs_file_info_get_disp_mtime(VFSFileInfo* fi);
+void vfs_file_info_get_disp_mtime(VFSFileInfo* fi, char* buf);
 const char* vfs_file_info_get_disp_perm(VFSFileInfo* fi);
 
 time_t* vfs_file_info_get_mtime(VFSFileInfo* fi);
-time_t* vfs_file_info_get_atime(VFSFileInfo* fi);
 
 void vfs_file_info_set_thumbnail_size(int big, int small);
 gboolean vfs_file_info_load_thumbnail(VFSFileInfo* fi, const char* full_path, gboolean big);
+GdkPixbuf* vfs_file_info_read_thumbnail(const char* full_path, time_t mtime, gboolean big);
+void vfs_file_info_set_thumbnail(VFSFileInfo* fi, GdkPixbuf* thumbnail, gboolean big);
 gboolean vfs_file_info_is_thumbnail_loaded(VFSFileInfo* fi, gboolean big);
 
 GdkPixbuf* vfs_file_info_get_big_icon(VFSFileInfo* fi);
@@ -39,10 +39,29 @@ typedef struct
 } VFSFileMonitorCallbackEntry;
 
 static GHashTable* monitor_hash = NULL;
+static GHashTable* wd_hash = NULL; /* inotify watch descriptor => VFSFileMonitor */
 static GIOChannel* inotify_io_channel = NULL;
 static uint inotify_io_watch = 0;
 static int inotify_fd = -1;
 
+/* inotify watches are limited per user and shared with every other
+ * program, so only a part of max_user_watches is used here.  See
+ * vfs-dir.c for what is given up when they run short. */
+#define WATCH_SHARE         4 /* use at most a quarter of the limit */
+#define DEFAULT_MAX_WATCHES 8192
+
+static uint watch_budget = DEFAULT_MAX_WATCHES / WATCH_SHARE;
+
+/* A rename inside a monitored dir is a MOVED_FROM directly followed by a
+ * MOVED_TO with the same cookie.  A MOVED_FROM which ends a read is held
+ * a moment, in case its MOVED_TO comes with the next read. */
+#define HELD_MOVE_TIMEOUT 10 /* ms */
+
+static char* held_move_name = NULL;
+static int held_move_wd = -1;
+static guint32 held_move_cookie = 0;
+static uint held_move_timeout = 0;
+
 /* event handler of all inotify events */
 static gboolean on_inotify_event(GIOChannel* channel, GIOCondition cond, gpointer user_data);
 
@@ -79,24 +98,63 @@ static void disconnect_from_inotify()
     }
 }
 
+static void drop_held_move()
+{
+    if (held_move_timeout)
+    {
+        g_source_remove(held_move_timeout);
+        held_move_timeout = 0;
+    }
+    g_free(held_move_name);
+    held_move_name = NULL;
+}
+
 /* final cleanup */
 void vfs_file_monitor_clean()
 {
+    drop_held_move();
     disconnect_from_inotify();
     if (monitor_hash)
     {
         g_hash_table_destroy(monitor_hash);
         monitor_hash = NULL;
     }
+    if (wd_hash)
+    {
+        g_hash_table_destroy(wd_hash);
+        wd_hash = NULL;
+    }
 }
 
 /*
  * Init monitor:
  * connect to inotify
  */
+static void read_watch_budget()
+{
+    char* contents;
+    uint max_watches = 0;
+    if (g_file_get_contents("/proc/sys/fs/inotify/max_user_watches", &contents, NULL, NULL))
+    {
+        max_watches = strtoul(contents, NULL, 10);
+        g_free(contents);
+    }
+    if (!max_watches)
+        max_watches = DEFAULT_MAX_WATCHES;
+    watch_budget = max_watches / WATCH_SHARE;
+}
+
+void vfs_file_monitor_get_watch_usage(uint* used, uint* budget)
+{
+    *used = monitor_hash ? g_hash_table_size(monitor_hash) : 0;
+    *budget = watch_budget;
+}
+
 gboolean vfs_file_monitor_init()
 {
     monitor_hash = g_hash_table_new(g_str_hash, g_str_equal);
+    wd_hash = g_hash_table_new(g_direct_hash, g_direct_equal);
+    read_watch_budget();
     if (!connect_to_inotify())
         return FALSE;
     return TRUE;
@@ -172,9 +230,18 @@ VFSFileMonitor* vfs_file_monitor_add(char* path, gboolean is_dir, VFSFileMonitor
                 msg = "??? Unknown error.";
                 break;
             }
+            gboolean no_space = errno == ENOSPC;
             g_warning("Failed to add watch on '%s' ('%s'): inotify_add_watch errno %d %s", real_path, path, errno, msg);
+            g_hash_table_remove(monitor_hash, monitor->path);
+            g_free(monitor->path);
+            g_array_free(monitor->callbacks, TRUE);
+            g_slice_free(VFSFileMonitor, monitor);
+            /* other programs took the rest, use no more than we have */
+            if (no_space)
+                watch_budget = MIN(watch_budget, g_hash_table_size(monitor_hash));
             return NULL;
         }
+        g_hash_table_insert(wd_hash, GINT_TO_POINTER(monitor->wd), monitor);
         // g_printf("vfs_file_monitor_add  %s (%s) %d\n", real_path, path, monitor->wd );
     }
 
@@ -193,6 +260,14 @@ VFSFileMonitor* vfs_file_monitor_add(char* path, gboolean is_dir, VFSFileMonitor
     return monitor;
 }
 
+void vfs_file_monitor_add_callback(VFSFileMonitor* fm, VFSFileMonitorCallback cb, gpointer user_data)
+{
+    VFSFileMonitorCallbackEntry cb_ent;
+    cb_ent.callback = cb;
+    cb_ent.user_data = user_data;
+    fm->callbacks = g_array_append_val(fm->callbacks, cb_ent);
+}
+
 void vfs_file_monitor_remove(VFSFileMonitor* fm, VFSFileMonitorCallback cb, gpointer user_data)
 {
     // g_printf( "vfs_file_monitor_remove\n" );
@@ -215,6 +290,9 @@ void vfs_file_monitor_remove(VFSFileMonitor* fm, VFSFileMonitorCallback cb, gpoi
         // g_printf( "vfs_file_monitor_remove  %d\n", fm->wd );
         inotify_rm_watch(inotify_fd, fm->wd);
 
+        /* another path may share the same wd (same inode), keep its entry */
+        if (g_hash_table_lookup(wd_hash, GINT_TO_POINTER(fm->wd)) == fm)
+            g_hash_table_remove(wd_hash, GINT_TO_POINTER(fm->wd));
         g_hash_table_remove(monitor_hash, fm->path);
         g_free(fm->path);
         g_array_free(fm->callbacks, TRUE);
@@ -242,16 +320,10 @@ static void reconnect_inotify(gpointer key, gpointer value, gpointer user_data)
             g_warning("Failed to add monitor on '%s': %s", path, g_strerror(errno));
             return;
         }
+        g_hash_table_insert(wd_hash, GINT_TO_POINTER(monitor->wd), monitor);
     }
 }
 
-static gboolean find_monitor(gpointer key, gpointer value, gpointer user_data)
-{
-    int wd = GPOINTER_TO_INT(user_data);
-    VFSFileMonitor* monitor = (VFSFileMonitor*)value;
-    return (monitor->wd == wd);
-}
-
 static VFSFileMonitorEvent translate_inotify_event(int inotify_mask)
 {
     if (inotify_mask & (IN_CREATE | IN_MOVED_TO))
@@ -283,6 +355,60 @@ static void dispatch_event(VFSFileMonitor* monitor, VFSFileMonitorEvent evt, con
     }
 }
 
+static void dispatch_rename(VFSFileMonitor* monitor, const char* old_name, const char* new_name)
+{
+    /* callbacks may remove the monitor */
+    g_atomic_int_inc(&monitor->n_ref);
+    monitor->renamed_from = old_name;
+    dispatch_event(monitor, VFS_FILE_MONITOR_RENAME, new_name);
+    monitor->renamed_from = NULL;
+    vfs_file_monitor_remove(monitor, NULL, NULL);
+}
+
+/* No MOVED_TO came, the file was moved out of the dir */
+static void flush_held_move()
+{
+    if (!held_move_name)
+        return;
+    char* name = held_move_name;
+    held_move_name = NULL;
+    drop_held_move();
+
+    VFSFileMonitor* monitor = (VFSFileMonitor*)g_hash_table_lookup(wd_hash, GINT_TO_POINTER(held_move_wd));
+    if (monitor)
+        dispatch_event(monitor, VFS_FILE_MONITOR_DELETE, name);
+    g_free(name);
+}
+
+static gboolean on_held_move_timeout(gpointer user_data)
+{
+    held_move_timeout = 0;
+    flush_held_move();
+    return FALSE;
+}
+
+static gboolean is_move_pair(struct inotify_event* from, struct inotify_event* to)
+{
+    return (to->mask & IN_MOVED_TO) && to->cookie == from->cookie && to->wd == from->wd && to->len > 0;
+}
+
+/* The kernel queue overflowed, the lost events may be of any monitor */
+static void dispatch_overflow()
+{
+    GList* monitors = g_hash_table_get_values(monitor_hash);
+    GList* l;
+    /* callbacks may remove monitors */
+    for (l = monitors; l; l = l->next)
+        g_atomic_int_inc(&((VFSFileMonitor*)l->data)->n_ref);
+    for (l = monitors; l; l = l->next)
+    {
+        VFSFileMonitor* monitor = (VFSFileMonitor*)l->data;
+        dispatch_event(monitor, VFS_FILE_MONITOR_OVERFLOW, monitor->path);
+        vfs_file_monitor_remove(monitor, NULL, NULL);
+    }
+    g_list_free(monitors);
+}
+
 /* event handler of all inotify events */
 static gboolean on_inotify_event(GIOChannel* channel, GIOCondition cond, gpointer user_data)
 {
@@ -294,6 +420,7 @@ static gboolean on_inotify_event(GIOChannel* channel, GIOCondition cond, gpointe
 
     if (cond & (G_IO_HUP | G_IO_ERR))
     {
+        flush_held_move();
         disconnect_from_inotify();
         if (g_hash_table_size(monitor_hash) > 0)
         {
@@ -302,6 +429,8 @@ static gboolean on_inotify_event(GIOChannel* channel, GIOCondition cond, gpointe
               This may be caused by crash of inotify server.
               So we have to reconnect to inotify server.
             */
+            /* watch descriptors of the old inotify instance are invalid now */
+            g_hash_table_remove_all(wd_hash);
             if (connect_to_inotify())
                 g_hash_table_foreach(monitor_hash, (GHFunc)reconnect_inotify, NULL);
         }
@@ -326,13 +455,36 @@ static gboolean on_inotify_event(GIOChannel* channel, GIOCondition cond, gpointe
         /* goto error_cancel; */
         return FALSE;
     }
+    gboolean overflow = FALSE;
     i = 0;
     while (i < len)
     {
         struct inotify_event* ievent = (struct inotify_event*)&buf[i];
+        int next = i + sizeof(struct inotify_event) + ievent->len;
+        if (G_UNLIKELY(ievent->mask & IN_Q_OVERFLOW))
+            overflow = TRUE;
+
+        if (G_UNLIKELY(held_move_name))
+        {
+            struct inotify_event held;
+            held.wd = held_move_wd;
+            held.cookie = held_move_cookie;
+            monitor = (VFSFileMonitor*)g_hash_table_lookup(wd_hash, GINT_TO_POINTER(held_move_wd));
+            if (monitor && is_move_pair(&held, ievent))
+            {
+                char* name = held_move_name;
+                held_move_name = NULL;
+                drop_held_move();
+                dispatch_rename(monitor, name, ievent->name);
+                g_free(name);
+                i = next;
+                continue;
+            }
+            flush_held_move();
+        }
         /* FIXME: 2 different paths can have the same wd because of link
          *        This was fixed in spacefm 0.8.7 ?? */
-        monitor = (VFSFileMonitor*)g_hash_table_find(monitor_hash, find_monitor, GINT_TO_POINTER(ievent->wd));
+        monitor = (VFSFileMonitor*)g_hash_table_lookup(wd_hash, GINT_TO_POINTER(ievent->wd));
         if (G_LIKELY(monitor))
         {
             const char* file_name;
@@ -356,9 +508,30 @@ static gboolean on_inotify_event(GIOChannel* channel, GIOCondition cond, gpointe
                 g_printf("inotify-event %s: %s///%s\n", desc, monitor->path, file_name);
             //g_debug("inotify (%d) :%s", ievent->mask, file_name);
             */
+            if ((ievent->mask & IN_MOVED_FROM) && ievent->len > 0)
+            {
+                if (next >= len)
+                {
+                    held_move_name = g_strdup(ievent->name);
+                    held_move_wd = ievent->wd;
+                    held_move_cookie = ievent->cookie;
+                    held_move_timeout = g_timeout_add(HELD_MOVE_TIMEOUT, on_held_move_timeout, NULL);
+                    i = next;
+                    continue;
+                }
+                struct inotify_event* to_event = (struct inotify_event*)&buf[next];
+                if (is_move_pair(ievent, to_event))
+                {
+                    dispatch_rename(monitor, ievent->name, to_event->name);
+                    i = next + sizeof(struct inotify_event) + to_event->len;
+                    continue;
+                }
+            }
             dispatch_event(monitor, translate_inotify_event(ievent->mask), file_name);
         }
-        i += sizeof(struct inotify_event) + ievent->len;
+        i = next;
     }
+    if (G_UNLIKELY(overflow))
+        dispatch_overflow();
     return TRUE;
 }
@@ -28,7 +28,9 @@ typedef enum
 {
     VFS_FILE_MONITOR_CREATE,
     VFS_FILE_MONITOR_DELETE,
-    VFS_FILE_MONITOR_CHANGE
+    VFS_FILE_MONITOR_CHANGE,
+    VFS_FILE_MONITOR_OVERFLOW, /* events were lost, file_name is the monitored path */
+    VFS_FILE_MONITOR_RENAME    /* file_name is the new name, fm->renamed_from the old one */
 } VFSFileMonitorEvent;
 
 typedef struct _VFSFileMonitor VFSFileMonitor;
@@ -36,6 +38,7 @@ typedef struct _VFSFileMonitor VFSFileMonitor;
 struct _VFSFileMonitor
 {
     char* path;
+    const char* renamed_from; /* only set while VFS_FILE_MONITOR_RENAME is dispatched */
     /*<private>*/
     int n_ref;
     int wd;
@@ -86,11 +89,22 @@ VFSFileMonitor* vfs_file_monitor_add(char* path, gboolean is_dir, VFSFileMonitor
  */
 #define vfs_file_monitor_add_dir(path, cb, user_data) vfs_file_monitor_add(path, TRUE, cb, user_data)
 
+/*
+ * Install a callback on a monitor added without one.
+ * The monitor is not referenced again.
+ */
+void vfs_file_monitor_add_callback(VFSFileMonitor* fm, VFSFileMonitorCallback cb, gpointer user_data);
+
 /*
  * Remove previously installed monitor.
  */
 void vfs_file_monitor_remove(VFSFileMonitor* fm, VFSFileMonitorCallback cb, gpointer user_data);
 
+/*
+ * Number of inotify watches in use, and how many may be used.
+ */
+void vfs_file_monitor_get_watch_usage(uint* used, uint* budget);
+
 /*
  * Clearn up and shutdown file alteration monitor.
  */
@@ -20,6 +20,10 @@
 #include <utime.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h> /* for SYS_copy_file_range */
+#include <linux/fs.h>    /* for FICLONE */
 
 #include <glib.h>
 #include <glib/gi18n.h>
@@ -71,12 +75,12 @@ static void vfs_file_task_init(VFSFileTask* task)
 
 void vfs_file_task_lock(VFSFileTask* task)
 {
-    g_mutex_lock(task->mutex);
+    g_mutex_lock(&task->mutex);
 }
 
 void vfs_file_task_unlock(VFSFileTask* task)
 {
-    g_mutex_unlock(task->mutex);
+    g_mutex_unlock(&task->mutex);
 }
 
 void vfs_file_task_clear(VFSFileTask* task)
@@ -122,7 +126,7 @@ static gboolean should_abort(VFSFileTask* task)
         vfs_file_task_lock(task);
         g_timer_stop(task->timer);
         task->pause_cond = g_cond_new();
-        g_cond_wait(task->pause_cond, task->mutex);
+        g_cond_wait(task->pause_cond, &task->mutex);
         // resume
         g_cond_free(task->pause_cond);
         task->pause_cond = NULL;
@@ -324,13 +328,123 @@ void update_file_display(const char* path)
     GDK_THREADS_LEAVE();
 }
 
+/* Bytes copied per copy_file_range/sendfile call, so progress and abort stay responsive */
+#define COPY_CHUNK_SIZE (8 * 1024 * 1024)
+/* Buffer size of the read/write fallback */
+#define COPY_BUFFER_SIZE (1024 * 1024)
+
+static void add_copy_progress(VFSFileTask* task, off_t size)
+{
+    vfs_file_task_lock(task);
+    task->progress += size;
+    vfs_file_task_unlock(task);
+}
+
+/*
+ * Copy rfd to wfd in the kernel with copy_file_range, or sendfile if use_sendfile.
+ * Returns 1 on success, 0 on abort, -1 if the method could not copy all of
+ * size bytes.  Both file offsets are where it stopped, so the next method
+ * goes on from there, and the read/write copy reports any error.
+ */
+static int copy_file_data_kernel(VFSFileTask* task, int rfd, int wfd, off_t size, gboolean use_sendfile)
+{
+    off_t copied = 0;
+    ssize_t n;
+
+    for (;;)
+    {
+        if (should_abort(task))
+            return 0;
+
+        if (use_sendfile)
+            n = sendfile(wfd, rfd, NULL, COPY_CHUNK_SIZE);
+        else
+            n = syscall(SYS_copy_file_range, rfd, NULL, wfd, NULL, COPY_CHUNK_SIZE, 0);
+
+        if (n > 0)
+        {
+            copied += n;
+            add_copy_progress(task, n);
+        }
+        else if (n == 0)
+        {
+            /* files of procfs, sysfs or some fuse fs report a size of 0,
+             * and some kernels copy nothing from them */
+            return copied == 0 || copied < size ? -1 : 1;
+        }
+        else if (errno == EINTR)
+            continue;
+        else
+            return -1;
+    }
+}
+
+/* Copy the content of rfd to wfd, trying the cheapest method first:
+ * a reflink (FICLONE), copy_file_range, sendfile, then read/write */
+static gboolean copy_file_data(VFSFileTask* task, int rfd, int wfd, off_t size, const char* src_file,
+                               const char* dest_file)
+{
+    int ret;
+
+#ifdef FICLONE
+    if (size > 0 && ioctl(wfd, FICLONE, rfd) == 0)
+    {
+        add_copy_progress(task, size);
+        return TRUE;
+    }
+#endif
+
+    if ((ret = copy_file_data_kernel(task, rfd, wfd, size, FALSE)) != -1)
+        return ret;
+    if ((ret = copy_file_data_kernel(task, rfd, wfd, size, TRUE)) != -1)
+        return ret;
+
+    char* buffer = g_malloc(COPY_BUFFER_SIZE);
+    ssize_t rsize;
+    gboolean copy_fail = FALSE;
+    while (!copy_fail && (rsize = read(rfd, buffer, COPY_BUFFER_SIZE)) != 0)
+    {
+        if (rsize < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            vfs_file_task_error(task, errno, _("Accessing"), src_file);
+            copy_fail = TRUE;
+            break;
+        }
+        if (should_abort(task))
+        {
+            copy_fail = TRUE;
+            break;
+        }
+
+        ssize_t written = 0;
+        while (written < rsize)
+        {
+            ssize_t wsize = write(wfd, buffer + written, rsize - written);
+            if (wsize > 0)
+                written += wsize;
+            else if (wsize < 0 && errno == EINTR)
+                continue;
+            else
+            {
+                vfs_file_task_error(task, errno, _("Writing"), dest_file);
+                copy_fail = TRUE;
+                break;
+            }
+        }
+        add_copy_progress(task, written);
+    }
+    g_free(buffer);
+    return !copy_fail;
+}
+
 static gboolean vfs_file_task_do_copy(VFSFileTask* task, const char* src_file, const char* dest_file)
 {
     struct stat file_stat;
     char buffer[4096];
     int rfd;
     int wfd;
-    ssize_t rsize;
     char* new_dest_file = NULL;
     gboolean dest_exists;
     gboolean copy_fail = FALSE;
@@ -524,27 +638,8 @@ static gboolean vfs_file_task_do_copy(VFSFileTask* task, const char* src_file, c
                 // if ( task->avoid_changes )
                 //    emit_created( dest_file );
                 struct utimbuf times;
-                while ((rsize = read(rfd, buffer, sizeof(buffer))) > 0)
-                {
-                    if (should_abort(task))
-                    {
-                        copy_fail = TRUE;
-                        break;
-                    }
-
-                    if (write(wfd, buffer, rsize) > 0)
-                    {
-                        vfs_file_task_lock(task);
-                        task->progress += rsize;
-                        vfs_file_task_unlock(task);
-                    }
-                    else
-                    {
-                        vfs_file_task_error(task, errno, _("Writing"), dest_file);
-                        copy_fail = TRUE;
-                        break;
-                    }
-                }
+                if (!copy_file_data(task, rfd, wfd, file_stat.st_size, src_file, dest_file))
+                    copy_fail = TRUE;
                 close(wfd);
                 if (copy_fail)
                 {
@@ -1269,7 +1364,8 @@ static void vfs_file_task_exec(char* src_file, VFSFileTask* task)
     char* sum_script = NULL;
     GtkWidget* parent = NULL;
     int i;
-    char buf[PATH_MAX + 1];
+    char terminal_path[PATH_MAX + 1];
+    GString* buf = NULL; /* the script, freed on error */
 
     // g_printf("vfs_file_task_exec\n");
     // task->exec_keep_tmp = TRUE;
@@ -1355,12 +1451,12 @@ static void vfs_file_task_exec(char* src_file, VFSFileTask* task)
             goto _exit_with_error_lean;
         }
         // resolve x-terminal-emulator link (may be recursive link)
-        else if (strstr(terminal, "x-terminal-emulator") && realpath(terminal, buf) != NULL)
+        else if (strstr(terminal, "x-terminal-emulator") && realpath(terminal, terminal_path) != NULL)
         {
             g_free(terminal);
             g_free(terminalv[0]);
-            terminal = g_strdup(buf);
-            terminalv[0] = g_strdup(buf);
+            terminal = g_strdup(terminal_path);
+            terminalv[0] = g_strdup(terminal_path);
         }
     }
 
@@ -1378,7 +1474,7 @@ static void vfs_file_task_exec(char* src_file, VFSFileTask* task)
         } while (g_file_test(task->exec_script, G_FILE_TEST_EXISTS));
 
         // open buffer
-        GString* buf = g_string_sized_new(524288); // 500K
+        buf = g_string_sized_new(524288); // 500K
 
         // build - header
         g_string_append_printf(buf, "#!%s\n%s\n#tmp exec script\n", BASHPATH, SHELL_SETTINGS);
@@ -1998,7 +2094,7 @@ void vfs_file_task_run(VFSFileTask* task)
         }
         else
             task->avoid_changes = vfs_volume_dir_avoid_changes(task->dest_dir);
-        task->thread = g_thread_new("task_run", vfs_file_task_thread, task);
+        task->thread = g_thread_new("task_run", (GThreadFunc)vfs_file_task_thread, task);
     }
     else
     {
@@ -137,7 +137,7 @@ struct _VFSFileTask
     VFSFileTaskStateCallback state_cb;
     gpointer state_cb_data;
 
-    GMutex* mutex;
+    GMutex mutex;
 
     // sfm write directly to gtk buffer for speed
     GtkTextBuffer* add_log_buf;
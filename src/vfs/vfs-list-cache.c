@@ -0,0 +1,230 @@
+/*
+ *  C Implementation: vfs-list-cache
+ *
+ * Description: On-disk cache of directory listings
+ *
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include "vfs-list-cache.h"
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+/* A saved listing is a header, the path of the dir, then for every file
+ * a record followed by its name and mime type, both nul terminated.
+ * Records are copied in and out since they are not aligned. */
+#define VFS_LIST_CACHE_MAGIC "SFMLC03"
+
+/* All saved listings together, the least recently used are removed first */
+#define VFS_LIST_CACHE_MAX_SIZE (32 * 1024 * 1024)
+
+typedef struct
+{
+    char magic[8];
+    gint64 dir_mtime; /* ns */
+} ListCacheHeader;
+
+typedef struct
+{
+    guint32 mode;
+    guint32 uid;
+    guint32 gid;
+    guint32 flags; /* only VFS_FILE_INFO_MIME_PENDING is kept */
+    gint64 size;
+    gint64 mtime; /* ns */
+} ListCacheRecord;
+
+typedef struct
+{
+    char* path;
+    time_t mtime;
+    goffset size;
+} ListCacheFile;
+
+G_LOCK_DEFINE_STATIC(list_cache);
+
+static char* list_cache_get_file(const char* dir_path)
+{
+    char* hash = g_compute_checksum_for_string(G_CHECKSUM_MD5, dir_path, -1);
+    char* file_path = g_build_filename(g_get_user_cache_dir(), "spacefm-listings", hash, NULL);
+    g_free(hash);
+    return file_path;
+}
+
+GList* vfs_list_cache_load(const char* dir_path, gint64* dir_mtime, VFSFileInfoArena* arena)
+{
+    char* file_path = list_cache_get_file(dir_path);
+    char* data;
+    gsize len;
+    gboolean loaded = g_file_get_contents(file_path, &data, &len, NULL);
+    if (loaded)
+        g_utime(file_path, NULL); /* recently used */
+    g_free(file_path);
+    if (!loaded)
+        return NULL;
+
+    GList* files = NULL;
+    ListCacheHeader header;
+    gsize path_len = strlen(dir_path) + 1;
+    if (len >= sizeof(header) + path_len)
+        memcpy(&header, data, sizeof(header));
+    else
+        header.magic[0] = '\0';
+
+    if (!memcmp(header.magic, VFS_LIST_CACHE_MAGIC, sizeof(header.magic)) &&
+        !memcmp(data + sizeof(header), dir_path, path_len))
+    {
+        *dir_mtime = header.dir_mtime;
+        const char* end = data + len;
+        const char* p = data + sizeof(header) + path_len;
+        while (end - p > (long)sizeof(ListCacheRecord))
+        {
+            ListCacheRecord record;
+            memcpy(&record, p, sizeof(record));
+            const char* name = p + sizeof(record);
+            const char* name_end = memchr(name, '\0', end - name);
+            if (G_UNLIKELY(!name_end))
+                break;
+            const char* type = name_end + 1;
+            const char* type_end = memchr(type, '\0', end - type);
+            if (G_UNLIKELY(!type_end))
+                break;
+            p = type_end + 1;
+
+            struct stat file_stat;
+            file_stat.st_mode = record.mode;
+            file_stat.st_uid = record.uid;
+            file_stat.st_gid = record.gid;
+            file_stat.st_size = record.size;
+            file_stat.st_mtim.tv_sec = record.mtime / 1000000000;
+            file_stat.st_mtim.tv_nsec = record.mtime % 1000000000;
+            VFSFileInfo* file = vfs_file_info_new();
+            vfs_file_info_get_cached(file,
+                                     name,
+                                     &file_stat,
+                                     type,
+                                     !!(record.flags & VFS_FILE_INFO_MIME_PENDING),
+                                     arena);
+            /* shown with their name and icon, as when listed */
+            if (G_UNLIKELY(g_str_has_suffix(name, ".desktop")))
+            {
+                char* full_path = g_build_filename(dir_path, name, NULL);
+                vfs_file_info_load_special_info(file, full_path);
+                g_free(full_path);
+            }
+            files = g_list_prepend(files, file);
+        }
+    }
+    g_free(data);
+    return files;
+}
+
+GString* vfs_list_cache_begin(const char* dir_path, gint64 dir_mtime)
+{
+    ListCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, VFS_LIST_CACHE_MAGIC, sizeof(header.magic));
+    header.dir_mtime = dir_mtime;
+
+    GString* listing = g_string_sized_new(64 * 1024);
+    g_string_append_len(listing, (const char*)&header, sizeof(header));
+    g_string_append_len(listing, dir_path, strlen(dir_path) + 1);
+    return listing;
+}
+
+void vfs_list_cache_add(GString* listing, VFSFileInfo* file)
+{
+    /* too large to be kept anyway, see vfs_list_cache_commit */
+    if (G_UNLIKELY(listing->len > VFS_LIST_CACHE_MAX_SIZE))
+        return;
+
+    ListCacheRecord record;
+    record.mode = file->mode;
+    record.uid = file->uid;
+    record.gid = file->gid;
+    record.flags = file->flags & VFS_FILE_INFO_MIME_PENDING;
+    record.size = file->size;
+    record.mtime = (gint64)file->mtime * 1000000000 + file->mtime_nsec;
+    g_string_append_len(listing, (const char*)&record, sizeof(record));
+
+    const char* type = vfs_mime_type_get_type(file->mime_type);
+    g_string_append_len(listing, file->name, strlen(file->name) + 1);
+    g_string_append_len(listing, type, strlen(type) + 1);
+}
+
+static int compare_cache_file_mtime(const ListCacheFile* a, const ListCacheFile* b)
+{
+    return a->mtime < b->mtime ? -1 : a->mtime > b->mtime;
+}
+
+/* list_cache must be locked */
+static void list_cache_trim(const char* cache_dir)
+{
+    GDir* dir = g_dir_open(cache_dir, 0, NULL);
+    if (!dir)
+        return;
+
+    GArray* cache_files = g_array_new(FALSE, FALSE, sizeof(ListCacheFile));
+    goffset total = 0;
+    const char* name;
+    while ((name = g_dir_read_name(dir)))
+    {
+        /* skip the temporary files of g_file_set_contents */
+        if (strchr(name, '.'))
+            continue;
+        ListCacheFile cache_file;
+        struct stat file_stat;
+        cache_file.path = g_build_filename(cache_dir, name, NULL);
+        if (stat(cache_file.path, &file_stat) == 0)
+        {
+            cache_file.mtime = file_stat.st_mtime;
+            cache_file.size = file_stat.st_size;
+            total += cache_file.size;
+            g_array_append_val(cache_files, cache_file);
+        }
+        else
+            g_free(cache_file.path);
+    }
+    g_dir_close(dir);
+
+    if (total > VFS_LIST_CACHE_MAX_SIZE)
+        g_array_sort(cache_files, (GCompareFunc)compare_cache_file_mtime);
+    uint i;
+    for (i = 0; i < cache_files->len; ++i)
+    {
+        ListCacheFile* cache_file = &g_array_index(cache_files, ListCacheFile, i);
+        if (total > VFS_LIST_CACHE_MAX_SIZE && g_unlink(cache_file->path) == 0)
+            total -= cache_file->size;
+        g_free(cache_file->path);
+    }
+    g_array_free(cache_files, TRUE);
+}
+
+void vfs_list_cache_commit(const char* dir_path, GString* listing)
+{
+    if (listing->len <= VFS_LIST_CACHE_MAX_SIZE)
+    {
+        char* file_path = list_cache_get_file(dir_path);
+        char* cache_dir = g_path_get_dirname(file_path);
+        G_LOCK(list_cache);
+        if (g_mkdir_with_parents(cache_dir, 0700) == 0 &&
+            g_file_set_contents(file_path, listing->str, listing->len, NULL))
+            list_cache_trim(cache_dir);
+        G_UNLOCK(list_cache);
+        g_free(cache_dir);
+        g_free(file_path);
+    }
+    g_string_free(listing, TRUE);
+}
+
+void vfs_list_cache_remove(const char* dir_path)
+{
+    char* file_path = list_cache_get_file(dir_path);
+    G_LOCK(list_cache);
+    g_unlink(file_path);
+    G_UNLOCK(list_cache);
+    g_free(file_path);
+}
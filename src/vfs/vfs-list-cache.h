@@ -0,0 +1,42 @@
+/*
+ *  C Interface: vfs-list-cache
+ *
+ * Description: On-disk cache of directory listings
+ *
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#ifndef _VFS_LIST_CACHE_H_
+#define _VFS_LIST_CACHE_H_
+
+#include <glib.h>
+
+#include "vfs-file-info.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Listings of dirs which are slow to list, such as network mounts, are
+ * saved under the user cache dir so that they can be shown at once on the
+ * next visit while the dir is listed again.  Each listing is saved with the
+ * mtime of the dir, so the entries of an unchanged dir needn't be read,
+ * only its files stat'ed again.
+ */
+
+/* Returns the saved files of dir_path, or NULL if there are none.
+ * dir_mtime is set to the mtime in ns of the dir when it was saved. */
+GList* vfs_list_cache_load(const char* dir_path, gint64* dir_mtime, VFSFileInfoArena* arena);
+
+/* Listings are saved while they are read, before the files are shared
+ * with other threads */
+GString* vfs_list_cache_begin(const char* dir_path, gint64 dir_mtime);
+void vfs_list_cache_add(GString* listing, VFSFileInfo* file);
+void vfs_list_cache_commit(const char* dir_path, GString* listing);
+
+void vfs_list_cache_remove(const char* dir_path);
+
+G_END_DECLS
+
+#endif
@@ -33,6 +33,8 @@ static GList* reload_cb = NULL;
 static int big_icon_size = 32, small_icon_size = 16;
 
 static VFSFileMonitor** mime_caches_monitor = NULL;
+static GList* action_dirs_monitor = NULL; // dirs of mimeapps.list & desktop files
+static GList* apps_dirs_monitor = NULL;   // applications dirs and their subdirs
 
 static uint theme_change_notify = 0;
 
@@ -86,6 +88,7 @@ static void on_mime_cache_changed(VFSFileMonitor* fm, VFSFileMonitorEvent event,
             return;
         // fallthrough
     case VFS_FILE_MONITOR_CHANGE:
+    case VFS_FILE_MONITOR_OVERFLOW:
         mime_cache_reload(cache);
         /* g_debug( "reload cache: %s", file_name ); */
         if (0 == reload_callback_id)
@@ -95,6 +98,108 @@ static void on_mime_cache_changed(VFSFileMonitor* fm, VFSFileMonitorEvent event,
     }
 }
 
+static gboolean is_action_file(const char* file_name)
+{
+    return file_name && (g_str_has_suffix(file_name, ".desktop") || !strcmp(file_name, "mimeapps.list") ||
+                         !strcmp(file_name, "mimeinfo.cache") || !strcmp(file_name, "defaults.list"));
+}
+
+static void on_action_dir_changed(VFSFileMonitor* fm, VFSFileMonitorEvent event, const char* file_name,
+                                  gpointer user_data);
+
+static void add_action_dir_monitor(char* dir)
+{
+    if (g_file_test(dir, G_FILE_TEST_IS_DIR))
+    {
+        VFSFileMonitor* fm = vfs_file_monitor_add_dir(dir, on_action_dir_changed, NULL);
+        if (fm)
+            action_dirs_monitor = g_list_prepend(action_dirs_monitor, fm);
+    }
+    g_free(dir);
+}
+
+/* Desktop files are also looked for in the subdirs of the applications
+ * dirs, see mime_type_locate_desktop_file, so these are monitored too */
+static void add_apps_dir_monitor(char* dir)
+{
+    if (g_file_test(dir, G_FILE_TEST_IS_DIR) && !g_file_test(dir, G_FILE_TEST_IS_SYMLINK))
+    {
+        VFSFileMonitor* fm = vfs_file_monitor_add_dir(dir, on_action_dir_changed, GINT_TO_POINTER(TRUE));
+        if (fm)
+            apps_dirs_monitor = g_list_prepend(apps_dirs_monitor, fm);
+
+        GDir* gdir = g_dir_open(dir, 0, NULL);
+        if (gdir)
+        {
+            const char* name;
+            while ((name = g_dir_read_name(gdir)))
+                add_apps_dir_monitor(g_build_filename(dir, name, NULL));
+            g_dir_close(gdir);
+        }
+    }
+    g_free(dir);
+}
+
+/* Stop monitoring a subdir which was removed or moved away, and its own
+ * subdirs.  Returns FALSE if dir was not monitored. */
+static gboolean remove_apps_dir_monitor(const char* dir)
+{
+    gboolean found = FALSE;
+    size_t len = strlen(dir);
+    GList* l;
+    for (l = apps_dirs_monitor; l;)
+    {
+        GList* next = l->next;
+        VFSFileMonitor* fm = (VFSFileMonitor*)l->data;
+        if (!strncmp(fm->path, dir, len) && (fm->path[len] == '\0' || fm->path[len] == '/'))
+        {
+            vfs_file_monitor_remove(fm, on_action_dir_changed, GINT_TO_POINTER(TRUE));
+            apps_dirs_monitor = g_list_delete_link(apps_dirs_monitor, l);
+            found = TRUE;
+        }
+        l = next;
+    }
+    return found;
+}
+
+static void on_action_dir_changed(VFSFileMonitor* fm, VFSFileMonitorEvent event, const char* file_name,
+                                  gpointer user_data)
+{
+    gboolean subdirs = GPOINTER_TO_INT(user_data);
+    gboolean changed = event == VFS_FILE_MONITOR_OVERFLOW || is_action_file(file_name) ||
+                       (event == VFS_FILE_MONITOR_RENAME && is_action_file(fm->renamed_from));
+
+    if (subdirs && file_name && event != VFS_FILE_MONITOR_OVERFLOW)
+    {
+        /* a subdir, with its desktop files, may have come or gone at once */
+        char* path;
+        if (event == VFS_FILE_MONITOR_DELETE || event == VFS_FILE_MONITOR_RENAME)
+        {
+            path = g_build_filename(fm->path,
+                                    event == VFS_FILE_MONITOR_RENAME ? fm->renamed_from : file_name,
+                                    NULL);
+            changed = remove_apps_dir_monitor(path) || changed;
+            g_free(path);
+        }
+        if (event == VFS_FILE_MONITOR_CREATE || event == VFS_FILE_MONITOR_RENAME)
+        {
+            path = g_build_filename(fm->path, file_name, NULL);
+            if (g_file_test(path, G_FILE_TEST_IS_DIR) && !g_file_test(path, G_FILE_TEST_IS_SYMLINK))
+            {
+                remove_apps_dir_monitor(path);
+                add_apps_dir_monitor(path);
+                changed = TRUE;
+            }
+            else
+                g_free(path);
+        }
+    }
+
+    /* drop the app association index when any file it was built from changes */
+    if (changed)
+        mime_type_action_reload();
+}
+
 void vfs_mime_type_init()
 {
     int n_caches;
@@ -116,6 +221,14 @@ void vfs_mime_type_init()
             fm = NULL;
         mime_caches_monitor[i] = fm;
     }
+
+    /* install file alteration monitor for app associations, see mime-action.c */
+    add_action_dir_monitor(g_strdup(g_get_user_config_dir()));
+    add_apps_dir_monitor(g_build_filename(g_get_user_data_dir(), "applications", NULL));
+    const char* const* dirs = g_get_system_data_dirs();
+    for (; *dirs; ++dirs)
+        add_apps_dir_monitor(g_build_filename(*dirs, "applications", NULL));
+
     mime_hash = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, vfs_mime_type_unref);
     GtkIconTheme* theme = gtk_icon_theme_get_default();
     theme_change_notify = g_signal_connect(theme, "changed", G_CALLBACK(on_icon_theme_changed), NULL);
@@ -138,6 +251,17 @@ void vfs_mime_type_clean()
     }
     g_free(mime_caches_monitor);
 
+    GList* l;
+    for (l = action_dirs_monitor; l; l = l->next)
+        vfs_file_monitor_remove((VFSFileMonitor*)l->data, on_action_dir_changed, NULL);
+    g_list_free(action_dirs_monitor);
+    action_dirs_monitor = NULL;
+    for (l = apps_dirs_monitor; l; l = l->next)
+        vfs_file_monitor_remove((VFSFileMonitor*)l->data, on_action_dir_changed, GINT_TO_POINTER(TRUE));
+    g_list_free(apps_dirs_monitor);
+    apps_dirs_monitor = NULL;
+    mime_type_action_reload();
+
     mime_type_finalize();
 
     g_hash_table_destroy(mime_hash);
@@ -28,13 +28,20 @@
 #include <sys/stat.h>
 #include <libffmpegthumbnailer/videothumbnailerc.h>
 
+/* Thumbnails of all dirs are loaded by one bounded pool of workers, which
+ * take the requests from a shared queue in priority order.  The file views
+ * move the rows on screen to the front with vfs_thumbnail_loader_prioritize. */
+#define THUMBNAIL_MAX_WORKERS 4
+
 struct _VFSThumbnailLoader
 {
     VFSDir* dir;
-    GQueue* queue;
-    VFSAsyncTask* task;
+    GHashTable* requests; /* VFSFileInfo => its queued ThumbnailRequest */
+    GHashTable* views;    /* view => its queued requests of the rows on screen */
+    int generation;       /* bumped on each vfs_thumbnail_loader_prioritize */
+    int n_running;        /* requests being loaded by the workers */
     uint idle_handler;
-    GQueue* update_queue;
+    GQueue* update_queue; /* loaded requests, handed to their files in the main thread */
 };
 
 enum
@@ -44,14 +51,39 @@ enum
     N_LOAD_TYPES
 };
 
+enum
+{
+    PRIORITY_VISIBLE,
+    PRIORITY_NORMAL
+};
+
+/* The workers only read the name and mtime copied from the file when it was
+ * queued, never the VFSFileInfo itself, which the main thread may rename or
+ * update meanwhile.  Loaded thumbnails are given to the file in the idle handler. */
 typedef struct _ThumbnailRequest
 {
     int n_requests[N_LOAD_TYPES];
+    GdkPixbuf* thumbnails[N_LOAD_TYPES];
     VFSFileInfo* file;
+    char* name;
+    time_t mtime;
+    guint32 mtime_nsec;
+    VFSThumbnailLoader* loader;
+    GSList* views; /* showing the file, the request is visible priority while any does */
+    int priority;
+    int generation;
+    guint64 serial;
+    GSequenceIter* iter; /* position in thumbnail_queue */
 } ThumbnailRequest;
 
-static gpointer thumbnail_loader_thread(VFSAsyncTask* task, VFSThumbnailLoader* loader);
-/* static void on_load_finish( VFSAsyncTask* task, gboolean is_cancelled, VFSThumbnailLoader* loader ); */
+static GMutex thumbnail_lock; /* guards the queue and all loaders */
+static GCond thumbnail_cond;  /* signalled when a worker finishes a request */
+static GSequence* thumbnail_queue = NULL;
+static GThreadPool* thumbnail_pool = NULL;
+static int n_workers = 0;
+static guint64 request_serial = 0;
+
+static void thumbnail_worker(gpointer data, gpointer user_data);
 static void thumbnail_request_free(ThumbnailRequest* req);
 static gboolean on_thumbnail_idle(VFSThumbnailLoader* loader);
 
@@ -60,24 +92,37 @@ VFSThumbnailLoader* vfs_thumbnail_loader_new(VFSDir* dir)
     VFSThumbnailLoader* loader = g_slice_new0(VFSThumbnailLoader);
     loader->idle_handler = 0;
     loader->dir = g_object_ref(dir);
-    loader->queue = g_queue_new();
+    loader->requests = g_hash_table_new(g_direct_hash, NULL);
+    loader->views = g_hash_table_new(g_direct_hash, NULL);
     loader->update_queue = g_queue_new();
-    loader->task = vfs_async_task_new((VFSAsyncFunc)thumbnail_loader_thread, loader);
-    /* g_signal_connect( loader->task, "finish", G_CALLBACK(on_load_finish), loader ); */
     return loader;
 }
 
+static void free_visible(gpointer view, GList* visible, gpointer user_data)
+{
+    g_list_free(visible);
+}
+
 void vfs_thumbnail_loader_free(VFSThumbnailLoader* loader)
 {
-    if (loader->idle_handler)
+    GHashTableIter it;
+    ThumbnailRequest* req;
+
+    g_mutex_lock(&thumbnail_lock);
+
+    /* drop the queued requests, and wait for the ones being loaded */
+    g_hash_table_iter_init(&it, loader->requests);
+    while (g_hash_table_iter_next(&it, NULL, (gpointer*)&req))
     {
-        g_source_remove(loader->idle_handler);
-        loader->idle_handler = 0;
+        g_sequence_remove(req->iter);
+        thumbnail_request_free(req);
     }
+    g_hash_table_remove_all(loader->requests);
+    g_hash_table_foreach(loader->views, (GHFunc)free_visible, NULL);
+    g_hash_table_remove_all(loader->views);
 
-    /* g_signal_handlers_disconnect_by_func( loader->task, on_load_finish, loader ); */
-    /* stop the running thread, if any. */
-    vfs_async_task_cancel(loader->task);
+    while (loader->n_running > 0)
+        g_cond_wait(&thumbnail_cond, &thumbnail_lock);
 
     if (loader->idle_handler)
     {
@@ -85,62 +130,184 @@ void vfs_thumbnail_loader_free(VFSThumbnailLoader* loader)
         loader->idle_handler = 0;
     }
 
-    g_object_unref(loader->task);
+    g_mutex_unlock(&thumbnail_lock);
 
-    if (loader->queue)
-    {
-        g_queue_foreach(loader->queue, (GFunc)thumbnail_request_free, NULL);
-        g_queue_free(loader->queue);
-    }
-    if (loader->update_queue)
-    {
-        g_queue_foreach(loader->update_queue, (GFunc)vfs_file_info_unref, NULL);
-        g_queue_free(loader->update_queue);
-    }
+    g_hash_table_destroy(loader->requests);
+    g_hash_table_destroy(loader->views);
+    g_queue_foreach(loader->update_queue, (GFunc)thumbnail_request_free, NULL);
+    g_queue_free(loader->update_queue);
     /* g_debug( "FREE THUMBNAIL LOADER" ); */
 
     /* prevent recursive unref called from vfs_dir_finalize */
     loader->dir->thumbnail_loader = NULL;
     g_object_unref(loader->dir);
+    g_slice_free(VFSThumbnailLoader, loader);
 }
 
-#if 0 /* This is not used in the program. For debug only */
-void on_load_finish( VFSAsyncTask* task, gboolean is_cancelled, VFSThumbnailLoader* loader )
-{
-    g_debug( "TASK FINISHED" );
-}
-#endif
-
 void thumbnail_request_free(ThumbnailRequest* req)
 {
+    int i;
+    for (i = 0; i < N_LOAD_TYPES; ++i)
+    {
+        if (req->thumbnails[i])
+            g_object_unref(req->thumbnails[i]);
+    }
+    g_free(req->name);
+    g_slist_free(req->views);
     vfs_file_info_unref(req->file);
     g_slice_free(ThumbnailRequest, req);
     /* g_debug( "FREE REQUEST!" ); */
 }
 
+static int thumbnail_request_compare(ThumbnailRequest* a, ThumbnailRequest* b, gpointer user_data)
+{
+    if (a->priority != b->priority)
+        return a->priority - b->priority;
+    return a->serial < b->serial ? -1 : (a->serial > b->serial ? 1 : 0);
+}
+
+/* Start another worker if the pool is not busy yet.  Called with thumbnail_lock held. */
+static void thumbnail_pool_wake()
+{
+    if (G_UNLIKELY(!thumbnail_pool))
+    {
+        int max_workers = CLAMP(g_get_num_processors(), 1, THUMBNAIL_MAX_WORKERS);
+        thumbnail_pool = g_thread_pool_new(thumbnail_worker, NULL, max_workers, FALSE, NULL);
+    }
+    if (n_workers < g_thread_pool_get_max_threads(thumbnail_pool))
+    {
+        ++n_workers;
+        g_thread_pool_push(thumbnail_pool, GINT_TO_POINTER(1), NULL);
+    }
+}
+
+/* Called with thumbnail_lock held. */
+static ThumbnailRequest* thumbnail_loader_queue_file(VFSThumbnailLoader* loader, VFSFileInfo* file,
+                                                     int priority)
+{
+    ThumbnailRequest* req = g_slice_new0(ThumbnailRequest);
+    req->file = vfs_file_info_ref(file);
+    req->name = g_strdup(file->name);
+    req->mtime = file->mtime;
+    req->mtime_nsec = file->mtime_nsec;
+    req->loader = loader;
+    req->priority = priority;
+    req->serial = ++request_serial;
+    req->iter = g_sequence_insert_sorted(thumbnail_queue,
+                                         req,
+                                         (GCompareDataFunc)thumbnail_request_compare,
+                                         NULL);
+    g_hash_table_insert(loader->requests, file, req);
+    thumbnail_pool_wake();
+    return req;
+}
+
+/* The file of a queued request was renamed or changed since, which is only
+ * done in the main thread.  Called with thumbnail_lock held. */
+static void thumbnail_request_refresh(ThumbnailRequest* req)
+{
+    VFSFileInfo* file = req->file;
+    if (strcmp(req->name, file->name))
+    {
+        g_free(req->name);
+        req->name = g_strdup(file->name);
+    }
+    req->mtime = file->mtime;
+    req->mtime_nsec = file->mtime_nsec;
+}
+
+/* Called with thumbnail_lock held. */
+static void thumbnail_loader_set_visible(VFSThumbnailLoader* loader, gpointer view, GList* visible)
+{
+    if (visible)
+        g_hash_table_insert(loader->views, view, visible);
+    else
+        g_hash_table_remove(loader->views, view);
+}
+
+/* Remove a request from the visible rows of the views showing it.
+ * Called with thumbnail_lock held. */
+static void thumbnail_loader_unlist(VFSThumbnailLoader* loader, ThumbnailRequest* req)
+{
+    GSList* l;
+    for (l = req->views; l; l = l->next)
+    {
+        GList* visible = (GList*)g_hash_table_lookup(loader->views, l->data);
+        thumbnail_loader_set_visible(loader, l->data, g_list_remove(visible, req));
+    }
+    g_slist_free(req->views);
+    req->views = NULL;
+}
+
+/* Take a request out of the queue.  Called with thumbnail_lock held. */
+static void thumbnail_loader_unqueue(VFSThumbnailLoader* loader, ThumbnailRequest* req)
+{
+    g_sequence_remove(req->iter);
+    req->iter = NULL;
+    g_hash_table_remove(loader->requests, req->file);
+    thumbnail_loader_unlist(loader, req);
+}
+
+static VFSThumbnailLoader* thumbnail_loader_get(VFSDir* dir)
+{
+    if (G_UNLIKELY(!dir->thumbnail_loader))
+        dir->thumbnail_loader = vfs_thumbnail_loader_new(dir);
+    if (G_UNLIKELY(!thumbnail_queue))
+        thumbnail_queue = g_sequence_new(NULL);
+    return dir->thumbnail_loader;
+}
+
+/* Give the file the thumbnails loaded for it.  Returns FALSE if they are of
+ * an older version of the file, the views request them again for the new one. */
+static gboolean thumbnail_request_apply(ThumbnailRequest* req)
+{
+    VFSFileInfo* file = req->file;
+    if (file->mtime != req->mtime || file->mtime_nsec != req->mtime_nsec)
+        return FALSE;
+    /* renamed while loading: keep a thumbnail of the same content, but
+     * not the fallback icon, the new name may have another type */
+    gboolean renamed = strcmp(file->name, req->name) != 0;
+    gboolean applied = FALSE;
+    int i;
+    for (i = 0; i < N_LOAD_TYPES; ++i)
+    {
+        if (req->n_requests[i] <= 0 || (renamed && !req->thumbnails[i]))
+            continue;
+        vfs_file_info_set_thumbnail(file, req->thumbnails[i], i == LOAD_BIG_THUMBNAIL);
+        req->thumbnails[i] = NULL;
+        applied = TRUE;
+    }
+    return applied;
+}
+
 gboolean on_thumbnail_idle(VFSThumbnailLoader* loader)
 {
-    VFSFileInfo* file;
+    ThumbnailRequest* req;
+    gboolean finished;
 
     /* g_debug( "ENTER ON_THUMBNAIL_IDLE" ); */
-    vfs_async_task_lock(loader->task);
-
-    while ((file = (VFSFileInfo*)g_queue_pop_head(loader->update_queue)))
+    while (TRUE)
     {
+        g_mutex_lock(&thumbnail_lock);
+        req = (ThumbnailRequest*)g_queue_pop_head(loader->update_queue);
+        if (!req)
+            break;
+        g_mutex_unlock(&thumbnail_lock);
+
         GDK_THREADS_ENTER();
-        vfs_dir_emit_thumbnail_loaded(loader->dir, file);
-        vfs_file_info_unref(file);
+        if (thumbnail_request_apply(req))
+            vfs_dir_emit_thumbnail_loaded(loader->dir, req->file);
+        thumbnail_request_free(req);
         GDK_THREADS_LEAVE();
     }
 
     loader->idle_handler = 0;
+    finished = g_hash_table_size(loader->requests) == 0 && loader->n_running == 0;
+    g_mutex_unlock(&thumbnail_lock);
 
-    vfs_async_task_unlock(loader->task);
-
-    if (vfs_async_task_is_finished(loader->task))
+    if (finished)
     {
         /* g_debug( "FREE LOADER IN IDLE HANDLER" ); */
-        loader->dir->thumbnail_loader = NULL;
         vfs_thumbnail_loader_free(loader);
     }
     /* g_debug( "LEAVE ON_THUMBNAIL_IDLE" ); */
@@ -148,189 +315,180 @@ gboolean on_thumbnail_idle(VFSThumbnailLoader* loader)
     return FALSE;
 }
 
-gpointer thumbnail_loader_thread(VFSAsyncTask* task, VFSThumbnailLoader* loader)
+static gboolean thumbnail_request_load(ThumbnailRequest* req)
 {
-    while (G_LIKELY(!vfs_async_task_is_cancelled(task)))
+    /* Only we have the reference. That means, no body is using the file */
+    if (g_atomic_int_get(&req->file->n_ref) == 1)
+        return FALSE;
+
+    gboolean need_update = FALSE;
+    char* full_path = g_build_filename(req->loader->dir->path, req->name, NULL);
+    int i;
+    for (i = 0; i < N_LOAD_TYPES; ++i)
     {
-        vfs_async_task_lock(task);
-        ThumbnailRequest* req = (ThumbnailRequest*)g_queue_pop_head(loader->queue);
-        vfs_async_task_unlock(task);
-        if (G_UNLIKELY(!req))
-            break;
-        /* g_debug("pop: %s", req->file->name); */
-
-        /* Only we have the reference. That means, no body is using the file */
-        if (req->file->n_ref == 1)
-        {
-            thumbnail_request_free(req);
+        if (req->n_requests[i] <= 0)
             continue;
-        }
+        req->thumbnails[i] = vfs_file_info_read_thumbnail(full_path, req->mtime, i == LOAD_BIG_THUMBNAIL);
+        /* g_debug( "thumbnail loaded: %s", full_path ); */
+        need_update = TRUE;
+    }
+    g_free(full_path);
+    return need_update;
+}
 
-        gboolean need_update = FALSE;
-        int i;
-        for (i = 0; i < 2; ++i)
-        {
-            if (0 == req->n_requests[i])
-                continue;
+void thumbnail_worker(gpointer data, gpointer user_data)
+{
+    GSequenceIter* it;
 
-            gboolean load_big = (i == LOAD_BIG_THUMBNAIL);
-            if (!vfs_file_info_is_thumbnail_loaded(req->file, load_big))
-            {
-                char* full_path;
-                full_path = g_build_filename(loader->dir->path, vfs_file_info_get_name(req->file), NULL);
-                vfs_file_info_load_thumbnail(req->file, full_path, load_big);
-                g_free(full_path);
-                /*  Slow donwn for debugging.
-                g_debug( "DELAY!!" );
-                g_usleep(G_USEC_PER_SEC/2);
-                */
-
-                /* g_debug( "thumbnail loaded: %s", req->file ); */
-            }
-            need_update = TRUE;
-        }
+    g_mutex_lock(&thumbnail_lock);
+    while (!g_sequence_iter_is_end((it = g_sequence_get_begin_iter(thumbnail_queue))))
+    {
+        ThumbnailRequest* req = (ThumbnailRequest*)g_sequence_get(it);
+        VFSThumbnailLoader* loader = req->loader;
+        /* g_debug("pop: %s", req->file->name); */
 
-        if (!vfs_async_task_is_cancelled(task) && need_update)
-        {
-            vfs_async_task_lock(task);
-            g_queue_push_tail(loader->update_queue, vfs_file_info_ref(req->file));
-            if (0 == loader->idle_handler)
-            {
-                loader->idle_handler = g_idle_add_full(G_PRIORITY_LOW, (GSourceFunc)on_thumbnail_idle, loader, NULL);
-            }
-            vfs_async_task_unlock(task);
-        }
-        /* g_debug( "NEED_UPDATE: %d", need_update ); */
-        thumbnail_request_free(req);
-    }
+        thumbnail_loader_unqueue(loader, req);
+        ++loader->n_running;
+        g_mutex_unlock(&thumbnail_lock);
 
-    if (vfs_async_task_is_cancelled(task))
-    {
-        /* g_debug( "THREAD CANCELLED!!!" ); */
-        vfs_async_task_lock(task);
-        if (loader->idle_handler)
-        {
-            g_source_remove(loader->idle_handler);
-            loader->idle_handler = 0;
-        }
-        vfs_async_task_unlock(task);
-    }
-    else
-    {
-        if (0 == loader->idle_handler)
+        gboolean need_update = thumbnail_request_load(req);
+
+        g_mutex_lock(&thumbnail_lock);
+        --loader->n_running;
+        if (need_update)
+            g_queue_push_tail(loader->update_queue, req);
+        /* the idle handler also frees the loader once it has nothing left to do */
+        if (0 == loader->idle_handler &&
+            (need_update || (loader->n_running == 0 && g_hash_table_size(loader->requests) == 0)))
         {
-            /* g_debug( "ADD IDLE HANDLER BEFORE THREAD ENDING" ); */
-            /* FIXME: add2 This source always causes a "Source ID was not
-             * found" critical warning if removed in vfs_thumbnail_loader_free.
-             * Where is this being removed?  See comment in
-             * vfs_thumbnail_loader_cancel_all_requests. */
             loader->idle_handler = g_idle_add_full(G_PRIORITY_LOW, (GSourceFunc)on_thumbnail_idle, loader, NULL);
         }
+        g_cond_broadcast(&thumbnail_cond);
+        if (!need_update)
+            thumbnail_request_free(req);
     }
-    /* g_debug("THREAD ENDED!");  */
-    return NULL;
+    --n_workers;
+    g_mutex_unlock(&thumbnail_lock);
 }
 
 void vfs_thumbnail_loader_request(VFSDir* dir, VFSFileInfo* file, gboolean is_big)
 {
-    ThumbnailRequest* req;
-    gboolean new_task = FALSE;
+    /* g_debug( "request thumbnail: %s, is_big: %d", file->name, is_big ); */
+    g_mutex_lock(&thumbnail_lock);
 
+    VFSThumbnailLoader* loader = thumbnail_loader_get(dir);
 
-    /* g_debug( "request thumbnail: %s, is_big: %d", file->name, is_big ); */
-    if (G_UNLIKELY(!dir->thumbnail_loader))
-    {
-        dir->thumbnail_loader = vfs_thumbnail_loader_new(dir);
-        new_task = TRUE;
-    }
+    /* Check if the request is already scheduled */
+    ThumbnailRequest* req = (ThumbnailRequest*)g_hash_table_lookup(loader->requests, file);
+    if (!req)
+        req = thumbnail_loader_queue_file(loader, file, PRIORITY_NORMAL);
+    else
+        thumbnail_request_refresh(req);
 
-    VFSThumbnailLoader* loader = dir->thumbnail_loader;
+    ++req->n_requests[is_big ? LOAD_BIG_THUMBNAIL : LOAD_SMALL_THUMBNAIL];
 
-    if (G_UNLIKELY(!loader->task))
-    {
-        loader->task = vfs_async_task_new((VFSAsyncFunc)thumbnail_loader_thread, loader);
-        new_task = TRUE;
-    }
-    vfs_async_task_lock(loader->task);
+    g_mutex_unlock(&thumbnail_lock);
+}
 
-    /* Check if the request is already scheduled */
+void vfs_thumbnail_loader_prioritize(VFSDir* dir, gpointer view, GList* files, gboolean is_big)
+{
+    int type = is_big ? LOAD_BIG_THUMBNAIL : LOAD_SMALL_THUMBNAIL;
     GList* l;
-    for (l = loader->queue->head; l; l = l->next)
-    {
-        req = (ThumbnailRequest*)l->data;
-        /* If file with the same name is already in our queue */
-        if (req->file == file || 0 == strcmp(req->file->name, file->name))
-            break;
-    }
-    if (l)
+    GList* old_visible;
+    GList* visible = NULL;
+
+    /* nothing was requested yet, nothing to cancel */
+    if (!files && !dir->thumbnail_loader)
+        return;
+
+    g_mutex_lock(&thumbnail_lock);
+
+    VFSThumbnailLoader* loader = thumbnail_loader_get(dir);
+    old_visible = (GList*)g_hash_table_lookup(loader->views, view);
+    g_hash_table_remove(loader->views, view);
+    ++loader->generation;
+
+    /* move the rows on screen to the front, in display order */
+    for (l = files; l; l = l->next)
     {
-        req = (ThumbnailRequest*)l->data;
+        VFSFileInfo* file = (VFSFileInfo*)l->data;
+        ThumbnailRequest* req = (ThumbnailRequest*)g_hash_table_lookup(loader->requests, file);
+        if (!req)
+            req = thumbnail_loader_queue_file(loader, file, PRIORITY_VISIBLE);
+        else
+            thumbnail_request_refresh(req);
+        if (req->n_requests[type] <= 0)
+            req->n_requests[type] = 1;
+        if (!g_slist_find(req->views, view))
+            req->views = g_slist_prepend(req->views, view);
+        req->priority = PRIORITY_VISIBLE;
+        req->generation = loader->generation;
+        req->serial = ++request_serial;
+        g_sequence_sort_changed(req->iter, (GCompareDataFunc)thumbnail_request_compare, NULL);
+        visible = g_list_prepend(visible, req);
     }
-    else
+    thumbnail_loader_set_visible(loader, view, visible);
+
+    /* cancel the requests of rows which scrolled out of this view,
+     * unless another view still shows them */
+    for (l = old_visible; l; l = l->next)
     {
-        req = g_slice_new0(ThumbnailRequest);
-        req->file = vfs_file_info_ref(file);
-        g_queue_push_tail(dir->thumbnail_loader->queue, req);
+        ThumbnailRequest* req = (ThumbnailRequest*)l->data;
+        if (req->generation == loader->generation)
+            continue;
+        req->views = g_slist_remove(req->views, view);
+        if (req->views)
+            continue;
+        g_sequence_remove(req->iter);
+        g_hash_table_remove(loader->requests, req->file);
+        thumbnail_request_free(req);
     }
+    g_list_free(old_visible);
 
-    ++req->n_requests[is_big ? LOAD_BIG_THUMBNAIL : LOAD_SMALL_THUMBNAIL];
-
-    vfs_async_task_unlock(loader->task);
-
-    if (new_task)
-        vfs_async_task_execute(loader->task);
+    g_mutex_unlock(&thumbnail_lock);
 }
 
 void vfs_thumbnail_loader_cancel_all_requests(VFSDir* dir, gboolean is_big)
 {
     VFSThumbnailLoader* loader;
+    GHashTableIter it;
+    ThumbnailRequest* req;
+    gboolean finished;
 
     if (G_UNLIKELY((loader = dir->thumbnail_loader)))
     {
-        vfs_async_task_lock(loader->task);
+        g_mutex_lock(&thumbnail_lock);
         /* g_debug( "TRY TO CANCEL REQUESTS!!" ); */
-        GList* l;
-        for (l = loader->queue->head; l;)
+        g_hash_table_iter_init(&it, loader->requests);
+        while (g_hash_table_iter_next(&it, NULL, (gpointer*)&req))
         {
-            ThumbnailRequest* req = (ThumbnailRequest*)l->data;
             --req->n_requests[is_big ? LOAD_BIG_THUMBNAIL : LOAD_SMALL_THUMBNAIL];
 
             if (req->n_requests[0] <= 0 && req->n_requests[1] <= 0) /* nobody needs this */
             {
-                GList* next = l->next;
-                g_queue_delete_link(loader->queue, l);
-                l = next;
+                g_sequence_remove(req->iter);
+                thumbnail_loader_unlist(loader, req);
+                g_hash_table_iter_remove(&it);
+                thumbnail_request_free(req);
             }
-            else
-                l = l->next;
         }
 
-        if (g_queue_get_length(loader->queue) == 0)
+        /* requests still being loaded free the loader from the idle handler */
+        finished = g_hash_table_size(loader->requests) == 0 && loader->n_running == 0;
+        g_mutex_unlock(&thumbnail_lock);
+
+        if (finished)
         {
             /* g_debug( "FREE LOADER IN vfs_thumbnail_loader_cancel_all_requests!" ); */
-            vfs_async_task_unlock(loader->task);
-            loader->dir->thumbnail_loader = NULL;
-
-            /* FIXME: added idle_handler = 0 to prevent idle_handler being
-             * removed in vfs_thumbnail_loader_free - BUT causes a segfault
-             * in vfs_async_task_lock ??
-             * If source is removed here or in vfs_thumbnail_loader_free
-             * it causes a "GLib-CRITICAL **: Source ID N was not found when
-             * attempting to remove it" warning.  Such a source ID is always
-             * the one added in thumbnail_loader_thread at the "add2" comment. */
-            // loader->idle_handler = 0;
-
             vfs_thumbnail_loader_free(loader);
-            return;
         }
-        vfs_async_task_unlock(loader->task);
     }
 }
 
 static GdkPixbuf* _vfs_thumbnail_load(const char* file_path, const char* uri, int size, time_t mtime)
 {
     char md5_len = 32;
-    static char file_name[40];
+    char file_name[40];
     const char* thumb_mtime;
     int w;
     int h;
@@ -39,6 +39,12 @@ void vfs_thumbnail_loader_free(VFSThumbnailLoader* loader);
 void vfs_thumbnail_loader_request(VFSDir* dir, VFSFileInfo* file, gboolean is_big);
 void vfs_thumbnail_loader_cancel_all_requests(VFSDir* dir, gboolean is_big);
 
+/* Load the thumbnails of files, the rows currently on screen in view in
+ * display order, before all other requests, and cancel the requests of rows
+ * which scrolled out of view since its last call and no other view shows.
+ * An empty files list forgets the view. */
+void vfs_thumbnail_loader_prioritize(VFSDir* dir, gpointer view, GList* files, gboolean is_big);
+
 /* Load thumbnail for the specified file
  *  If the caller knows mtime of the file, it should pass mtime to this function to
  *  prevent unnecessary disk I/O and this can speed up the loading.
@@ -3955,6 +3955,34 @@ const GList* vfs_volume_get_all_volumes()
     return volumes;
 }
 
+/* Device of the mounted volume holding dir, from the mount points known
+ * without touching the disk.  Returns 0 if none matches. */
+dev_t vfs_volume_get_device_of_dir(const char* dir)
+{
+    dev_t devnum = 0;
+    gsize best_len = 0;
+    GList* l;
+
+    if (!dir)
+        return 0;
+    for (l = volumes; l; l = l->next)
+    {
+        VFSVolume* vol = (VFSVolume*)l->data;
+        if (!vol->is_mounted || !vol->mount_point || !vol->devnum)
+            continue;
+        gsize len = strlen(vol->mount_point);
+        while (len > 1 && vol->mount_point[len - 1] == '/')
+            --len;
+        if (len > best_len && !strncmp(dir, vol->mount_point, len) &&
+            (dir[len] == '/' || dir[len] == '\0' || (len == 1 && dir[0] == '/')))
+        {
+            devnum = vol->devnum;
+            best_len = len;
+        }
+    }
+    return devnum;
+}
+
 VFSVolume* vfs_volume_get_by_device_or_point(const char* device_file, const char* point)
 {
     if (!point && !device_file)
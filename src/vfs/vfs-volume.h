@@ -133,6 +133,7 @@ int split_network_url(const char* url, netmount_t** netmount);
 void vfs_volume_special_mounted(const char* device_file);
 gboolean vfs_volume_dir_avoid_changes(const char* dir);
 dev_t get_device_parent(dev_t dev);
+dev_t vfs_volume_get_device_of_dir(const char* dir);
 gboolean path_is_mounted_mtab(const char* mtab_file, const char* path, char** device_file, char** fs_type);
 gboolean mtab_fstype_is_handled_by_protocol(const char* mtab_fstype);
 VFSVolume* vfs_volume_get_by_device_or_point(const char* device_file, const char* point);
@@ -0,0 +1,153 @@
+/*
+ *  collate-key-bench.c
+ *
+ * Description: Load time and memory of the filename collate keys of a
+ * large dir, built for every file as it is listed as before, and on first
+ * use by the sort comparator of ptk-file-list as now.  Each variant runs
+ * in a child process so that its heap is measured alone.  Files hold only
+ * what the keys are built from and sorted by, vfs-file-info.c needs GTK.
+ *
+ * Usage: collate-key-bench [n_files]
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define DEFAULT_N_FILES 500000
+
+typedef struct
+{
+    char* disp_name;
+    gint64 size;
+    gint64 mtime;
+    char* collate_key;
+    char* collate_icase_key;
+} BenchFile;
+
+typedef enum
+{
+    KEYS_EAGER,      /* before, both keys built when listed */
+    KEYS_LAZY_NAME,  /* sorted by name ignoring case */
+    KEYS_LAZY_MTIME, /* sorted by date, keys only for ties */
+    N_VARIANTS
+} Variant;
+
+static const char* const variant_names[] = {"both keys when listed (before)", "on first use, sort by name",
+                                            "on first use, sort by date"};
+
+static const char* const patterns[] = {"IMG_%07u.JPG", "Report %u final.pdf", "résumé-%u.odt", "src_file_%u.c",
+                                       "Übersicht %u.txt", "track%02u - %u.flac", "photo (%u).png", "%u.log"};
+
+static size_t heap_used()
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+/* vfs_file_info_get_collate_key */
+static const char* get_collate_key(BenchFile* file, gboolean icase)
+{
+    if (icase)
+    {
+        if (!file->collate_icase_key)
+        {
+            char* str = g_utf8_casefold(file->disp_name, -1);
+            file->collate_icase_key = g_utf8_collate_key_for_filename(str, -1);
+            g_free(str);
+        }
+        return file->collate_icase_key;
+    }
+    if (!file->collate_key)
+        file->collate_key = g_utf8_collate_key_for_filename(file->disp_name, -1);
+    return file->collate_key;
+}
+
+static gint compare_name(gconstpointer a, gconstpointer b)
+{
+    BenchFile* file_a = *(BenchFile**)a;
+    BenchFile* file_b = *(BenchFile**)b;
+    return strcmp(get_collate_key(file_a, TRUE), get_collate_key(file_b, TRUE));
+}
+
+static gint compare_mtime(gconstpointer a, gconstpointer b)
+{
+    BenchFile* file_a = *(BenchFile**)a;
+    BenchFile* file_b = *(BenchFile**)b;
+    if (file_a->mtime != file_b->mtime)
+        return file_a->mtime < file_b->mtime ? -1 : 1;
+    return compare_name(a, b);
+}
+
+static void run(Variant variant, uint n_files)
+{
+    GPtrArray* files = g_ptr_array_sized_new(n_files);
+    uint i;
+    size_t heap_start = heap_used();
+    gint64 start = g_get_monotonic_time();
+    for (i = 0; i < n_files; ++i)
+    {
+        BenchFile* file = g_slice_new0(BenchFile);
+        file->disp_name = g_strdup_printf(patterns[i % G_N_ELEMENTS(patterns)], i, i / 16);
+        file->size = g_random_int_range(0, 1 << 30);
+        /* a second resolution, files copied together share it */
+        file->mtime = 1700000000 + i / 4 + g_random_int_range(0, 4) * 1000000;
+        if (variant == KEYS_EAGER)
+        {
+            get_collate_key(file, TRUE);
+            get_collate_key(file, FALSE);
+        }
+        g_ptr_array_add(files, file);
+    }
+    double load_ms = (g_get_monotonic_time() - start) / 1000.0;
+    size_t heap_loaded = heap_used();
+
+    start = g_get_monotonic_time();
+    g_ptr_array_sort(files, variant == KEYS_LAZY_MTIME ? compare_mtime : compare_name);
+    double sort_ms = (g_get_monotonic_time() - start) / 1000.0;
+    size_t heap_sorted = heap_used();
+
+    uint n_keys = 0;
+    for (i = 0; i < n_files; ++i)
+    {
+        BenchFile* file = (BenchFile*)g_ptr_array_index(files, i);
+        n_keys += (file->collate_key != NULL) + (file->collate_icase_key != NULL);
+    }
+    g_printf("  %-31s load %7.1f ms, %6.1f MiB; first sort %7.1f ms, %6.1f MiB; %u keys\n",
+             variant_names[variant], load_ms, (heap_loaded - heap_start) / (1024.0 * 1024),
+             sort_ms, (heap_sorted - heap_start) / (1024.0 * 1024), n_keys);
+}
+
+int main(int argc, char* argv[])
+{
+    uint n_files = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_N_FILES;
+    int v;
+    if (!setlocale(LC_ALL, "C.UTF-8"))
+        setlocale(LC_ALL, "");
+    g_printf("%u files, %s locale:\n", n_files, setlocale(LC_COLLATE, NULL));
+    for (v = 0; v < N_VARIANTS; ++v)
+    {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            run((Variant)v, n_files);
+            fflush(stdout);
+            _exit(0);
+        }
+        int status;
+        if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            return 1;
+    }
+    return 0;
+}
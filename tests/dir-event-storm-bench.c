@@ -0,0 +1,181 @@
+/*
+ *  dir-event-storm-bench.c
+ *
+ * Description: Replays a storm of file events against the file list of a
+ * VFSDir, looked up by a strcmp scan of file_list as before, and through
+ * file_hash, the name index of the links of file_list, as now.  Events are
+ * created, deleted and changed files and loaded thumbnails in equal parts,
+ * handled as vfs_dir_emit_file_created/deleted/changed and
+ * vfs_dir_emit_thumbnail_loaded do.
+ *
+ * Usage: dir-event-storm-bench [n_files]...
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define N_EVENTS 1000
+
+typedef enum
+{
+    EVENT_CREATED,
+    EVENT_DELETED,
+    EVENT_CHANGED,
+    EVENT_THUMBNAIL
+} EventType;
+
+typedef struct
+{
+    EventType type;
+    char* name;
+} Event;
+
+typedef struct
+{
+    char* name;
+} File;
+
+typedef struct
+{
+    GList* file_list;
+    GHashTable* file_hash; /* NULL before */
+    uint n_files;
+} Dir;
+
+static File* file_new(const char* name)
+{
+    File* file = g_slice_new(File);
+    file->name = g_strdup(name);
+    return file;
+}
+
+static void file_free(File* file)
+{
+    g_free(file->name);
+    g_slice_free(File, file);
+}
+
+static GList* find_file(Dir* dir, const char* name)
+{
+    if (dir->file_hash)
+        return (GList*)g_hash_table_lookup(dir->file_hash, name);
+    GList* l;
+    for (l = dir->file_list; l; l = l->next)
+    {
+        if (!strcmp(((File*)l->data)->name, name))
+            return l;
+    }
+    return NULL;
+}
+
+static void insert_file(Dir* dir, File* file)
+{
+    dir->file_list = g_list_prepend(dir->file_list, file);
+    if (dir->file_hash)
+        g_hash_table_insert(dir->file_hash, g_strdup(file->name), dir->file_list);
+    ++dir->n_files;
+}
+
+static void dir_load(Dir* dir, uint n_files, gboolean indexed)
+{
+    uint i;
+    dir->file_list = NULL;
+    dir->file_hash = indexed ? g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL) : NULL;
+    dir->n_files = 0;
+    for (i = 0; i < n_files; ++i)
+    {
+        char name[32];
+        g_snprintf(name, sizeof(name), "file-%07u.dat", i);
+        insert_file(dir, file_new(name));
+    }
+}
+
+static void dir_free(Dir* dir)
+{
+    g_list_free_full(dir->file_list, (GDestroyNotify)file_free);
+    if (dir->file_hash)
+        g_hash_table_destroy(dir->file_hash);
+}
+
+/* Returns the number of events which found their file */
+static uint replay(Dir* dir, Event* events)
+{
+    uint n_found = 0;
+    uint i;
+    for (i = 0; i < N_EVENTS; ++i)
+    {
+        Event* event = &events[i];
+        GList* l = find_file(dir, event->name);
+        n_found += l != NULL;
+        switch (event->type)
+        {
+        case EVENT_CREATED:
+            if (!l)
+                insert_file(dir, file_new(event->name));
+            break;
+        case EVENT_DELETED:
+            if (!l)
+                break;
+            File* file = (File*)l->data;
+            if (dir->file_hash)
+                g_hash_table_remove(dir->file_hash, file->name);
+            else
+                l = g_list_find(dir->file_list, file); /* in update_file_info */
+            dir->file_list = g_list_delete_link(dir->file_list, l);
+            --dir->n_files;
+            file_free(file);
+            break;
+        default:
+            break;
+        }
+    }
+    return n_found;
+}
+
+static void bench(Event* events, uint n_files, gboolean indexed)
+{
+    Dir dir;
+    gint64 start = g_get_monotonic_time();
+    dir_load(&dir, n_files, indexed);
+    double load_ms = (g_get_monotonic_time() - start) / 1000.0;
+
+    start = g_get_monotonic_time();
+    uint n_found = replay(&dir, events);
+    double storm_ms = (g_get_monotonic_time() - start) / 1000.0;
+
+    g_printf("  %s load %8.1f ms, %u events %9.1f ms (%.2f us each), %u found\n",
+             indexed ? "file_hash:" : "file_list:", load_ms, N_EVENTS, storm_ms, storm_ms * 1000 / N_EVENTS, n_found);
+    dir_free(&dir);
+}
+
+int main(int argc, char* argv[])
+{
+    static const uint default_sizes[] = {10000, 100000, 1000000};
+    uint n_sizes = argc > 1 ? (uint)argc - 1 : G_N_ELEMENTS(default_sizes);
+    Event events[N_EVENTS];
+    uint s, i;
+    for (s = 0; s < n_sizes; ++s)
+    {
+        uint n_files = argc > 1 ? strtoul(argv[s + 1], NULL, 10) : default_sizes[s];
+        if (!n_files)
+            continue;
+        /* about half the events name a listed file, the others a new one */
+        for (i = 0; i < N_EVENTS; ++i)
+        {
+            events[i].type = (EventType)(i % 4);
+            events[i].name = g_strdup_printf("file-%07u.dat", g_random_int_range(0, n_files * 2));
+        }
+        g_printf("%u files:\n", n_files);
+        bench(events, n_files, FALSE);
+        bench(events, n_files, TRUE);
+        for (i = 0; i < N_EVENTS; ++i)
+            g_free(events[i].name);
+    }
+    return 0;
+}
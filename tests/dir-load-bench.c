@@ -0,0 +1,195 @@
+/*
+ *  dir-load-bench.c
+ *
+ * Description: Compares the loops of vfs_dir_load_thread listing a
+ * synthetic dir, g_dir_read_name with an lstat of the full path of each
+ * file as before, and getdents64 batches with fstatat on the dir fd as now.
+ * Both type files by name with mime_type_get_by_filename and keep a copy of
+ * the name and the stat, so only the reading of the dir differs.
+ *
+ * Usage: dir-load-bench [n_files]...
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glib/gprintf.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "mime-type/mime-type.h"
+
+#define VFS_DIR_DENTS_BUF_SIZE (256 * 1024) /* as in vfs-dir.c */
+#define N_RUNS                 3
+
+typedef struct
+{
+    char* name;
+    struct stat file_stat;
+    const char* mime_type;
+} BenchFile;
+
+struct linux_dirent64
+{
+    guint64 d_ino;
+    gint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+static const char* const suffixes[] = {".txt", ".png", ".c", ".h", ".pdf", ".jpg", ".o", ""};
+
+static void make_files(const char* dir_path, uint n_files)
+{
+    uint i;
+    for (i = 0; i < n_files; ++i)
+    {
+        char* path = g_strdup_printf("%s/spool-%07u%s", dir_path, i, suffixes[i % G_N_ELEMENTS(suffixes)]);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd == -1)
+        {
+            g_printf("cannot write %s\n", path);
+            exit(1);
+        }
+        close(fd);
+        g_free(path);
+    }
+}
+
+static BenchFile* new_file(const char* name, struct stat* file_stat)
+{
+    BenchFile* file = g_slice_new(BenchFile);
+    file->name = g_strdup(name);
+    file->file_stat = *file_stat;
+    file->mime_type = mime_type_get_by_filename(name, file_stat);
+    return file;
+}
+
+static void free_files(GList* files)
+{
+    GList* l;
+    for (l = files; l; l = l->next)
+    {
+        BenchFile* file = (BenchFile*)l->data;
+        g_free(file->name);
+        g_slice_free(BenchFile, file);
+    }
+    g_list_free(files);
+}
+
+/* vfs_dir_load_thread before */
+static GList* load_by_path(const char* dir_path)
+{
+    GList* files = NULL;
+    GDir* dir = g_dir_open(dir_path, 0, NULL);
+    const char* name;
+    struct stat file_stat;
+    while ((name = g_dir_read_name(dir)))
+    {
+        char* path = g_build_filename(dir_path, name, NULL);
+        if (lstat(path, &file_stat) == 0)
+            files = g_list_prepend(files, new_file(name, &file_stat));
+        g_free(path);
+    }
+    g_dir_close(dir);
+    return files;
+}
+
+/* vfs_dir_read_files */
+static GList* load_at(const char* dir_path)
+{
+    GList* files = NULL;
+    int dir_fd = open(dir_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    char* buf = g_malloc(VFS_DIR_DENTS_BUF_SIZE);
+    struct stat file_stat;
+    long nread;
+    while ((nread = syscall(SYS_getdents64, dir_fd, buf, VFS_DIR_DENTS_BUF_SIZE)) > 0)
+    {
+        long pos;
+        for (pos = 0; pos < nread;)
+        {
+            struct linux_dirent64* dent = (struct linux_dirent64*)(buf + pos);
+            pos += dent->d_reclen;
+            const char* name = dent->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                continue;
+            if (fstatat(dir_fd, name, &file_stat, AT_SYMLINK_NOFOLLOW) == 0)
+                files = g_list_prepend(files, new_file(name, &file_stat));
+        }
+    }
+    g_free(buf);
+    close(dir_fd);
+    return files;
+}
+
+/* Best of N_RUNS, with the dir in the page cache */
+static double time_load(GList* (*load)(const char*), const char* dir_path, uint* n_loaded)
+{
+    double best = 0;
+    int i;
+    for (i = 0; i < N_RUNS; ++i)
+    {
+        gint64 start = g_get_monotonic_time();
+        GList* files = load(dir_path);
+        double ms = (g_get_monotonic_time() - start) / 1000.0;
+        *n_loaded = g_list_length(files);
+        free_files(files);
+        if (i == 0 || ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+static void remove_files(const char* dir_path)
+{
+    GDir* dir = g_dir_open(dir_path, 0, NULL);
+    const char* name;
+    while ((name = g_dir_read_name(dir)))
+    {
+        char* path = g_build_filename(dir_path, name, NULL);
+        g_unlink(path);
+        g_free(path);
+    }
+    g_dir_close(dir);
+    g_rmdir(dir_path);
+}
+
+int main(int argc, char* argv[])
+{
+    static const uint default_sizes[] = {10000, 200000};
+    uint n_sizes = argc > 1 ? (uint)argc - 1 : G_N_ELEMENTS(default_sizes);
+    uint s;
+
+    mime_type_init();
+    for (s = 0; s < n_sizes; ++s)
+    {
+        uint n_files = argc > 1 ? strtoul(argv[s + 1], NULL, 10) : default_sizes[s];
+        char* dir_path = g_dir_make_tmp("spacefm-load-XXXXXX", NULL);
+        if (!dir_path)
+            return 1;
+        make_files(dir_path, n_files);
+
+        uint n_by_path, n_at;
+        load_at(dir_path); /* warm the page cache and the mime cache */
+        double by_path_ms = time_load(load_by_path, dir_path, &n_by_path);
+        double at_ms = time_load(load_at, dir_path, &n_at);
+        g_printf("%u files:\n", n_files);
+        g_printf("  g_dir_read_name + lstat:  %8.1f ms, %u files\n", by_path_ms, n_by_path);
+        g_printf("  getdents64 + fstatat:     %8.1f ms, %u files\n", at_ms, n_at);
+
+        remove_files(dir_path);
+        g_free(dir_path);
+        if (n_by_path != n_files || n_at != n_files)
+            return 1;
+    }
+    mime_type_finalize();
+    return 0;
+}
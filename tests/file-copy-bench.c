@@ -0,0 +1,186 @@
+/*
+ *  file-copy-bench.c
+ *
+ * Description: Throughput of the methods copy_file_data of vfs-file-task.c
+ * tries in turn, and of the 4 KiB read/write loop used before, across file
+ * sizes.  The source is in the page cache and the copy isn't synced, as
+ * when the progress of a copy is shown.  The copies are made next to the
+ * source, in the dir given or under the tmp dir.
+ *
+ * Usage: file-copy-bench [dir]
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glib/gprintf.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+
+#define COPY_CHUNK_SIZE  (8 * 1024 * 1024) /* as in vfs-file-task.c */
+#define COPY_BUFFER_SIZE (1024 * 1024)
+#define OLD_BUFFER_SIZE  4096
+#define MIN_BYTES        (256 * 1024 * 1024) /* copied per method and size, in as many files as needed */
+
+typedef enum
+{
+    COPY_OLD_READ_WRITE,
+    COPY_REFLINK,
+    COPY_FILE_RANGE,
+    COPY_SENDFILE,
+    COPY_READ_WRITE
+} CopyMethod;
+
+static const char* const method_names[] = {"read/write 4 KiB (before)", "FICLONE reflink", "copy_file_range 8 MiB",
+                                           "sendfile 8 MiB", "read/write 1 MiB"};
+
+/* Returns FALSE if the method isn't supported or fails */
+static gboolean copy_read_write(int rfd, int wfd, char* buffer, size_t buffer_size)
+{
+    ssize_t rsize;
+    while ((rsize = read(rfd, buffer, buffer_size)) != 0)
+    {
+        if (rsize < 0)
+            return FALSE;
+        ssize_t written = 0;
+        while (written < rsize)
+        {
+            ssize_t wsize = write(wfd, buffer + written, rsize - written);
+            if (wsize <= 0)
+                return FALSE;
+            written += wsize;
+        }
+    }
+    return TRUE;
+}
+
+static gboolean copy_kernel(int rfd, int wfd, off_t size, gboolean use_sendfile)
+{
+    off_t copied = 0;
+    while (copied < size)
+    {
+        ssize_t n = use_sendfile ? sendfile(wfd, rfd, NULL, COPY_CHUNK_SIZE)
+                                 : syscall(SYS_copy_file_range, rfd, NULL, wfd, NULL, COPY_CHUNK_SIZE, 0);
+        if (n <= 0)
+            return FALSE;
+        copied += n;
+    }
+    return TRUE;
+}
+
+static gboolean copy_file(CopyMethod method, const char* src, const char* dest, off_t size, char* buffer)
+{
+    int rfd = open(src, O_RDONLY | O_CLOEXEC);
+    int wfd = open(dest, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    gboolean ok = FALSE;
+    if (rfd != -1 && wfd != -1)
+    {
+        switch (method)
+        {
+        case COPY_OLD_READ_WRITE:
+            ok = copy_read_write(rfd, wfd, buffer, OLD_BUFFER_SIZE);
+            break;
+        case COPY_REFLINK:
+            ok = ioctl(wfd, FICLONE, rfd) == 0;
+            break;
+        case COPY_FILE_RANGE:
+            ok = copy_kernel(rfd, wfd, size, FALSE);
+            break;
+        case COPY_SENDFILE:
+            ok = copy_kernel(rfd, wfd, size, TRUE);
+            break;
+        case COPY_READ_WRITE:
+            ok = copy_read_write(rfd, wfd, buffer, COPY_BUFFER_SIZE);
+            break;
+        }
+    }
+    if (rfd != -1)
+        close(rfd);
+    if (wfd != -1)
+        close(wfd);
+    g_unlink(dest);
+    return ok;
+}
+
+static void make_file(const char* path, off_t size, char* buffer)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    off_t written = 0;
+    while (fd != -1 && written < size)
+    {
+        size_t n = MIN((off_t)COPY_BUFFER_SIZE, size - written);
+        memset(buffer, (int)(written / COPY_BUFFER_SIZE) & 0xff, n);
+        if (write(fd, buffer, n) != (ssize_t)n)
+            break;
+        written += n;
+    }
+    if (fd == -1 || written < size)
+    {
+        g_printf("cannot write %s\n", path);
+        exit(1);
+    }
+    close(fd);
+}
+
+static double cpu_ms()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
+
+int main(int argc, char* argv[])
+{
+    static const off_t sizes[] = {4 * 1024, 1024 * 1024, 64 * 1024 * 1024, 512 * 1024 * 1024};
+    char* dir = argc > 1 ? g_strdup(argv[1]) : g_dir_make_tmp("spacefm-copy-XXXXXX", NULL);
+    char* src = g_build_filename(dir, "src", NULL);
+    char* dest = g_build_filename(dir, "dest", NULL);
+    char* buffer = g_malloc(COPY_BUFFER_SIZE);
+    uint s;
+    int m;
+
+    for (s = 0; s < G_N_ELEMENTS(sizes); ++s)
+    {
+        off_t size = sizes[s];
+        uint n_copies = MAX(1, MIN_BYTES / size);
+        make_file(src, size, buffer);
+        g_printf("%u files of %ld KiB:\n", n_copies, (long)(size / 1024));
+        for (m = COPY_OLD_READ_WRITE; m <= COPY_READ_WRITE; ++m)
+        {
+            gboolean ok = copy_file((CopyMethod)m, src, dest, size, buffer); /* warm */
+            double cpu_start = cpu_ms();
+            gint64 start = g_get_monotonic_time();
+            uint i;
+            for (i = 0; ok && i < n_copies; ++i)
+                ok = copy_file((CopyMethod)m, src, dest, size, buffer);
+            double ms = (g_get_monotonic_time() - start) / 1000.0;
+            double cpu = cpu_ms() - cpu_start;
+            if (ok)
+                g_printf("  %-26s %8.1f MiB/s, %7.1f ms, cpu %7.1f ms\n", method_names[m],
+                         (double)size * n_copies / (1024 * 1024) / (ms / 1000), ms, cpu);
+            else
+                g_printf("  %-26s not supported here (%s)\n", method_names[m], g_strerror(errno));
+        }
+    }
+
+    g_unlink(src);
+    if (argc <= 1)
+        g_rmdir(dir);
+    g_free(buffer);
+    g_free(src);
+    g_free(dest);
+    g_free(dir);
+    return 0;
+}
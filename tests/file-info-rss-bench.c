@@ -0,0 +1,198 @@
+/*
+ *  file-info-rss-bench.c
+ *
+ * Description: RSS of the VFSFileInfo of a large dir, with the layout and
+ * allocations before the struct was shrunk, and as now.  Before, each name
+ * was a malloc of its own, and the size, mtime and owner strings were
+ * cached per file once shown.  Now the names of a load are packed in a
+ * VFSFileInfoArena, the size and mtime are formatted when drawn and the
+ * owner string is interned.  The layouts are copied from vfs-file-info.h,
+ * which needs GTK.  Each variant runs in a child so its RSS is its own.
+ *
+ * Usage: file-info-rss-bench [n_files]...
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/* before */
+typedef struct
+{
+    mode_t mode;
+    dev_t dev;
+    uid_t uid;
+    gid_t gid;
+    off_t size;
+    time_t mtime;
+    time_t atime;
+    long blksize;
+    blkcnt_t blocks;
+
+    char* name;
+    char* disp_name;
+    char* collate_key;
+    char* collate_icase_key;
+    char* disp_size;
+    char* disp_owner;
+    char* disp_mtime;
+    char disp_perm[12];
+    gpointer mime_type;
+    gpointer big_thumbnail;
+    gpointer small_thumbnail;
+
+    int flags;
+    int n_ref;
+} OldFileInfo;
+
+/* now */
+typedef struct
+{
+    mode_t mode;
+    uid_t uid;
+    gid_t gid;
+    int flags;
+    off_t size;
+    time_t mtime;
+    guint32 mtime_nsec;
+
+    char* name;
+    char* disp_name;
+    gpointer arena;
+    char* collate_key;
+    char* collate_icase_key;
+    const char* disp_owner;
+    gpointer mime_type;
+    gpointer big_thumbnail;
+    gpointer small_thumbnail;
+    char disp_perm[12];
+
+    int n_ref;
+} NewFileInfo;
+
+static long rss_kib()
+{
+    long pages = 0;
+    char* contents;
+    if (g_file_get_contents("/proc/self/statm", &contents, NULL, NULL))
+    {
+        sscanf(contents, "%*s %ld", &pages);
+        g_free(contents);
+    }
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void make_name(char* buf, size_t size, uint i)
+{
+    g_snprintf(buf, size, "IMG_%07u_export.jpg", i);
+}
+
+static void run_old(uint n_files, long rss_start)
+{
+    GPtrArray* files = g_ptr_array_sized_new(n_files);
+    char name[64];
+    char buf[64];
+    uint i;
+    for (i = 0; i < n_files; ++i)
+    {
+        OldFileInfo* fi = g_slice_new0(OldFileInfo);
+        make_name(name, sizeof(name), i);
+        fi->name = g_strdup(name);
+        fi->disp_name = fi->name;
+        fi->size = 1000 + i;
+        fi->mtime = 1700000000 + i;
+        fi->n_ref = 1;
+        g_ptr_array_add(files, fi);
+    }
+    long rss_loaded = rss_kib();
+
+    /* every row drawn once in the detailed view */
+    for (i = 0; i < n_files; ++i)
+    {
+        OldFileInfo* fi = (OldFileInfo*)g_ptr_array_index(files, i);
+        g_snprintf(buf, sizeof(buf), "%.1f K", fi->size / 1024.0);
+        fi->disp_size = g_strdup(buf);
+        g_snprintf(buf, sizeof(buf), "2023-11-14 %02u:%02u", (uint)(fi->mtime / 60 % 24), (uint)(fi->mtime % 60));
+        fi->disp_mtime = g_strdup(buf);
+        fi->disp_owner = g_strdup("user:users");
+    }
+    g_printf("  before: %3zu byte struct, listed %8ld KiB, all rows shown %8ld KiB\n", sizeof(OldFileInfo),
+             rss_loaded - rss_start, rss_kib() - rss_start);
+}
+
+static void run_new(uint n_files, long rss_start)
+{
+    GPtrArray* files = g_ptr_array_sized_new(n_files);
+    GStringChunk* names = g_string_chunk_new(16384); /* vfs_file_info_arena_new */
+    char name[64];
+    char buf[64];
+    uint i;
+    for (i = 0; i < n_files; ++i)
+    {
+        NewFileInfo* fi = g_slice_new0(NewFileInfo);
+        make_name(name, sizeof(name), i);
+        fi->name = g_string_chunk_insert(names, name);
+        fi->arena = names;
+        fi->disp_name = fi->name;
+        fi->size = 1000 + i;
+        fi->mtime = 1700000000 + i;
+        fi->n_ref = 1;
+        g_ptr_array_add(files, fi);
+    }
+    long rss_loaded = rss_kib();
+
+    /* size and mtime are formatted into the caller's buffer */
+    guint64 len = 0;
+    for (i = 0; i < n_files; ++i)
+    {
+        NewFileInfo* fi = (NewFileInfo*)g_ptr_array_index(files, i);
+        len += g_snprintf(buf, sizeof(buf), "%.1f K", fi->size / 1024.0);
+        len += g_snprintf(buf, sizeof(buf), "2023-11-14 %02u:%02u", (uint)(fi->mtime / 60 % 24),
+                          (uint)(fi->mtime % 60));
+        fi->disp_owner = g_intern_string("user:users");
+    }
+    g_printf("  now:    %3zu byte struct, listed %8ld KiB, all rows shown %8ld KiB\n", sizeof(NewFileInfo),
+             rss_loaded - rss_start, rss_kib() - rss_start);
+    (void)len;
+}
+
+int main(int argc, char* argv[])
+{
+    static const uint default_sizes[] = {100000, 500000};
+    uint n_sizes = argc > 1 ? (uint)argc - 1 : G_N_ELEMENTS(default_sizes);
+    uint s;
+    int v;
+    for (s = 0; s < n_sizes; ++s)
+    {
+        uint n_files = argc > 1 ? strtoul(argv[s + 1], NULL, 10) : default_sizes[s];
+        g_printf("%u files:\n", n_files);
+        for (v = 0; v < 2; ++v)
+        {
+            fflush(stdout);
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                long rss_start = rss_kib();
+                if (v == 0)
+                    run_old(n_files, rss_start);
+                else
+                    run_new(n_files, rss_start);
+                fflush(stdout);
+                _exit(0);
+            }
+            int status;
+            if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,217 @@
+/*
+ *  file-list-model-bench.c
+ *
+ * Description: Compares the row storage of PtkFileList, a sorted GList
+ * scanned for each row as before, and a GSequence indexed by file and by
+ * name as now.  Rows are plain names sorted with strcmp, without the view,
+ * so only the cost of the model itself is measured.
+ *
+ * Usage: file-list-model-bench [n_rows]...
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#define N_CREATED 1000
+#define N_LOOKUPS 1000
+
+typedef struct
+{
+    char* name;
+} Row;
+
+typedef struct
+{
+    GSequence* files;
+    GHashTable* file_iters;
+    GHashTable* name_rows;
+} IndexedModel;
+
+static int compare_rows(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    return strcmp(((const Row*)a)->name, ((const Row*)b)->name);
+}
+
+static Row** make_rows(uint n_rows)
+{
+    Row** rows = g_new(Row*, n_rows);
+    uint i;
+    for (i = 0; i < n_rows; ++i)
+    {
+        rows[i] = g_new(Row, 1);
+        rows[i]->name = g_strdup_printf("file-%08x-%u", g_random_int(), i);
+    }
+    return rows;
+}
+
+static double ms_since(gint64 start)
+{
+    return (g_get_monotonic_time() - start) / 1000.0;
+}
+
+static size_t heap_used()
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+/* ptk_file_list_file_created before: a scan for the same row or name,
+ * stopping at the insert position only when no name can match later */
+static GList* glist_created(GList* files, Row* row)
+{
+    GList* l;
+    GList* pos = NULL;
+    for (l = files; l; l = l->next)
+    {
+        Row* row2 = (Row*)l->data;
+        if (row2 == row || !strcmp(row2->name, row->name))
+            return files;
+        if (!pos && compare_rows(row2, row, NULL) > 0)
+            pos = l;
+    }
+    return g_list_insert_before(files, pos, row);
+}
+
+static void bench_glist(Row** rows, Row** created, uint n_rows)
+{
+    GList* files = NULL;
+    uint i;
+    gint64 start = g_get_monotonic_time();
+    for (i = 0; i < n_rows; ++i)
+        files = g_list_prepend(files, rows[i]);
+    files = g_list_sort_with_data(files, compare_rows, NULL);
+    double load_ms = ms_since(start);
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < N_CREATED; ++i)
+        files = glist_created(files, created[i]);
+    double created_ms = ms_since(start);
+
+    start = g_get_monotonic_time();
+    guint64 sum = 0;
+    for (i = 0; i < N_LOOKUPS; ++i)
+    {
+        /* get_iter, then get_path of the row */
+        Row* row = (Row*)g_list_nth_data(files, g_random_int_range(0, n_rows));
+        sum += g_list_index(files, row);
+    }
+    double lookup_ms = ms_since(start);
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < N_CREATED; ++i)
+        files = g_list_remove(files, created[i]);
+    double deleted_ms = ms_since(start);
+
+    g_printf("  GList:            load %8.1f ms, %u created %8.1f ms, %u lookups %8.1f ms, %u deleted %8.1f ms\n",
+             load_ms, N_CREATED, created_ms, N_LOOKUPS, lookup_ms, N_CREATED, deleted_ms);
+    g_list_free(files);
+    (void)sum;
+}
+
+static void indexed_add(IndexedModel* model, Row* row, GSequenceIter* l)
+{
+    g_hash_table_insert(model->file_iters, row, l);
+    g_hash_table_insert(model->name_rows, g_strdup(row->name), row);
+}
+
+static void bench_indexed(Row** rows, Row** created, uint n_rows)
+{
+    IndexedModel model;
+    uint i;
+    size_t heap_before = heap_used();
+    gint64 start = g_get_monotonic_time();
+    model.files = g_sequence_new(NULL);
+    model.file_iters = g_hash_table_new(g_direct_hash, g_direct_equal);
+    model.name_rows = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for (i = 0; i < n_rows; ++i)
+        indexed_add(&model, rows[i], g_sequence_prepend(model.files, rows[i]));
+    g_sequence_sort(model.files, compare_rows, NULL);
+    double load_ms = ms_since(start);
+    size_t heap_after = heap_used();
+
+    /* the name index alone */
+    size_t names_before = heap_used();
+    GHashTable* names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for (i = 0; i < n_rows; ++i)
+        g_hash_table_insert(names, g_strdup(rows[i]->name), rows[i]);
+    size_t names_after = heap_used();
+    g_hash_table_destroy(names);
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < N_CREATED; ++i)
+    {
+        Row* row = created[i];
+        if (g_hash_table_contains(model.file_iters, row) || g_hash_table_lookup(model.name_rows, row->name))
+            continue;
+        indexed_add(&model, row, g_sequence_insert_sorted(model.files, row, compare_rows, NULL));
+    }
+    double created_ms = ms_since(start);
+
+    start = g_get_monotonic_time();
+    guint64 sum = 0;
+    for (i = 0; i < N_LOOKUPS; ++i)
+    {
+        GSequenceIter* l = g_sequence_get_iter_at_pos(model.files, g_random_int_range(0, n_rows));
+        sum += g_sequence_iter_get_position(l);
+    }
+    double lookup_ms = ms_since(start);
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < N_CREATED; ++i)
+    {
+        Row* row = created[i];
+        GSequenceIter* l = g_hash_table_lookup(model.file_iters, row);
+        g_hash_table_remove(model.file_iters, row);
+        g_hash_table_remove(model.name_rows, row->name);
+        g_sequence_remove(l);
+    }
+    double deleted_ms = ms_since(start);
+
+    g_printf("  GSequence+hashes: load %8.1f ms, %u created %8.1f ms, %u lookups %8.1f ms, %u deleted %8.1f ms\n",
+             load_ms, N_CREATED, created_ms, N_LOOKUPS, lookup_ms, N_CREATED, deleted_ms);
+    g_printf("  model %zu bytes per row, of which the name index %zu\n",
+             (heap_after - heap_before) / n_rows, (names_after - names_before) / n_rows);
+    g_hash_table_destroy(model.name_rows);
+    g_hash_table_destroy(model.file_iters);
+    g_sequence_free(model.files);
+    (void)sum;
+}
+
+static void free_rows(Row** rows, uint n_rows)
+{
+    uint i;
+    for (i = 0; i < n_rows; ++i)
+    {
+        g_free(rows[i]->name);
+        g_free(rows[i]);
+    }
+    g_free(rows);
+}
+
+int main(int argc, char* argv[])
+{
+    static const uint default_sizes[] = {10000, 100000};
+    uint n_sizes = argc > 1 ? (uint)argc - 1 : G_N_ELEMENTS(default_sizes);
+    uint s;
+    for (s = 0; s < n_sizes; ++s)
+    {
+        uint n_rows = argc > 1 ? strtoul(argv[s + 1], NULL, 10) : default_sizes[s];
+        if (!n_rows)
+            continue;
+        Row** rows = make_rows(n_rows);
+        Row** created = make_rows(N_CREATED);
+        g_printf("%u rows:\n", n_rows);
+        bench_glist(rows, created, n_rows);
+        bench_indexed(rows, created, n_rows);
+        free_rows(rows, n_rows);
+        free_rows(created, N_CREATED);
+    }
+    return 0;
+}
@@ -0,0 +1,281 @@
+/*
+ *  find-content-bench.c
+ *
+ * Description: Times the content search of Find Files against the find &
+ * grep command line it replaced, on a synthetic tree of text files with a
+ * few binary files and files of one long line.  The in-process search walks
+ * the tree in one thread and tests each file with find_content_match.
+ *
+ * Usage: find-content-bench [n_dirs] [files_per_dir]
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glib/gprintf.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <regex.h>
+#include <sys/resource.h>
+
+#include "find-content.h"
+
+#define DEFAULT_N_DIRS      100
+#define DEFAULT_N_FILES     100
+#define N_LONG_LINES        4
+#define LONG_LINE_SIZE      (16 * 1024 * 1024)
+#define NEEDLE              "NeedleWord"
+
+typedef struct
+{
+    const char* name;
+    const char* pattern;
+    gboolean fixed;
+    gboolean icase;
+} BenchQuery;
+
+static const BenchQuery queries[] = {
+    {"fixed, case sensitive", NEEDLE, TRUE, FALSE},
+    {"fixed, ignore case", "needleword", TRUE, TRUE},
+    {"regex", "Need[a-z]*Word", FALSE, FALSE},
+};
+
+static void write_file(const char* path, const char* data, size_t len)
+{
+    if (!g_file_set_contents(path, data, len, NULL))
+    {
+        g_printf("cannot write %s\n", path);
+        exit(1);
+    }
+}
+
+/* text files of 40 to 400 lines, one in 10 with the needle; one in 20 is
+ * binary, with the needle after a nul byte in half of them */
+static uint make_tree(const char* root, uint n_dirs, uint n_files)
+{
+    GString* data = g_string_sized_new(64 * 1024);
+    uint n_matches = 0;
+    uint d, f, i;
+
+    for (d = 0; d < n_dirs; ++d)
+    {
+        char* dir_path = g_strdup_printf("%s/dir-%04u", root, d);
+        g_mkdir(dir_path, 0755);
+        for (f = 0; f < n_files; ++f)
+        {
+            uint n = d * n_files + f;
+            char* path = g_strdup_printf("%s/file-%04u", dir_path, f);
+            g_string_truncate(data, 0);
+            if (n % 20 == 7)
+            {
+                for (i = 0; i < 8192; ++i)
+                    g_string_append_c(data, (char)(g_random_int() & (i % 64 ? 0xff : 0)));
+                if (n % 40 == 7)
+                {
+                    g_string_append_len(data, "\0" NEEDLE "\0", sizeof(NEEDLE) + 1);
+                    ++n_matches;
+                }
+            }
+            else
+            {
+                uint n_lines = 40 + g_random_int_range(0, 360);
+                for (i = 0; i < n_lines; ++i)
+                    g_string_append_printf(data, "line %u of file %u: the quick brown fox jumps over the lazy dog\n",
+                                           i, n);
+                if (n % 10 == 3)
+                {
+                    g_string_append(data, "found the " NEEDLE " here\n");
+                    ++n_matches;
+                }
+            }
+            write_file(path, data->str, data->len);
+            g_free(path);
+        }
+        g_free(dir_path);
+    }
+
+    /* minified files, the needle in the middle of the only line.  Written
+     * in pieces, so that the peak RSS is that of the search. */
+    g_string_truncate(data, 0);
+    while (data->len < 64 * 1024)
+        g_string_append(data, "var a=function(b){return b+1};");
+    for (i = 0; i < N_LONG_LINES; ++i)
+    {
+        char* path = g_strdup_printf("%s/long-%u.min.js", root, i);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        size_t size;
+        gboolean needle = i % 2 == 0;
+        for (size = 0; fd >= 0 && size < LONG_LINE_SIZE; size += data->len)
+        {
+            if (needle && size >= LONG_LINE_SIZE / 2)
+            {
+                if (write(fd, NEEDLE ";", sizeof(NEEDLE)) < 0)
+                    break;
+                needle = FALSE;
+            }
+            if (write(fd, data->str, data->len) < 0)
+                break;
+        }
+        if (fd < 0 || size < LONG_LINE_SIZE)
+        {
+            g_printf("cannot write %s\n", path);
+            exit(1);
+        }
+        close(fd);
+        n_matches += i % 2 == 0;
+        g_free(path);
+    }
+    g_string_free(data, TRUE);
+    return n_matches;
+}
+
+static uint search_dir(FindContent* fc, const char* dir_path, const int* cancel)
+{
+    uint n_found = 0;
+    int dir_fd = open(dir_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR* dp = dir_fd < 0 ? NULL : fdopendir(dir_fd);
+    struct dirent* ent;
+    if (!dp)
+        return 0;
+    while ((ent = readdir(dp)))
+    {
+        if (ent->d_name[0] == '.')
+            continue;
+        if (ent->d_type == DT_DIR)
+        {
+            char* path = g_build_filename(dir_path, ent->d_name, NULL);
+            n_found += search_dir(fc, path, cancel);
+            g_free(path);
+        }
+        else if (ent->d_type == DT_REG)
+        {
+            int fd = openat(dir_fd, ent->d_name, O_RDONLY | O_NOCTTY | O_CLOEXEC);
+            if (fd >= 0)
+            {
+                n_found += find_content_match(fc, fd, cancel);
+                close(fd);
+            }
+        }
+    }
+    closedir(dp);
+    return n_found;
+}
+
+/* the tests of search_thread, in one thread */
+static uint search_in_process(const char* root, const BenchQuery* query)
+{
+    static const int cancel = 0;
+    int flags = REG_NOSUB | REG_NEWLINE | (query->icase ? REG_ICASE : 0);
+    FindContent* fc = find_content_new(query->pattern, query->fixed, query->pattern, flags);
+    uint n_found = search_dir(fc, root, &cancel);
+    find_content_free(fc);
+    return n_found;
+}
+
+/* the command line used before, grep run for each file */
+static uint search_find_grep(const char* root, const BenchQuery* query, gboolean batched)
+{
+    char* argv[16];
+    char* envp[] = {"LC_ALL=C", NULL};
+    char* out = NULL;
+    int i = 0;
+    argv[i++] = "find";
+    argv[i++] = "-H";
+    argv[i++] = (char*)root;
+    argv[i++] = "-type";
+    argv[i++] = "f";
+    argv[i++] = "-exec";
+    argv[i++] = "grep";
+    if (query->icase)
+        argv[i++] = "-i";
+    argv[i++] = "--files-with-matches";
+    argv[i++] = query->fixed ? "--fixed-strings" : "--regexp";
+    argv[i++] = (char*)query->pattern;
+    argv[i++] = "{}";
+    argv[i++] = batched ? "+" : ";";
+    argv[i] = NULL;
+    if (!g_spawn_sync(NULL, argv, envp, G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL, NULL, NULL, &out, NULL,
+                      NULL, NULL))
+        return 0;
+    uint n_found = 0;
+    char* p;
+    for (p = out; *p; ++p)
+        n_found += *p == '\n';
+    g_free(out);
+    return n_found;
+}
+
+static void remove_tree(const char* path)
+{
+    GDir* dir = g_dir_open(path, 0, NULL);
+    if (dir)
+    {
+        const char* name;
+        while ((name = g_dir_read_name(dir)))
+        {
+            char* child = g_build_filename(path, name, NULL);
+            remove_tree(child);
+            g_free(child);
+        }
+        g_dir_close(dir);
+        g_rmdir(path);
+    }
+    else
+        g_unlink(path);
+}
+
+static double ms_since(gint64 start)
+{
+    return (g_get_monotonic_time() - start) / 1000.0;
+}
+
+int main(int argc, char* argv[])
+{
+    uint n_dirs = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_N_DIRS;
+    uint n_files = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_N_FILES;
+    char* root = g_dir_make_tmp("spacefm-find-XXXXXX", NULL);
+    int ret = 0;
+    uint q;
+    if (!root)
+        return 1;
+
+    uint n_matches = make_tree(root, n_dirs, n_files);
+    g_printf("%u files in %u dirs and %u lines of %u MiB, %u matching\n", n_dirs * n_files, n_dirs, N_LONG_LINES,
+             LONG_LINE_SIZE / (1024 * 1024), n_matches);
+    search_find_grep(root, &queries[0], TRUE); /* warm the page cache */
+
+    for (q = 0; q < G_N_ELEMENTS(queries); ++q)
+    {
+        const BenchQuery* query = &queries[q];
+        gint64 start = g_get_monotonic_time();
+        uint n_in_process = search_in_process(root, query);
+        double in_process_ms = ms_since(start);
+        start = g_get_monotonic_time();
+        uint n_per_file = search_find_grep(root, query, FALSE);
+        double per_file_ms = ms_since(start);
+        start = g_get_monotonic_time();
+        uint n_batched = search_find_grep(root, query, TRUE);
+        double batched_ms = ms_since(start);
+
+        g_printf("%s:\n", query->name);
+        g_printf("  in-process:              %8.1f ms, %u found\n", in_process_ms, n_in_process);
+        g_printf("  find -exec grep {} \\;:   %8.1f ms, %u found\n", per_file_ms, n_per_file);
+        g_printf("  find -exec grep {} +:    %8.1f ms, %u found\n", batched_ms, n_batched);
+        if (n_in_process != n_matches || n_per_file != n_matches)
+            ret = 1;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    g_printf("peak RSS %ld KiB\n", usage.ru_maxrss);
+
+    remove_tree(root);
+    g_free(root);
+    return ret;
+}
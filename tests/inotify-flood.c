@@ -0,0 +1,146 @@
+/*
+ *  inotify-flood.c
+ *
+ * Description: Floods the inotify queue of a monitored dir so that the
+ * kernel drops events, and checks that VFSFileMonitor reports the
+ * overflow for the dir, then keeps delivering events.
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "vfs/vfs-file-monitor.h"
+
+#define FLOOD_MARGIN 1024
+#define WAIT_TIMEOUT 5 /* s */
+#define AFTER_NAME   "after-overflow"
+
+typedef struct
+{
+    char* dir_path;
+    gboolean overflowed;
+    uint n_creates;
+    gboolean after_seen;
+    gboolean overflow_path_ok;
+} FloodData;
+
+static void on_monitor_event(VFSFileMonitor* fm, VFSFileMonitorEvent event, const char* file_name, gpointer user_data)
+{
+    FloodData* data = (FloodData*)user_data;
+    switch (event)
+    {
+    case VFS_FILE_MONITOR_OVERFLOW:
+        data->overflowed = TRUE;
+        data->overflow_path_ok = !strcmp(file_name, fm->path);
+        break;
+    case VFS_FILE_MONITOR_CREATE:
+        ++data->n_creates;
+        if (!strcmp(file_name, AFTER_NAME))
+            data->after_seen = TRUE;
+        break;
+    default:
+        break;
+    }
+}
+
+static uint get_max_queued_events()
+{
+    char* contents;
+    uint max_events = 0;
+    if (g_file_get_contents("/proc/sys/fs/inotify/max_queued_events", &contents, NULL, NULL))
+    {
+        max_events = strtoul(contents, NULL, 10);
+        g_free(contents);
+    }
+    return max_events ? max_events : 16384;
+}
+
+static void create_file(const char* dir_path, const char* name)
+{
+    char* path = g_build_filename(dir_path, name, NULL);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    g_assert_cmpint(fd, !=, -1);
+    close(fd);
+    g_free(path);
+}
+
+/* Run the main loop until cond is set or the wait times out */
+static void wait_for(gboolean* cond)
+{
+    gint64 end = g_get_monotonic_time() + WAIT_TIMEOUT * G_USEC_PER_SEC;
+    while (!*cond && g_get_monotonic_time() < end)
+        g_main_context_iteration(NULL, FALSE);
+}
+
+static void remove_dir(const char* dir_path)
+{
+    GDir* dir = g_dir_open(dir_path, 0, NULL);
+    if (dir)
+    {
+        const char* name;
+        while ((name = g_dir_read_name(dir)))
+        {
+            char* path = g_build_filename(dir_path, name, NULL);
+            g_unlink(path);
+            g_free(path);
+        }
+        g_dir_close(dir);
+    }
+    g_rmdir(dir_path);
+}
+
+static void test_flood()
+{
+    FloodData data = {0};
+    data.dir_path = g_dir_make_tmp("spacefm-flood-XXXXXX", NULL);
+    g_assert_nonnull(data.dir_path);
+
+    VFSFileMonitor* monitor = vfs_file_monitor_add_dir(data.dir_path, on_monitor_event, &data);
+    g_assert_nonnull(monitor);
+
+    /* more events than the kernel queues while the main loop isn't run */
+    uint n_files = get_max_queued_events() + FLOOD_MARGIN;
+    uint i;
+    for (i = 0; i < n_files; ++i)
+    {
+        char name[32];
+        g_snprintf(name, sizeof(name), "flood-%u", i);
+        create_file(data.dir_path, name);
+    }
+
+    wait_for(&data.overflowed);
+    g_test_message("%u files created, %u create events before the overflow", n_files, data.n_creates);
+
+    g_assert_true(data.overflowed);
+    g_assert_true(data.overflow_path_ok);
+    g_assert_cmpuint(data.n_creates, <, n_files);
+
+    /* the watch survives the overflow */
+    create_file(data.dir_path, AFTER_NAME);
+    wait_for(&data.after_seen);
+    g_assert_true(data.after_seen);
+
+    vfs_file_monitor_remove(monitor, on_monitor_event, &data);
+    remove_dir(data.dir_path);
+    g_free(data.dir_path);
+}
+
+int main(int argc, char* argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    /* skipped, see the meson test() doc */
+    if (!vfs_file_monitor_init())
+        return 77;
+    g_test_add_func("/vfs-file-monitor/flood", test_flood);
+    int ret = g_test_run();
+    vfs_file_monitor_clean();
+    return ret;
+}
@@ -0,0 +1,127 @@
+/*
+ *  inotify-storm-bench.c
+ *
+ * Description: Times the dispatch of inotify events by VFSFileMonitor with
+ * many watches, as with many tabs open.  Files are created and deleted
+ * round robin in the monitored dirs, in batches the kernel queue holds,
+ * and only the main loop iterations reading and dispatching the events
+ * are timed.
+ *
+ * Usage: inotify-storm-bench [n_watches]...
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glib/gprintf.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "vfs/vfs-file-monitor.h"
+
+#define N_FILES      10000 /* each created and deleted */
+#define BATCH_FILES  2000  /* well below max_queued_events */
+#define WAIT_TIMEOUT 5     /* s */
+
+typedef struct
+{
+    uint n_events;
+    gint64 dispatch_time; /* us */
+} StormData;
+
+static void on_monitor_event(VFSFileMonitor* fm, VFSFileMonitorEvent event, const char* file_name, gpointer user_data)
+{
+    StormData* data = (StormData*)user_data;
+    if (event == VFS_FILE_MONITOR_CREATE || event == VFS_FILE_MONITOR_DELETE)
+        ++data->n_events;
+}
+
+/* Dispatch the events of the last batch */
+static void dispatch(StormData* data, uint n_expected)
+{
+    gint64 end = g_get_monotonic_time() + WAIT_TIMEOUT * G_USEC_PER_SEC;
+    while (data->n_events < n_expected && g_get_monotonic_time() < end)
+    {
+        gint64 start = g_get_monotonic_time();
+        gboolean dispatched = g_main_context_iteration(NULL, FALSE);
+        if (dispatched)
+            data->dispatch_time += g_get_monotonic_time() - start;
+    }
+}
+
+static void run(uint n_watches)
+{
+    char* root = g_dir_make_tmp("spacefm-storm-XXXXXX", NULL);
+    char** dirs = g_new0(char*, n_watches);
+    VFSFileMonitor** monitors = g_new0(VFSFileMonitor*, n_watches);
+    StormData data = {0};
+    uint i, batch;
+
+    for (i = 0; i < n_watches; ++i)
+    {
+        dirs[i] = g_strdup_printf("%s/tab-%05u", root, i);
+        g_mkdir(dirs[i], 0755);
+        monitors[i] = vfs_file_monitor_add_dir(dirs[i], on_monitor_event, &data);
+        if (!monitors[i])
+        {
+            g_printf("cannot watch %s\n", dirs[i]);
+            exit(1);
+        }
+    }
+
+    for (batch = 0; batch < N_FILES; batch += BATCH_FILES)
+    {
+        for (i = batch; i < batch + BATCH_FILES; ++i)
+        {
+            char* path = g_strdup_printf("%s/file-%05u", dirs[i % n_watches], i);
+            int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd != -1)
+                close(fd);
+            g_free(path);
+        }
+        dispatch(&data, data.n_events + BATCH_FILES);
+        for (i = batch; i < batch + BATCH_FILES; ++i)
+        {
+            char* path = g_strdup_printf("%s/file-%05u", dirs[i % n_watches], i);
+            g_unlink(path);
+            g_free(path);
+        }
+        dispatch(&data, data.n_events + BATCH_FILES);
+    }
+
+    g_printf("%5u watches: %u events dispatched in %8.1f ms, %6.2f us each\n", n_watches, data.n_events,
+             data.dispatch_time / 1000.0, (double)data.dispatch_time / MAX(data.n_events, 1));
+
+    for (i = 0; i < n_watches; ++i)
+    {
+        vfs_file_monitor_remove(monitors[i], on_monitor_event, &data);
+        g_rmdir(dirs[i]);
+        g_free(dirs[i]);
+    }
+    g_free(dirs);
+    g_free(monitors);
+    g_rmdir(root);
+    g_free(root);
+}
+
+int main(int argc, char* argv[])
+{
+    static const uint default_sizes[] = {10, 100, 1000, 5000};
+    uint n_sizes = argc > 1 ? (uint)argc - 1 : G_N_ELEMENTS(default_sizes);
+    uint s;
+    if (!vfs_file_monitor_init())
+        return 77;
+    for (s = 0; s < n_sizes; ++s)
+    {
+        uint n_watches = argc > 1 ? strtoul(argv[s + 1], NULL, 10) : default_sizes[s];
+        if (n_watches)
+            run(n_watches);
+    }
+    vfs_file_monitor_clean();
+    return 0;
+}
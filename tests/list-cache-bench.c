@@ -0,0 +1,362 @@
+/*
+ *  list-cache-bench.c
+ *
+ * Description: Time until a dir on a slow network mount is shown, listed
+ * over the mount as without a saved listing, and loaded from
+ * vfs-list-cache then revalidated as now.  The slow filesystem is a local
+ * dir with a delay before every getdents64 and fstatat call, as the round
+ * trips of sshfs or NFS.  Also checks that saved listings are trimmed to
+ * VFS_LIST_CACHE_MAX_SIZE.
+ *
+ * The few VFSFileInfo functions the cache calls are defined here, since
+ * vfs-file-info.c pulls in the rest of the program.
+ *
+ * Usage: list-cache-bench [latency_us] [n_files]...
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glib/gprintf.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "vfs/vfs-file-info.h"
+#include "vfs/vfs-list-cache.h"
+
+#define DEFAULT_LATENCY        300 /* us per call */
+#define DENTS_BUF_SIZE         (256 * 1024)
+#define MAX_SIZE               (32 * 1024 * 1024) /* VFS_LIST_CACHE_MAX_SIZE */
+#define TRIM_DIRS              48
+#define TRIM_FILES_PER_DIR     16000
+
+struct _VFSFileInfoArena
+{
+    int n_ref;
+    GStringChunk* names;
+};
+
+struct linux_dirent64
+{
+    guint64 d_ino;
+    gint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+static GHashTable* mime_types; /* type => VFSMimeType */
+static uint latency;
+
+static const char* const suffixes[] = {".txt", ".png", ".c", ".pdf", ".jpg", ".tar.gz", ".odt", ""};
+static const char* const types[] = {"text/plain", "image/png", "text/x-csrc", "application/pdf", "image/jpeg",
+                                    "application/x-compressed-tar", "application/vnd.oasis.opendocument.text",
+                                    "application/octet-stream"};
+
+static VFSMimeType* get_mime_type(const char* type)
+{
+    VFSMimeType* mime_type = (VFSMimeType*)g_hash_table_lookup(mime_types, type);
+    if (!mime_type)
+    {
+        mime_type = g_slice_new0(VFSMimeType);
+        mime_type->type = g_strdup(type);
+        g_hash_table_insert(mime_types, mime_type->type, mime_type);
+    }
+    return mime_type;
+}
+
+VFSFileInfo* vfs_file_info_new()
+{
+    VFSFileInfo* fi = g_slice_new0(VFSFileInfo);
+    fi->n_ref = 1;
+    return fi;
+}
+
+void vfs_file_info_get_cached(VFSFileInfo* fi, const char* base_name, struct stat* file_stat, const char* mime_type,
+                              gboolean mime_pending, VFSFileInfoArena* arena)
+{
+    fi->name = g_string_chunk_insert(arena->names, base_name);
+    fi->disp_name = fi->name;
+    fi->mode = file_stat->st_mode;
+    fi->uid = file_stat->st_uid;
+    fi->gid = file_stat->st_gid;
+    fi->size = file_stat->st_size;
+    fi->mtime = file_stat->st_mtim.tv_sec;
+    fi->mtime_nsec = file_stat->st_mtim.tv_nsec;
+    fi->flags = mime_pending ? VFS_FILE_INFO_MIME_PENDING : VFS_FILE_INFO_NONE;
+    fi->mime_type = get_mime_type(mime_type);
+}
+
+void vfs_file_info_load_special_info(VFSFileInfo* fi, const char* file_path)
+{
+}
+
+const char* vfs_mime_type_get_type(VFSMimeType* mime_type)
+{
+    return mime_type->type;
+}
+
+static void slow_call()
+{
+    g_usleep(latency);
+}
+
+static void free_files(GList* files)
+{
+    GList* l;
+    for (l = files; l; l = l->next)
+        g_slice_free(VFSFileInfo, l->data);
+    g_list_free(files);
+}
+
+static const char* type_of(const char* name)
+{
+    uint i;
+    for (i = 0; i < G_N_ELEMENTS(suffixes) - 1; ++i)
+    {
+        if (g_str_has_suffix(name, suffixes[i]))
+            return types[i];
+    }
+    return types[i];
+}
+
+static VFSFileInfo* get_file(int dir_fd, const char* name, VFSFileInfoArena* arena)
+{
+    struct stat file_stat;
+    slow_call();
+    if (fstatat(dir_fd, name, &file_stat, AT_SYMLINK_NOFOLLOW) != 0)
+        return NULL;
+    VFSFileInfo* fi = vfs_file_info_new();
+    vfs_file_info_get_cached(fi, name, &file_stat, type_of(name), FALSE, arena);
+    return fi;
+}
+
+/* vfs_dir_read_files over the slow mount, saving the listing if listing */
+static GList* list_dir(int dir_fd, VFSFileInfoArena* arena, GString* listing, double* save_ms)
+{
+    char* buf = g_malloc(DENTS_BUF_SIZE);
+    GList* files = NULL;
+    gint64 save_time = 0;
+    long nread;
+    lseek(dir_fd, 0, SEEK_SET);
+    for (;;)
+    {
+        slow_call();
+        if ((nread = syscall(SYS_getdents64, dir_fd, buf, DENTS_BUF_SIZE)) <= 0)
+            break;
+        long pos;
+        for (pos = 0; pos < nread;)
+        {
+            struct linux_dirent64* dent = (struct linux_dirent64*)(buf + pos);
+            pos += dent->d_reclen;
+            if (dent->d_name[0] == '.')
+                continue;
+            VFSFileInfo* fi = get_file(dir_fd, dent->d_name, arena);
+            if (!fi)
+                continue;
+            gint64 start = g_get_monotonic_time();
+            vfs_list_cache_add(listing, fi);
+            save_time += g_get_monotonic_time() - start;
+            files = g_list_prepend(files, fi);
+        }
+    }
+    g_free(buf);
+    *save_ms = save_time / 1000.0;
+    return files;
+}
+
+static VFSFileInfoArena* arena_new()
+{
+    VFSFileInfoArena* arena = g_slice_new(VFSFileInfoArena);
+    arena->n_ref = 1;
+    arena->names = g_string_chunk_new(16384);
+    return arena;
+}
+
+static void arena_free(VFSFileInfoArena* arena)
+{
+    g_string_chunk_free(arena->names);
+    g_slice_free(VFSFileInfoArena, arena);
+}
+
+static void make_files(const char* dir_path, uint n_files)
+{
+    uint i;
+    for (i = 0; i < n_files; ++i)
+    {
+        char* path = g_strdup_printf("%s/file-%06u%s", dir_path, i, suffixes[i % G_N_ELEMENTS(suffixes)]);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd == -1)
+        {
+            g_printf("cannot write %s\n", path);
+            exit(1);
+        }
+        close(fd);
+        g_free(path);
+    }
+}
+
+static double ms_since(gint64 start)
+{
+    return (g_get_monotonic_time() - start) / 1000.0;
+}
+
+static void bench_dir(const char* root, uint n_files)
+{
+    char* dir_path = g_strdup_printf("%s/mount-%u", root, n_files);
+    g_mkdir(dir_path, 0755);
+    make_files(dir_path, n_files);
+    int dir_fd = open(dir_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    struct stat dir_stat;
+    fstat(dir_fd, &dir_stat);
+    gint64 dir_mtime = (gint64)dir_stat.st_mtim.tv_sec * 1000000000 + dir_stat.st_mtim.tv_nsec;
+
+    /* first visit: listed over the mount, and saved */
+    VFSFileInfoArena* arena = arena_new();
+    gint64 start = g_get_monotonic_time();
+    double save_ms;
+    GString* listing = vfs_list_cache_begin(dir_path, dir_mtime);
+    GList* files = list_dir(dir_fd, arena, listing, &save_ms);
+    double listed_ms = ms_since(start);
+    gsize saved_size = listing->len;
+    gint64 commit_start = g_get_monotonic_time();
+    vfs_list_cache_commit(dir_path, listing);
+    save_ms += ms_since(commit_start);
+    uint n_listed = g_list_length(files);
+    free_files(files);
+    arena_free(arena);
+
+    /* next visit: the saved listing is shown, then every file restat'ed */
+    arena = arena_new();
+    start = g_get_monotonic_time();
+    gint64 cached_mtime = 0;
+    files = vfs_list_cache_load(dir_path, &cached_mtime, arena);
+    double shown_ms = ms_since(start);
+    uint n_cached = g_list_length(files);
+    GList* l;
+    uint n_revalidated = 0;
+    for (l = files; l; l = l->next)
+    {
+        VFSFileInfo* fi = get_file(dir_fd, ((VFSFileInfo*)l->data)->name, arena);
+        if (fi)
+        {
+            ++n_revalidated;
+            g_slice_free(VFSFileInfo, fi);
+        }
+    }
+    double revalidated_ms = ms_since(start);
+    free_files(files);
+    arena_free(arena);
+
+    g_printf("%u files, %u us per call:\n", n_files, latency);
+    g_printf("  listed over the mount:  shown after %8.1f ms, %u files\n", listed_ms, n_listed);
+    g_printf("  saved listing:          shown after %8.1f ms, %u files, revalidated after %8.1f ms, %u files\n",
+             shown_ms, n_cached, revalidated_ms, n_revalidated);
+    g_printf("  saving took %.1f ms, %zu bytes, %.1f per file, mtime %s\n", save_ms, saved_size,
+             (double)saved_size / MAX(n_files, 1), cached_mtime == dir_mtime ? "matches" : "differs");
+
+    close(dir_fd);
+    g_free(dir_path);
+}
+
+/* Save more listings than VFS_LIST_CACHE_MAX_SIZE holds */
+static void bench_trim(const char* cache_dir)
+{
+    VFSFileInfoArena* arena = arena_new();
+    VFSFileInfo* fi = vfs_file_info_new();
+    struct stat file_stat;
+    memset(&file_stat, 0, sizeof(file_stat));
+    file_stat.st_mode = S_IFREG | 0644;
+    uint d, i;
+    gint64 start = g_get_monotonic_time();
+    for (d = 0; d < TRIM_DIRS; ++d)
+    {
+        char* dir_path = g_strdup_printf("/net/host/share/dir-%03u", d);
+        GString* listing = vfs_list_cache_begin(dir_path, 0);
+        for (i = 0; i < TRIM_FILES_PER_DIR; ++i)
+        {
+            char name[32];
+            g_snprintf(name, sizeof(name), "file-%06u%s", i, suffixes[i % G_N_ELEMENTS(suffixes)]);
+            vfs_file_info_get_cached(fi, name, &file_stat, type_of(name), FALSE, arena);
+            vfs_list_cache_add(listing, fi);
+        }
+        vfs_list_cache_commit(dir_path, listing);
+        g_free(dir_path);
+    }
+    double ms = ms_since(start);
+
+    char* listings_dir = g_build_filename(cache_dir, "spacefm-listings", NULL);
+    GDir* dir = g_dir_open(listings_dir, 0, NULL);
+    goffset total = 0;
+    uint n_kept = 0;
+    const char* name;
+    while (dir && (name = g_dir_read_name(dir)))
+    {
+        char* path = g_build_filename(listings_dir, name, NULL);
+        struct stat st;
+        if (stat(path, &st) == 0)
+        {
+            total += st.st_size;
+            ++n_kept;
+        }
+        g_free(path);
+    }
+    if (dir)
+        g_dir_close(dir);
+    g_printf("%u listings of %u files saved in %.1f ms: %u kept, %.1f MiB of %u MiB\n", TRIM_DIRS,
+             TRIM_FILES_PER_DIR, ms, n_kept, total / (1024.0 * 1024), MAX_SIZE / (1024 * 1024));
+    g_free(listings_dir);
+    g_slice_free(VFSFileInfo, fi);
+    arena_free(arena);
+}
+
+static void remove_tree(const char* path)
+{
+    GDir* dir = g_dir_open(path, 0, NULL);
+    if (dir)
+    {
+        const char* name;
+        while ((name = g_dir_read_name(dir)))
+        {
+            char* child = g_build_filename(path, name, NULL);
+            remove_tree(child);
+            g_free(child);
+        }
+        g_dir_close(dir);
+        g_rmdir(path);
+    }
+    else
+        g_unlink(path);
+}
+
+int main(int argc, char* argv[])
+{
+    static const uint default_sizes[] = {1000, 10000};
+    uint n_sizes = argc > 2 ? (uint)argc - 2 : G_N_ELEMENTS(default_sizes);
+    uint s;
+    latency = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_LATENCY;
+
+    char* root = g_dir_make_tmp("spacefm-list-cache-XXXXXX", NULL);
+    if (!root)
+        return 1;
+    /* before g_get_user_cache_dir is first called */
+    char* cache_dir = g_build_filename(root, "cache", NULL);
+    g_setenv("XDG_CACHE_HOME", cache_dir, TRUE);
+    mime_types = g_hash_table_new(g_str_hash, g_str_equal);
+
+    for (s = 0; s < n_sizes; ++s)
+        bench_dir(root, argc > 2 ? strtoul(argv[s + 2], NULL, 10) : default_sizes[s]);
+    bench_trim(cache_dir);
+
+    remove_tree(root);
+    g_free(cache_dir);
+    g_free(root);
+    return 0;
+}
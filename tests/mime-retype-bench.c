@@ -0,0 +1,183 @@
+/*
+ *  mime-retype-bench.c
+ *
+ * Description: Times how long the rows on screen wait for their new type
+ * after a mime database reload.  The files of a synthetic dir are sniffed
+ * in jobs of MIME_RETYPE_JOB_FILES like vfs_dir_retype_files, once in
+ * listing order and once with the rows on screen queued first.
+ *
+ * Usage: mime-retype-bench [n_files] [n_shown]
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glib/gprintf.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "mime-type/mime-type.h"
+
+#define MIME_RETYPE_JOB_FILES 1024 /* as in vfs-dir.c */
+#define DEFAULT_N_FILES       20000
+#define DEFAULT_N_SHOWN       60
+
+typedef struct
+{
+    char* name;
+    struct stat file_stat;
+    gboolean shown;
+} BenchFile;
+
+/* half the files need their content sniffed, as those without a suffix */
+static const char* const suffixes[] = {".txt", ".png", ".c", ".pdf", "", "", "", ""};
+static const char* const contents[] = {"plain text\n", "\x89PNG\r\n\x1a\n", "int main() {}\n", "%PDF-1.4\n",
+                                       "#!/bin/sh\necho\n", "\x7f" "ELF\x02\x01\x01", "<?xml version=\"1.0\"?>\n",
+                                       "\x1f\x8b\x08\x00"};
+
+static void make_files(const char* dir_path, uint n_files)
+{
+    uint i;
+    for (i = 0; i < n_files; ++i)
+    {
+        uint kind = i % G_N_ELEMENTS(suffixes);
+        char* name = g_strdup_printf("file-%06u%s", i, suffixes[kind]);
+        char* path = g_build_filename(dir_path, name, NULL);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd == -1 || write(fd, contents[kind], strlen(contents[kind])) < 0)
+        {
+            g_printf("cannot write %s\n", path);
+            exit(1);
+        }
+        close(fd);
+        g_free(path);
+        g_free(name);
+    }
+}
+
+/* the files in readdir order, as in dir->file_list */
+static GArray* list_files(const char* dir_path)
+{
+    GArray* files = g_array_new(FALSE, TRUE, sizeof(BenchFile));
+    GDir* dir = g_dir_open(dir_path, 0, NULL);
+    const char* name;
+    while ((name = g_dir_read_name(dir)))
+    {
+        BenchFile file;
+        char* path = g_build_filename(dir_path, name, NULL);
+        file.name = g_strdup(name);
+        file.shown = FALSE;
+        lstat(path, &file.file_stat);
+        g_free(path);
+        g_array_append_val(files, file);
+    }
+    g_dir_close(dir);
+    return files;
+}
+
+static void sniff(const char* dir_path, BenchFile* file)
+{
+    char* path = g_build_filename(dir_path, file->name, NULL);
+    mime_type_get_by_file(path, &file->file_stat, file->name);
+    g_free(path);
+}
+
+/* Sniff the files in jobs, shown first if shown_first.  Returns the time in
+ * ms until the job holding the last row on screen is done. */
+static double run(const char* dir_path, GArray* files, gboolean shown_first, double* total_ms)
+{
+    gint64 start = g_get_monotonic_time();
+    gint64 shown_done = 0;
+    uint n_shown_left = 0;
+    uint in_job = 0;
+    uint i;
+
+    for (i = 0; i < files->len; ++i)
+        n_shown_left += g_array_index(files, BenchFile, i).shown;
+
+    if (shown_first)
+    {
+        for (i = 0; i < files->len; ++i)
+        {
+            BenchFile* file = &g_array_index(files, BenchFile, i);
+            if (file->shown)
+                sniff(dir_path, file);
+        }
+        /* pushed as a job of its own */
+        shown_done = g_get_monotonic_time();
+        n_shown_left = 0;
+    }
+    for (i = 0; i < files->len; ++i)
+    {
+        BenchFile* file = &g_array_index(files, BenchFile, i);
+        if (shown_first && file->shown)
+            continue;
+        sniff(dir_path, file);
+        if (file->shown)
+            --n_shown_left;
+        /* results are applied per job */
+        if (++in_job == MIME_RETYPE_JOB_FILES || i == files->len - 1)
+        {
+            in_job = 0;
+            if (!shown_done && n_shown_left == 0)
+                shown_done = g_get_monotonic_time();
+        }
+    }
+    *total_ms = (g_get_monotonic_time() - start) / 1000.0;
+    return (shown_done - start) / 1000.0;
+}
+
+int main(int argc, char* argv[])
+{
+    uint n_files = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_N_FILES;
+    uint n_shown = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_N_SHOWN;
+    char* dir_path = g_dir_make_tmp("spacefm-retype-XXXXXX", NULL);
+    if (!dir_path || !n_files)
+        return 1;
+    n_shown = MIN(n_shown, n_files);
+
+    mime_type_init();
+    make_files(dir_path, n_files);
+    GArray* files = list_files(dir_path);
+
+    /* a screenful of consecutive rows in name order, scattered in the listing */
+    uint first = (n_files - n_shown) / 2;
+    uint i;
+    for (i = 0; i < files->len; ++i)
+    {
+        BenchFile* file = &g_array_index(files, BenchFile, i);
+        uint n = strtoul(file->name + strlen("file-"), NULL, 10);
+        file->shown = n >= first && n < first + n_shown;
+    }
+
+    /* warm the page cache and the mime cache, as for a dir on screen */
+    double total_ms;
+    run(dir_path, files, FALSE, &total_ms);
+
+    double listing_ms = run(dir_path, files, FALSE, &total_ms);
+    g_printf("listing order: rows on screen typed after %.1f ms, all %u files after %.1f ms\n",
+             listing_ms, n_files, total_ms);
+    double shown_ms = run(dir_path, files, TRUE, &total_ms);
+    g_printf("shown first:   rows on screen typed after %.1f ms, all %u files after %.1f ms\n",
+             shown_ms, n_files, total_ms);
+
+    for (i = 0; i < files->len; ++i)
+    {
+        BenchFile* file = &g_array_index(files, BenchFile, i);
+        char* path = g_build_filename(dir_path, file->name, NULL);
+        g_unlink(path);
+        g_free(path);
+        g_free(file->name);
+    }
+    g_array_free(files, TRUE);
+    g_rmdir(dir_path);
+    g_free(dir_path);
+    mime_type_finalize();
+    return 0;
+}
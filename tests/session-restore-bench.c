@@ -0,0 +1,259 @@
+/*
+ *  session-restore-bench.c
+ *
+ * Description: Restores a session of many tabs whose dirs are spread over
+ * a local SSD, a rotating disk and a network mount, with a thread per
+ * dir load as before, and through the worker pool of vfs-async-task.c as
+ * now: at most 8 threads, the shown tab interactive and the others in the
+ * background, at most 2 tasks per device.  Reports when the shown tab is
+ * listed, when every tab is, and how many loads ran at once.
+ *
+ * The dispatch is copied from vfs-async-task.c, which needs GObject.  A
+ * load is a number of I/O requests, each followed by the CPU time of
+ * building the file infos.  The disk serves one request at a time and
+ * seeks when it switches to another load, the mount serves 4 at once.
+ *
+ * Usage: session-restore-bench [n_tabs]...
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <stdlib.h>
+#include <time.h>
+
+#define MAX_THREADS    8 /* VFS_ASYNC_TASK_MAX_THREADS */
+#define MAX_PER_DEVICE 2 /* VFS_ASYNC_TASK_MAX_PER_DEVICE */
+#define OPS_PER_LOAD   40
+#define CPU_PER_OP     200 /* us */
+
+typedef struct
+{
+    const char* name;
+    uint max_in_flight;
+    uint service_us;
+    uint seek_us; /* when switching to another load */
+    GMutex lock;
+    GCond cond;
+    uint in_flight;
+    int last_load;
+} Device;
+
+typedef enum
+{
+    PRIORITY_INTERACTIVE,
+    PRIORITY_BACKGROUND,
+    N_PRIORITIES
+} Priority;
+
+typedef struct
+{
+    int id;
+    Device* device;
+    Priority priority;
+    gint64 done_time;
+} Load;
+
+static Device devices[] = {
+    {"ssd", 32, 100, 0, {0}, {0}, 0, -1},
+    {"disk", 1, 300, 4000, {0}, {0}, 0, -1},
+    {"mount", 4, 2000, 0, {0}, {0}, 0, -1},
+};
+
+static GMutex pool_lock;
+static GCond pool_cond; /* a load is done */
+static GThreadPool* pool = NULL;
+static GQueue pending[N_PRIORITIES] = {G_QUEUE_INIT, G_QUEUE_INIT};
+static GList* running = NULL;
+static uint n_running = 0;
+static uint n_done = 0;
+static uint max_concurrent = 0;
+static volatile gint n_concurrent = 0;
+
+static void device_request(Device* device, int load_id)
+{
+    g_mutex_lock(&device->lock);
+    while (device->in_flight >= device->max_in_flight)
+        g_cond_wait(&device->cond, &device->lock);
+    ++device->in_flight;
+    uint cost = device->service_us;
+    if (device->seek_us && device->last_load != load_id)
+        cost += device->seek_us;
+    device->last_load = load_id;
+    g_mutex_unlock(&device->lock);
+
+    g_usleep(cost);
+
+    g_mutex_lock(&device->lock);
+    --device->in_flight;
+    g_cond_signal(&device->cond);
+    g_mutex_unlock(&device->lock);
+}
+
+static gint64 thread_cpu_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (gint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void cpu_work(uint us)
+{
+    gint64 end = thread_cpu_us() + us;
+    while (thread_cpu_us() < end)
+        ;
+}
+
+/* vfs_dir_load_thread */
+static void run_load(Load* load)
+{
+    uint n = g_atomic_int_add(&n_concurrent, 1) + 1;
+    uint i;
+    for (i = 0; i < OPS_PER_LOAD; ++i)
+    {
+        device_request(load->device, load->id);
+        cpu_work(CPU_PER_OP);
+    }
+    g_atomic_int_add(&n_concurrent, -1);
+
+    g_mutex_lock(&pool_lock);
+    max_concurrent = MAX(max_concurrent, n);
+    load->done_time = g_get_monotonic_time();
+    ++n_done;
+    g_cond_broadcast(&pool_cond);
+    g_mutex_unlock(&pool_lock);
+}
+
+/* before, vfs_async_task_execute */
+static gpointer load_thread(gpointer load)
+{
+    run_load((Load*)load);
+    return NULL;
+}
+
+/* pool_lock must be locked */
+static uint count_running_on_device(Device* device)
+{
+    uint n = 0;
+    GList* l;
+    for (l = running; l; l = l->next)
+    {
+        if (((Load*)l->data)->device == device)
+            ++n;
+    }
+    return n;
+}
+
+/* pool_lock must be locked */
+static void dispatch()
+{
+    int priority;
+    for (priority = 0; priority < N_PRIORITIES; ++priority)
+    {
+        GList* l = pending[priority].head;
+        while (l && n_running < MAX_THREADS)
+        {
+            GList* next = l->next;
+            Load* load = (Load*)l->data;
+            if (count_running_on_device(load->device) < MAX_PER_DEVICE)
+            {
+                g_queue_delete_link(&pending[priority], l);
+                running = g_list_prepend(running, load);
+                ++n_running;
+                g_thread_pool_push(pool, load, NULL);
+            }
+            l = next;
+        }
+    }
+}
+
+static void pool_thread(Load* load, gpointer user_data)
+{
+    run_load(load);
+    g_mutex_lock(&pool_lock);
+    running = g_list_remove(running, load);
+    --n_running;
+    dispatch();
+    g_mutex_unlock(&pool_lock);
+}
+
+static void restore(uint n_tabs, gboolean pooled)
+{
+    Load* loads = g_new0(Load, n_tabs);
+    GThread** threads = g_new0(GThread*, n_tabs);
+    uint shown = n_tabs - 1; /* the last tab of the session is shown */
+    uint i;
+
+    n_done = 0;
+    max_concurrent = 0;
+    for (i = 0; i < G_N_ELEMENTS(devices); ++i)
+        devices[i].last_load = -1;
+
+    gint64 start = g_get_monotonic_time();
+    for (i = 0; i < n_tabs; ++i)
+    {
+        Load* load = &loads[i];
+        load->id = i;
+        /* the shown tab is on the disk */
+        load->device = &devices[i == shown ? 1 : i % G_N_ELEMENTS(devices)];
+        load->priority = i == shown ? PRIORITY_INTERACTIVE : PRIORITY_BACKGROUND;
+        if (pooled)
+        {
+            g_mutex_lock(&pool_lock);
+            g_queue_push_tail(&pending[load->priority], load);
+            dispatch();
+            g_mutex_unlock(&pool_lock);
+        }
+        else
+            threads[i] = g_thread_new("load", load_thread, load);
+    }
+
+    g_mutex_lock(&pool_lock);
+    while (n_done < n_tabs)
+        g_cond_wait(&pool_cond, &pool_lock);
+    g_mutex_unlock(&pool_lock);
+    if (!pooled)
+    {
+        for (i = 0; i < n_tabs; ++i)
+            g_thread_join(threads[i]);
+    }
+
+    gint64 last = 0;
+    for (i = 0; i < n_tabs; ++i)
+        last = MAX(last, loads[i].done_time);
+    g_printf("  %-24s shown tab %7.1f ms, all tabs %7.1f ms, %2u loads at once\n",
+             pooled ? "pool:" : "thread per load (before):", (loads[shown].done_time - start) / 1000.0,
+             (last - start) / 1000.0, max_concurrent);
+    g_free(threads);
+    g_free(loads);
+}
+
+int main(int argc, char* argv[])
+{
+    static const uint default_sizes[] = {10, 30, 60};
+    uint n_sizes = argc > 1 ? (uint)argc - 1 : G_N_ELEMENTS(default_sizes);
+    uint s, i;
+
+    for (i = 0; i < G_N_ELEMENTS(devices); ++i)
+    {
+        g_mutex_init(&devices[i].lock);
+        g_cond_init(&devices[i].cond);
+    }
+    pool = g_thread_pool_new((GFunc)pool_thread, NULL, MAX_THREADS, FALSE, NULL);
+
+    for (s = 0; s < n_sizes; ++s)
+    {
+        uint n_tabs = argc > 1 ? strtoul(argv[s + 1], NULL, 10) : default_sizes[s];
+        if (!n_tabs)
+            continue;
+        g_printf("%u tabs, %u requests and %.1f ms cpu per load:\n", n_tabs, OPS_PER_LOAD,
+                 OPS_PER_LOAD * CPU_PER_OP / 1000.0);
+        restore(n_tabs, FALSE);
+        restore(n_tabs, TRUE);
+    }
+    g_thread_pool_free(pool, FALSE, TRUE);
+    return 0;
+}
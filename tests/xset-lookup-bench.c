@@ -0,0 +1,167 @@
+/*
+ *  xset-lookup-bench.c
+ *
+ * Description: Compares xset_get by a strcmp scan of xsets, as before, and
+ * through xset_hash, as now, in the phases where settings are looked up:
+ * creating the default sets, load_settings parsing the session file, menu
+ * construction and the scan of on_main_window_keypress for shared keys.
+ * Sets hold only a name and a shared key, and are created and prepended
+ * the same way as in settings.c, which needs GTK to link.
+ *
+ * Usage: xset-lookup-bench [n_sets]...
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define N_PANELS         4
+#define N_PANEL_SETS     80  /* per panel, those of panels 2-4 share the key of panel 1 */
+#define LINES_PER_SET    3   /* session lines such as name-s=, name-x=, name-key= */
+#define MENU_ITEMS       200 /* sets looked up to build a menu */
+#define N_MENUS          100
+#define N_KEYPRESSES     100
+
+typedef struct
+{
+    char* name;
+    char* shared_key;
+} XSet;
+
+typedef struct
+{
+    GList* xsets;
+    GHashTable* xset_hash; /* NULL before */
+} Registry;
+
+static XSet* xset_get(Registry* reg, const char* name)
+{
+    XSet* set = NULL;
+    if (reg->xset_hash)
+        set = (XSet*)g_hash_table_lookup(reg->xset_hash, name);
+    else
+    {
+        GList* l;
+        for (l = reg->xsets; l; l = l->next)
+        {
+            if (!strcmp(name, ((XSet*)l->data)->name))
+            {
+                set = (XSet*)l->data;
+                break;
+            }
+        }
+    }
+    if (!set)
+    {
+        /* xset_new */
+        set = g_slice_new0(XSet);
+        set->name = g_strdup(name);
+        reg->xsets = g_list_prepend(reg->xsets, set);
+        if (reg->xset_hash)
+            g_hash_table_insert(reg->xset_hash, set->name, set);
+    }
+    return set;
+}
+
+static void registry_free(Registry* reg)
+{
+    GList* l;
+    if (reg->xset_hash)
+        g_hash_table_destroy(reg->xset_hash);
+    for (l = reg->xsets; l; l = l->next)
+    {
+        XSet* set = (XSet*)l->data;
+        g_free(set->name);
+        g_free(set->shared_key);
+        g_slice_free(XSet, set);
+    }
+    g_list_free(reg->xsets);
+}
+
+static double ms_since(gint64 start)
+{
+    return (g_get_monotonic_time() - start) / 1000.0;
+}
+
+static void bench(char** names, uint n_sets, gboolean indexed)
+{
+    Registry reg = {NULL, indexed ? g_hash_table_new(g_str_hash, g_str_equal) : NULL};
+    uint i, j;
+
+    /* xset_defaults */
+    gint64 start = g_get_monotonic_time();
+    for (i = 0; i < n_sets; ++i)
+    {
+        XSet* set = xset_get(&reg, names[i]);
+        if (g_str_has_prefix(set->name, "panel") && set->name[5] != '1')
+            set->shared_key = g_strdup_printf("panel1%s", set->name + 6);
+    }
+    double defaults_ms = ms_since(start);
+
+    /* load_settings, the session is saved in the order of xsets */
+    GPtrArray* session = g_ptr_array_new();
+    GList* l;
+    for (l = reg.xsets; l; l = l->next)
+        g_ptr_array_add(session, ((XSet*)l->data)->name);
+    start = g_get_monotonic_time();
+    for (i = 0; i < session->len; ++i)
+    {
+        for (j = 0; j < LINES_PER_SET; ++j)
+            xset_get(&reg, (const char*)g_ptr_array_index(session, i));
+    }
+    double load_ms = ms_since(start);
+    g_ptr_array_free(session, TRUE);
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < N_MENUS * MENU_ITEMS; ++i)
+        xset_get(&reg, names[g_random_int_range(0, n_sets)]);
+    double menu_ms = ms_since(start) / N_MENUS;
+
+    /* a key bound to no set, all shared keys are looked up */
+    start = g_get_monotonic_time();
+    for (i = 0; i < N_KEYPRESSES; ++i)
+    {
+        for (l = reg.xsets; l; l = l->next)
+        {
+            if (((XSet*)l->data)->shared_key)
+                xset_get(&reg, ((XSet*)l->data)->shared_key);
+        }
+    }
+    double key_ms = ms_since(start) / N_KEYPRESSES;
+
+    g_printf("  %s defaults %8.2f ms, load_settings %8.2f ms, menu %6.3f ms, keypress %6.3f ms\n",
+             indexed ? "xset_hash:" : "xsets:    ", defaults_ms, load_ms, menu_ms, key_ms);
+    registry_free(&reg);
+}
+
+int main(int argc, char* argv[])
+{
+    static const uint default_sizes[] = {1500, 3000};
+    uint n_sizes = argc > 1 ? (uint)argc - 1 : G_N_ELEMENTS(default_sizes);
+    uint s, i;
+    for (s = 0; s < n_sizes; ++s)
+    {
+        uint n_sets = argc > 1 ? strtoul(argv[s + 1], NULL, 10) : default_sizes[s];
+        if (n_sets < N_PANELS * N_PANEL_SETS)
+            continue;
+        /* panel sets first, as xset_defaults creates them */
+        char** names = g_new(char*, n_sets);
+        for (i = 0; i < N_PANELS * N_PANEL_SETS; ++i)
+            names[i] = g_strdup_printf("panel%u_set_%03u", i / N_PANEL_SETS + 1, i % N_PANEL_SETS);
+        for (; i < n_sets; ++i)
+            names[i] = g_strdup_printf("main_set_%04u", i);
+
+        g_printf("%u sets:\n", n_sets);
+        bench(names, n_sets, FALSE);
+        bench(names, n_sets, TRUE);
+        for (i = 0; i < n_sets; ++i)
+            g_free(names[i]);
+        g_free(names);
+    }
+    return 0;
+}